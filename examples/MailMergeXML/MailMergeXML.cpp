@@ -39,20 +39,15 @@ int main(int argc, char **argv)
     members.loadFromCSV(":/members.csv");
     report.associateModel(QLatin1String("members"), &members);
 
-    for (int i = 0; i < members.rowCount(); i++) {
-        report.setCurrentRow(&members, i);
-        KDReports::ErrorDetails details;
-        if (!report.loadFromXML(&reportFile, &details)) {
-            QMessageBox::warning(nullptr, QObject::tr("Warning"), QObject::tr("Could not parse report description file:\n%1").arg(details.message()));
-            reportFile.close();
-            return -2;
-        }
-
-        if (i < members.rowCount() - 1)
-            report.addPageBreak();
-
-        // show a print preview:
+    // Parses and builds the XML once, then copies it for each member, starting a new page every time
+    KDReports::ErrorDetails details;
+    if (!report.loadFromXMLForEachRow(&reportFile, &members, &details)) {
+        QMessageBox::warning(nullptr, QObject::tr("Warning"), QObject::tr("Could not parse report description file:\n%1").arg(details.message()));
+        reportFile.close();
+        return -2;
     }
+
+    // show a print preview:
     KDReports::PreviewDialog preview(&report);
     return preview.exec();
 }
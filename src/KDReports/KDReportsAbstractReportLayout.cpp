@@ -10,6 +10,17 @@
 
 #include "KDReportsAbstractReportLayout_p.h"
 
+#include <algorithm>
+
+int KDReports::PageTextIndex::pageAt(int position) const
+{
+    // The last line starting at or before position
+    const auto it = std::upper_bound(lineStarts.constBegin(), lineStarts.constEnd(), position);
+    if (it == lineStarts.constBegin())
+        return -1;
+    return linePages.at(std::distance(lineStarts.constBegin(), it) - 1);
+}
+
 KDReports::AbstractReportLayout::AbstractReportLayout()
 {
 }
@@ -11,10 +11,15 @@
 #ifndef KDREPORTSABSTRACTREPORTLAYOUT_H
 #define KDREPORTSABSTRACTREPORTLAYOUT_H
 
+#include <QHash>
+#include <QPair>
+#include <QRectF>
 #include <QString>
+#include <QVector>
 
 QT_BEGIN_NAMESPACE
 class QFont;
+class QIODevice;
 class QPainter;
 class QPoint;
 class QSizeF;
@@ -23,6 +28,16 @@ QT_END_NAMESPACE
 
 namespace KDReports {
 
+/// The text of a report, and on which page each line is, for searching it
+struct PageTextIndex
+{
+    QString text; // each character at its position in the document
+    QVector<int> lineStarts; // the position of the first character of each line, in ascending order
+    QVector<int> linePages; // the page of each line
+    /// Returns the page of the character at \p position, or -1 if there's no such character
+    int pageAt(int position) const;
+};
+
 class AbstractReportLayout
 {
 public:
@@ -49,6 +64,7 @@ public:
     virtual int maximumNumberOfPagesForVerticalScaling() const = 0;
     virtual void ensureLayouted() = 0;
     virtual void updateTextValue(const QString &id, const QString &newValue) = 0;
+    virtual void updateTextValues(const QHash<QString, QString> &values) = 0;
     /**
      * Returns the width that could be used when exporting to an image, for instance.
      * Unrelated to any paper sizes, just from the contents.
@@ -59,10 +75,23 @@ public:
     virtual qreal userRequestedFontScalingFactor() const = 0;
 
     virtual QString anchorAt(int pageNumber, QPoint pos) = 0;
+    /// A hyperlink on a page: where it is (one rect per line), relative to the page content, and its target
+    using Anchor = QPair<QRectF, QString>;
+    /// The hyperlinks on the page, sorted by the top of their rect
+    virtual QVector<Anchor> anchors(int pageNumber) = 0;
+    /// The text and the page of each line, built once after layouting
+    virtual PageTextIndex pageTextIndex() = 0;
+    /// The rects (one per line) of the text from \p position to \p position + \p length, relative to the page content
+    virtual QVector<QRectF> textRects(int pageNumber, int position, int length) = 0;
+    /// A hash of what is painted by paintPageContent, or an empty QByteArray if unknown
+    virtual QByteArray pageContentHash(int pageNumber) = 0;
 
-    virtual QString toStandaloneHtml() = 0; // turns images into data URLs
+    virtual QString toStandaloneHtml() const = 0; // turns images into data URLs
 
     virtual QString asHtml() const = 0;
+    virtual bool writeHtml(QIODevice *device) const = 0; // simplified HTML, written in chunks (see HtmlWriter)
+    virtual bool writeMarkdown(QIODevice *device) const = 0;
+    virtual bool writeOdt(QIODevice *device) const = 0; // flat ODT, with the images embedded
     virtual void finishHtmlExport() = 0; // saves images as separate files
 };
 
@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsChunkedWriter_p.h"
+
+#include <QIODevice>
+
+static const int s_chunkSize = 64 * 1024;
+
+void KDReports::ChunkedWriter::begin(QIODevice *device)
+{
+    m_device = device;
+    m_ok = true;
+    m_buffer.reserve(s_chunkSize);
+}
+
+bool KDReports::ChunkedWriter::end()
+{
+    flush();
+    m_device = nullptr;
+    return m_ok;
+}
+
+void KDReports::ChunkedWriter::write(const QString &text)
+{
+    write(text.toUtf8());
+}
+
+void KDReports::ChunkedWriter::write(const char *text)
+{
+    m_buffer += text;
+    if (m_buffer.size() >= s_chunkSize)
+        flush();
+}
+
+void KDReports::ChunkedWriter::write(const QByteArray &bytes)
+{
+    m_buffer += bytes;
+    if (m_buffer.size() >= s_chunkSize)
+        flush();
+}
+
+void KDReports::ChunkedWriter::flush()
+{
+    if (m_ok && !m_buffer.isEmpty())
+        m_ok = m_device->write(m_buffer) == m_buffer.size();
+    m_buffer.resize(0); // unlike clear(), keeps the reserved capacity
+}
@@ -0,0 +1,70 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSCHUNKEDWRITER_P_H
+#define KDREPORTSCHUNKEDWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QByteArray>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Buffers text encoded as UTF-8 and writes it to a device in chunks,
+ * for the writers which stream a document or a model to a file.
+ *
+ * After a failed write, the remaining output is dropped and end() returns false.
+ */
+class ChunkedWriter
+{
+public:
+    /// Starts writing to \p device, which must be open
+    void begin(QIODevice *device);
+    /// Writes the remaining buffered output
+    /// \return false if writing to the device failed
+    bool end();
+
+    /// \return false once writing to the device failed
+    bool isOk() const
+    {
+        return m_ok;
+    }
+
+    void write(const QString &text);
+    void write(const char *text);
+    void write(const QByteArray &bytes);
+
+private:
+    void flush();
+
+    QIODevice *m_device = nullptr;
+    QByteArray m_buffer;
+    bool m_ok = true;
+};
+
+}
+
+#endif /* KDREPORTSCHUNKEDWRITER_P_H */
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsDocumentWriter_p.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextList>
+#include <QTextTable>
+
+KDReports::DocumentWriter::DocumentWriter(const QTextDocument *document)
+    : m_document(document)
+    , m_defaultFont(document->defaultFont())
+{
+}
+
+KDReports::DocumentWriter::~DocumentWriter()
+{
+}
+
+bool KDReports::DocumentWriter::write(QIODevice *device)
+{
+    m_output.begin(device);
+    writeDocument();
+    return m_output.end();
+}
+
+void KDReports::DocumentWriter::beginList(const QTextList *)
+{
+}
+
+void KDReports::DocumentWriter::endList(const QTextList *)
+{
+}
+
+void KDReports::DocumentWriter::writeFrame(const QTextFrame *frame)
+{
+    writeItems(frame->begin());
+}
+
+void KDReports::DocumentWriter::writeItems(QTextFrame::iterator it)
+{
+    const QTextList *currentList = nullptr;
+    for (; !it.atEnd(); ++it) {
+        const QTextList *list = it.currentFrame() ? nullptr : it.currentBlock().textList();
+        if (list != currentList) {
+            if (currentList)
+                endList(currentList);
+            if (list)
+                beginList(list);
+            currentList = list;
+        }
+        if (const QTextFrame *childFrame = it.currentFrame()) {
+            if (const QTextTable *table = qobject_cast<const QTextTable *>(childFrame))
+                writeTable(table);
+            else
+                writeFrame(childFrame);
+        } else {
+            writeBlock(it.currentBlock());
+        }
+    }
+    if (currentList)
+        endList(currentList);
+}
+
+void KDReports::DocumentWriter::writeFragments(const QTextBlock &block)
+{
+    for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+        const QTextFragment fragment = it.fragment();
+        if (fragment.isValid())
+            writeFragment(fragment);
+    }
+}
+
+bool KDReports::DocumentWriter::isOrderedList(const QTextList *list)
+{
+    switch (list->format().style()) {
+    case QTextListFormat::ListDecimal:
+    case QTextListFormat::ListLowerAlpha:
+    case QTextListFormat::ListUpperAlpha:
+    case QTextListFormat::ListLowerRoman:
+    case QTextListFormat::ListUpperRoman:
+        return true;
+    default:
+        return false;
+    }
+}
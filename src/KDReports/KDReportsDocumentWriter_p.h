@@ -0,0 +1,101 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSDOCUMENTWRITER_P_H
+#define KDREPORTSDOCUMENTWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsChunkedWriter_p.h"
+
+#include <QFont>
+#include <QString>
+#include <QTextFrame>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QTextBlock;
+class QTextDocument;
+class QTextFragment;
+class QTextList;
+class QTextTable;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Base class for the writers which convert a QTextDocument to another format (HTML, Markdown, ODT).
+ *
+ * The document is walked once, frame by frame and block by block, calling the virtual methods
+ * for each item. The output is encoded to UTF-8 and written to the device in chunks,
+ * as the document is walked, so it is never held in memory as a whole.
+ */
+class DocumentWriter
+{
+public:
+    explicit DocumentWriter(const QTextDocument *document);
+    virtual ~DocumentWriter();
+
+    /// Writes the whole document to \p device, which must be open
+    /// \return false if writing to the device failed
+    bool write(QIODevice *device);
+
+protected:
+    /// Writes the whole document, usually with writeItems(m_document->rootFrame()->begin())
+    virtual void writeDocument() = 0;
+    /// Called before the first block of \p list, in the sequence of items given to writeItems
+    virtual void beginList(const QTextList *list);
+    virtual void endList(const QTextList *list);
+    /// The default implementation writes the contents of the frame
+    virtual void writeFrame(const QTextFrame *frame);
+    virtual void writeTable(const QTextTable *table) = 0;
+    virtual void writeBlock(const QTextBlock &block) = 0;
+    virtual void writeFragment(const QTextFragment &fragment) = 0;
+
+    /// Writes the blocks and child frames from \p it until the end of its frame (or table cell)
+    void writeItems(QTextFrame::iterator it);
+    /// Calls writeFragment for each fragment of \p block
+    void writeFragments(const QTextBlock &block);
+    /// \return true for numbered lists, false for bullet lists
+    static bool isOrderedList(const QTextList *list);
+
+    void write(const QString &text)
+    {
+        m_output.write(text);
+    }
+    void write(const char *text)
+    {
+        m_output.write(text);
+    }
+    void write(const QByteArray &bytes)
+    {
+        m_output.write(bytes);
+    }
+
+    const QTextDocument *m_document;
+    const QFont m_defaultFont;
+
+private:
+    ChunkedWriter m_output;
+};
+
+}
+
+#endif /* KDREPORTSDOCUMENTWRITER_P_H */
@@ -59,7 +59,8 @@ QString variableValue(int pageNumber, KDReports::Report *report, VariableType ty
     case PageNumber:
         return QString::number(pageNumber + 1);
     case PageCount:
-        return QString::number(report->numberOfPages());
+        // When streaming, the pages printed already are no longer in the report
+        return QString::number(report->numberOfStreamedPages() + report->numberOfPages());
     case TextDate:
         return QDate::currentDate().toString(Qt::TextDate);
     case ISODate:
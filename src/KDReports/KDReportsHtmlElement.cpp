@@ -51,7 +51,7 @@ void KDReports::HtmlElement::build(ReportBuilder &builder) const
     const int charPosition = cursor.position();
     cursor.insertHtml(d->m_html);
     if (!d->m_id.isEmpty())
-        builder.currentDocumentData().setTextValueMarker(charPosition, d->m_id, cursor.position(), false);
+        builder.currentDocumentData().setTextValueMarker(charPosition, d->m_id, cursor.position() - charPosition, false);
 }
 
 KDReports::HtmlElement &KDReports::HtmlElement::operator<<(const QString &str)
@@ -0,0 +1,316 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsHtmlWriter_p.h"
+#include "KDReportsHLineTextObject_p.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextFrame>
+#include <QTextList>
+#include <QTextTable>
+
+static QString lengthToHtml(const QTextLength &length)
+{
+    switch (length.type()) {
+    case QTextLength::PercentageLength:
+        return QString::number(length.rawValue()) + QLatin1Char('%');
+    case QTextLength::FixedLength:
+        return QString::number(length.rawValue());
+    case QTextLength::VariableLength:
+        break;
+    }
+    return QString();
+}
+
+static QString brushStyle(const char *property, const QBrush &brush)
+{
+    if (brush.style() == Qt::NoBrush)
+        return QString();
+    return QString::fromLatin1(property) + QLatin1Char(':') + brush.color().name() + QStringLiteral("; ");
+}
+
+static QString pixelStyle(const char *property, qreal value)
+{
+    if (value == 0)
+        return QString();
+    return QString::fromLatin1(property) + QLatin1Char(':') + QString::number(value) + QStringLiteral("px; ");
+}
+
+static QString styleAttribute(const QString &style)
+{
+    if (style.isEmpty())
+        return QString();
+    return QStringLiteral(" style=\"") + style.trimmed() + QLatin1Char('"');
+}
+
+KDReports::HtmlWriter::HtmlWriter(const QTextDocument *document)
+    : DocumentWriter(document)
+{
+}
+
+void KDReports::HtmlWriter::writeDocument()
+{
+    write("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\" />\n");
+    const QString title = m_document->metaInformation(QTextDocument::DocumentTitle);
+    if (!title.isEmpty()) {
+        write("<title>");
+        writeText(title);
+        write("</title>\n");
+    }
+    QString bodyStyle = QStringLiteral("font-family:'") + m_defaultFont.family() + QStringLiteral("'; ");
+    if (m_defaultFont.pointSizeF() > 0)
+        bodyStyle += QStringLiteral("font-size:") + QString::number(m_defaultFont.pointSizeF()) + QStringLiteral("pt; ");
+    write(QStringLiteral("<style type=\"text/css\">\nbody { ") + bodyStyle + QStringLiteral("}\np, li { white-space:pre-wrap; }\n</style>\n</head>\n<body>\n"));
+
+    writeItems(m_document->rootFrame()->begin());
+
+    write("</body>\n</html>\n");
+}
+
+void KDReports::HtmlWriter::beginList(const QTextList *list)
+{
+    write(isOrderedList(list) ? "<ol>\n" : "<ul>\n");
+}
+
+void KDReports::HtmlWriter::endList(const QTextList *list)
+{
+    write(isOrderedList(list) ? "</ol>\n" : "</ul>\n");
+}
+
+void KDReports::HtmlWriter::writeFrame(const QTextFrame *frame)
+{
+    const QTextFrameFormat format = frame->frameFormat();
+    QString style;
+    if (format.border() > 0)
+        style += QStringLiteral("border:") + QString::number(format.border()) + QStringLiteral("px solid ") + format.borderBrush().color().name() + QStringLiteral("; ");
+    style += pixelStyle("padding", format.padding());
+    style += pixelStyle("margin", format.margin());
+    style += brushStyle("background-color", format.background());
+    write(QStringLiteral("<div") + styleAttribute(style) + QStringLiteral(">\n"));
+    writeItems(frame->begin());
+    write("</div>\n");
+}
+
+void KDReports::HtmlWriter::writeTable(const QTextTable *table)
+{
+    const QTextTableFormat format = table->format();
+    QString attributes;
+    if (format.border() > 0)
+        attributes += QStringLiteral(" border=\"") + QString::number(format.border()) + QLatin1Char('"');
+    attributes += QStringLiteral(" cellspacing=\"") + QString::number(format.cellSpacing()) + QLatin1Char('"');
+    attributes += QStringLiteral(" cellpadding=\"") + QString::number(format.cellPadding()) + QLatin1Char('"');
+    const QString width = lengthToHtml(format.width());
+    if (!width.isEmpty())
+        attributes += QStringLiteral(" width=\"") + width + QLatin1Char('"');
+    if (format.alignment() & Qt::AlignHCenter)
+        attributes += QStringLiteral(" align=\"center\"");
+    else if (format.alignment() & Qt::AlignRight)
+        attributes += QStringLiteral(" align=\"right\"");
+    QString style;
+    if (format.border() > 0)
+        style += QStringLiteral("border-color:") + format.borderBrush().color().name() + QStringLiteral("; border-style:solid; ");
+    style += brushStyle("background-color", format.background());
+    write(QStringLiteral("<table") + attributes + styleAttribute(style) + QStringLiteral(">\n"));
+
+    const QVector<QTextLength> columnWidths = format.columnWidthConstraints();
+    const int headerRowCount = qMin(format.headerRowCount(), table->rows());
+    for (int row = 0; row < table->rows(); ++row) {
+        if (row == 0 && headerRowCount > 0)
+            write("<thead>\n");
+        write("<tr>\n");
+        for (int column = 0; column < table->columns(); ++column) {
+            const QTextTableCell cell = table->cellAt(row, column);
+            if (cell.row() != row || cell.column() != column)
+                continue; // covered by a spanning cell
+            QString cellAttributes;
+            if (cell.rowSpan() > 1)
+                cellAttributes += QStringLiteral(" rowspan=\"") + QString::number(cell.rowSpan()) + QLatin1Char('"');
+            if (cell.columnSpan() > 1)
+                cellAttributes += QStringLiteral(" colspan=\"") + QString::number(cell.columnSpan()) + QLatin1Char('"');
+            if (row == 0 && cell.columnSpan() == 1 && column < columnWidths.size()) {
+                const QString columnWidth = lengthToHtml(columnWidths.at(column));
+                if (!columnWidth.isEmpty())
+                    cellAttributes += QStringLiteral(" width=\"") + columnWidth + QLatin1Char('"');
+            }
+            const QTextTableCellFormat cellFormat = cell.format().toTableCellFormat();
+            QString cellStyle = brushStyle("background-color", cellFormat.background());
+            switch (cellFormat.verticalAlignment()) {
+            case QTextCharFormat::AlignMiddle:
+                cellStyle += QStringLiteral("vertical-align:middle; ");
+                break;
+            case QTextCharFormat::AlignBottom:
+                cellStyle += QStringLiteral("vertical-align:bottom; ");
+                break;
+            default:
+                break;
+            }
+            write(QStringLiteral("<td") + cellAttributes + styleAttribute(cellStyle) + QStringLiteral(">\n"));
+            writeItems(cell.begin());
+            write("</td>\n");
+        }
+        write("</tr>\n");
+        if (row == headerRowCount - 1)
+            write("</thead>\n");
+    }
+    write("</table>\n");
+}
+
+void KDReports::HtmlWriter::writeBlock(const QTextBlock &block)
+{
+    const QTextBlockFormat format = block.blockFormat();
+    QString style;
+    switch (format.alignment() & Qt::AlignHorizontal_Mask) {
+    case Qt::AlignRight:
+        style += QStringLiteral("text-align:right; ");
+        break;
+    case Qt::AlignHCenter:
+        style += QStringLiteral("text-align:center; ");
+        break;
+    case Qt::AlignJustify:
+        style += QStringLiteral("text-align:justify; ");
+        break;
+    default:
+        break;
+    }
+    style += pixelStyle("margin-top", format.topMargin());
+    style += pixelStyle("margin-bottom", format.bottomMargin());
+    style += pixelStyle("margin-left", format.leftMargin() + format.indent() * m_document->indentWidth());
+    style += pixelStyle("margin-right", format.rightMargin());
+    style += pixelStyle("text-indent", format.textIndent());
+    style += brushStyle("background-color", format.background());
+    if (format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysBefore)
+        style += QStringLiteral("page-break-before:always; ");
+    if (format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysAfter)
+        style += QStringLiteral("page-break-after:always; ");
+
+    const char *tag = block.textList() ? "li" : "p";
+    write(QStringLiteral("<") + QString::fromLatin1(tag) + styleAttribute(style) + QLatin1Char('>'));
+    if (block.length() == 1) {
+        write("<br />"); // empty paragraph, keep its height
+    } else {
+        writeFragments(block);
+    }
+    write(QStringLiteral("</") + QString::fromLatin1(tag) + QStringLiteral(">\n"));
+}
+
+void KDReports::HtmlWriter::writeFragment(const QTextFragment &fragment)
+{
+    const QTextCharFormat format = fragment.charFormat();
+
+    int openedAnchors = 0;
+    if (format.isAnchor()) {
+        const QStringList names = format.anchorNames();
+        for (const QString &name : names) {
+            write("<a name=\"");
+            writeText(name);
+            write("\"></a>");
+        }
+        if (!format.anchorHref().isEmpty()) {
+            write("<a href=\"");
+            writeText(format.anchorHref());
+            write("\">");
+            ++openedAnchors;
+        }
+    }
+
+    const QString style = charFormatStyle(format);
+    if (!style.isEmpty())
+        write(QStringLiteral("<span") + styleAttribute(style) + QLatin1Char('>'));
+
+    const QString text = fragment.text();
+    if (format.isImageFormat()) {
+        const QTextImageFormat imageFormat = format.toImageFormat();
+        // One object replacement character per image
+        for (int i = 0; i < text.length(); ++i) {
+            write("<img src=\"");
+            writeText(imageFormat.name());
+            write("\"");
+            if (imageFormat.width() > 0)
+                write(QStringLiteral(" width=\"") + QString::number(imageFormat.width()) + QLatin1Char('"'));
+            if (imageFormat.height() > 0)
+                write(QStringLiteral(" height=\"") + QString::number(imageFormat.height()) + QLatin1Char('"'));
+            write(" />");
+        }
+    } else if (format.objectType() == HLineTextObject::HLineTextFormat) {
+        write("<hr />");
+    } else if (format.objectType() == QTextFormat::NoObject) {
+        writeText(text);
+    }
+    // Other objects, like charts, have no HTML representation
+
+    if (!style.isEmpty())
+        write("</span>");
+    if (openedAnchors)
+        write("</a>");
+}
+
+QString KDReports::HtmlWriter::charFormatStyle(const QTextCharFormat &format) const
+{
+    const QFont font = format.font().resolve(m_defaultFont);
+    QString style;
+    if (font.family() != m_defaultFont.family())
+        style += QStringLiteral("font-family:'") + font.family() + QStringLiteral("'; ");
+    if (font.pointSizeF() > 0 && font.pointSizeF() != m_defaultFont.pointSizeF())
+        style += QStringLiteral("font-size:") + QString::number(font.pointSizeF()) + QStringLiteral("pt; ");
+    else if (font.pixelSize() > 0 && font.pixelSize() != m_defaultFont.pixelSize())
+        style += QStringLiteral("font-size:") + QString::number(font.pixelSize()) + QStringLiteral("px; ");
+    if (font.bold() != m_defaultFont.bold())
+        style += font.bold() ? QStringLiteral("font-weight:bold; ") : QStringLiteral("font-weight:normal; ");
+    if (font.italic() != m_defaultFont.italic())
+        style += font.italic() ? QStringLiteral("font-style:italic; ") : QStringLiteral("font-style:normal; ");
+    if (font.underline() && font.strikeOut())
+        style += QStringLiteral("text-decoration:underline line-through; ");
+    else if (font.underline())
+        style += QStringLiteral("text-decoration:underline; ");
+    else if (font.strikeOut())
+        style += QStringLiteral("text-decoration:line-through; ");
+    if (format.verticalAlignment() == QTextCharFormat::AlignSuperScript)
+        style += QStringLiteral("vertical-align:super; ");
+    else if (format.verticalAlignment() == QTextCharFormat::AlignSubScript)
+        style += QStringLiteral("vertical-align:sub; ");
+    style += brushStyle("color", format.foreground());
+    style += brushStyle("background-color", format.background());
+    return style;
+}
+
+void KDReports::HtmlWriter::writeText(const QString &text)
+{
+    QString escaped;
+    escaped.reserve(text.size());
+    for (const QChar ch : text) {
+        switch (ch.unicode()) {
+        case '<':
+            escaped += QStringLiteral("&lt;");
+            break;
+        case '>':
+            escaped += QStringLiteral("&gt;");
+            break;
+        case '&':
+            escaped += QStringLiteral("&amp;");
+            break;
+        case '"':
+            escaped += QStringLiteral("&quot;");
+            break;
+        case QChar::LineSeparator:
+            escaped += QStringLiteral("<br />");
+            break;
+        case QChar::Nbsp:
+            escaped += QStringLiteral("&nbsp;");
+            break;
+        case QChar::ObjectReplacementCharacter:
+            break;
+        default:
+            escaped += ch;
+            break;
+        }
+    }
+    write(escaped);
+}
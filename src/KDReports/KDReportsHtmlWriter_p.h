@@ -0,0 +1,61 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSHTMLWRITER_P_H
+#define KDREPORTSHTMLWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsDocumentWriter_p.h"
+
+QT_BEGIN_NAMESPACE
+class QTextCharFormat;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Writes a QTextDocument as HTML.
+ *
+ * Unlike QTextDocument::toHtml(), the HTML is never held in memory as a whole (see DocumentWriter).
+ * Only the properties which differ from the defaults are written.
+ */
+class HtmlWriter : public DocumentWriter
+{
+public:
+    explicit HtmlWriter(const QTextDocument *document);
+
+protected:
+    void writeDocument() override;
+    void beginList(const QTextList *list) override;
+    void endList(const QTextList *list) override;
+    void writeFrame(const QTextFrame *frame) override;
+    void writeTable(const QTextTable *table) override;
+    void writeBlock(const QTextBlock &block) override;
+    void writeFragment(const QTextFragment &fragment) override;
+
+private:
+    QString charFormatStyle(const QTextCharFormat &format) const;
+    void writeText(const QString &text);
+};
+
+}
+
+#endif /* KDREPORTSHTMLWRITER_P_H */
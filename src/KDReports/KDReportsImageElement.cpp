@@ -162,7 +162,6 @@ void KDReports::ImageElement::build(ReportBuilder &builder) const
         } else {
             imageFormat.setProperty(ResizableImageProperty, QString(QLatin1Char('W') + QString::number(d->m_width)));
             KDReports::TextDocumentData::updatePercentSize(imageFormat, QSizeF(builder.report()->d->textDocumentWidth(), -1 /*unknown*/));
-            builder.currentDocumentData().setHasResizableImages();
         }
     } else if (d->m_height) {
         if (d->m_unit == Millimeters) {
@@ -172,16 +171,17 @@ void KDReports::ImageElement::build(ReportBuilder &builder) const
             imageFormat.setWidth(pixelWidth);
         } else {
             imageFormat.setProperty(ResizableImageProperty, QString(QLatin1Char('H') + QString::number(d->m_height)));
-            builder.currentDocumentData().setHasResizableImages();
             // can't calc size yet, will be done at layouting time... hopefully.
         }
     } else if (d->m_fitToPage) {
         imageFormat.setProperty(ResizableImageProperty, QString(QLatin1Char('T')));
-        builder.currentDocumentData().setHasResizableImages();
     }
 
     QTextCursor &cursor = builder.cursor();
     cursor.insertImage(imageFormat);
+    if (imageFormat.hasProperty(ResizableImageProperty)) {
+        builder.currentDocumentData().registerResizableImage(cursor.position() - 1);
+    }
 }
 
 void KDReports::ImageElement::setId(const QString &id)
@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsMarkdownWriter_p.h"
+#include "KDReportsHLineTextObject_p.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextList>
+#include <QTextTable>
+
+#include <algorithm>
+
+KDReports::MarkdownWriter::MarkdownWriter(const QTextDocument *document)
+    : DocumentWriter(document)
+{
+}
+
+void KDReports::MarkdownWriter::writeDocument()
+{
+    writeItems(m_document->rootFrame()->begin());
+}
+
+void KDReports::MarkdownWriter::beginList(const QTextList *)
+{
+}
+
+void KDReports::MarkdownWriter::endList(const QTextList *)
+{
+    write("\n");
+}
+
+void KDReports::MarkdownWriter::writeTable(const QTextTable *table)
+{
+    // Markdown tables always have a header row, so the first row is used as such
+    for (int row = 0; row < table->rows(); ++row) {
+        write("|");
+        for (int column = 0; column < table->columns(); ++column) {
+            const QTextTableCell cell = table->cellAt(row, column);
+            if (cell.row() == row && cell.column() == column) { // not covered by a spanning cell
+                write(" ");
+                m_inTableCell = true;
+                m_atLineStart = false;
+                // The blocks of the cell, including those of nested tables, on a single line
+                const QTextBlock firstBlock = m_document->findBlock(cell.firstPosition());
+                for (QTextBlock block = firstBlock; block.isValid() && block.position() <= cell.lastPosition(); block = block.next()) {
+                    if (block != firstBlock)
+                        write("<br>");
+                    writeFragments(block);
+                }
+                m_inTableCell = false;
+            }
+            write(" |");
+        }
+        write("\n");
+        if (row == 0) {
+            write("|");
+            for (int column = 0; column < table->columns(); ++column)
+                write(" --- |");
+            write("\n");
+        }
+    }
+    write("\n");
+}
+
+void KDReports::MarkdownWriter::writeBlock(const QTextBlock &block)
+{
+    if (const QTextList *list = block.textList()) {
+        const int level = qMax(1, list->format().indent()) - 1;
+        write(QString(level * 4, QLatin1Char(' ')));
+        if (isOrderedList(list))
+            write(QString::number(list->itemNumber(block) + 1) + QStringLiteral(". "));
+        else
+            write("- ");
+        m_atLineStart = true;
+        writeFragments(block);
+        write("\n");
+    } else if (block.length() > 1) {
+        m_atLineStart = true;
+        writeFragments(block);
+        write("\n\n");
+    }
+    // Empty paragraphs have no Markdown representation
+}
+
+void KDReports::MarkdownWriter::writeFragment(const QTextFragment &fragment)
+{
+    const QTextCharFormat format = fragment.charFormat();
+    const QString text = fragment.text();
+    if (format.objectType() != QTextFormat::NoObject)
+        m_atLineStart = false;
+    if (format.isImageFormat()) {
+        // One object replacement character per image
+        const QString image = QStringLiteral("![](<") + format.toImageFormat().name() + QStringLiteral(">)");
+        for (int i = 0; i < text.length(); ++i)
+            write(image);
+        return;
+    }
+    if (format.objectType() == HLineTextObject::HLineTextFormat) {
+        write(m_inTableCell ? "<hr>" : "\n\n---\n\n");
+        m_atLineStart = !m_inTableCell;
+        return;
+    }
+    if (format.objectType() != QTextFormat::NoObject)
+        return; // other objects, like charts, have no Markdown representation
+
+    // Emphasis markers must be next to non-whitespace characters
+    int start = 0;
+    while (start < text.length() && text.at(start).isSpace())
+        ++start;
+    int end = text.length();
+    while (end > start && text.at(end - 1).isSpace())
+        --end;
+    if (start == end) {
+        writeText(text);
+        return;
+    }
+
+    const QFont font = format.font().resolve(m_defaultFont);
+    QString markers;
+    if (font.bold() && !m_defaultFont.bold())
+        markers += QStringLiteral("**");
+    if (font.italic() && !m_defaultFont.italic())
+        markers += QLatin1Char('*');
+    if (font.strikeOut())
+        markers += QStringLiteral("~~");
+    QString closingMarkers = markers;
+    std::reverse(closingMarkers.begin(), closingMarkers.end());
+
+    writeText(text.left(start));
+    const QString href = format.isAnchor() ? format.anchorHref() : QString();
+    if (!href.isEmpty() || !markers.isEmpty())
+        m_atLineStart = false;
+    if (!href.isEmpty())
+        write("[");
+    write(markers);
+    writeText(text.mid(start, end - start));
+    write(closingMarkers);
+    if (!href.isEmpty())
+        write(QStringLiteral("](<") + href + QStringLiteral(">)"));
+    writeText(text.mid(end));
+}
+
+void KDReports::MarkdownWriter::writeText(const QString &text)
+{
+    QString escaped;
+    escaped.reserve(text.size());
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar ch = text.at(i);
+        if (m_atLineStart && ch != QLatin1Char(' ')) {
+            m_atLineStart = false;
+            // List markers are only special at the start of a line, unlike the other markers escaped below
+            if (ch == QLatin1Char('-') || ch == QLatin1Char('+')) {
+                escaped += QLatin1Char('\\');
+                escaped += ch;
+                continue;
+            }
+            int end = i;
+            while (end < text.size() && text.at(end) >= QLatin1Char('0') && text.at(end) <= QLatin1Char('9'))
+                ++end;
+            if (end > i && end < text.size() && (text.at(end) == QLatin1Char('.') || text.at(end) == QLatin1Char(')'))) {
+                escaped += text.mid(i, end - i);
+                escaped += QLatin1Char('\\');
+                escaped += text.at(end);
+                i = end;
+                continue;
+            }
+        }
+        switch (ch.unicode()) {
+        case '\\':
+        case '`':
+        case '*':
+        case '_':
+        case '~':
+        case '[':
+        case ']':
+        case '<':
+        case '>':
+        case '#':
+        case '|':
+            escaped += QLatin1Char('\\');
+            escaped += ch;
+            break;
+        case QChar::LineSeparator:
+            if (m_inTableCell) {
+                escaped += QStringLiteral("<br>");
+            } else {
+                escaped += QStringLiteral("\\\n");
+                m_atLineStart = true;
+            }
+            break;
+        case QChar::Nbsp:
+            escaped += QStringLiteral("&nbsp;");
+            break;
+        case QChar::ObjectReplacementCharacter:
+            break;
+        default:
+            escaped += ch;
+            break;
+        }
+    }
+    write(escaped);
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSMARKDOWNWRITER_P_H
+#define KDREPORTSMARKDOWNWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsDocumentWriter_p.h"
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Writes a QTextDocument as Markdown (CommonMark, with GitHub-style tables).
+ *
+ * Only what Markdown can express is written: paragraphs, lists, tables, links, images
+ * (referring to the image resources by name), bold, italic and strike-out text.
+ * Table cells hold a single line, so the paragraphs of a cell are separated with <br>,
+ * and nested tables are flattened.
+ * Text which Markdown would take for markup, like a '#' anywhere or a '-' at the start of a line, is escaped.
+ */
+class MarkdownWriter : public DocumentWriter
+{
+public:
+    explicit MarkdownWriter(const QTextDocument *document);
+
+protected:
+    void writeDocument() override;
+    void beginList(const QTextList *list) override;
+    void endList(const QTextList *list) override;
+    void writeTable(const QTextTable *table) override;
+    void writeBlock(const QTextBlock &block) override;
+    void writeFragment(const QTextFragment &fragment) override;
+
+private:
+    void writeText(const QString &text);
+
+    int m_listDepth = 0;
+    bool m_inTableCell = false;
+    bool m_atLineStart = false; // the next text could be taken for a list marker, see writeText
+};
+
+}
+
+#endif /* KDREPORTSMARKDOWNWRITER_P_H */
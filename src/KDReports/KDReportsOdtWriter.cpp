@@ -0,0 +1,420 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsOdtWriter_p.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextList>
+#include <QTextTable>
+#include <QUrl>
+
+static const int s_listLevels = 5; // deeper lists are indented like the last level
+
+static QString attribute(const char *name, const QString &value)
+{
+    if (value.isEmpty())
+        return QString();
+    return QLatin1Char(' ') + QString::fromLatin1(name) + QStringLiteral("=\"") + value.toHtmlEscaped() + QLatin1Char('"');
+}
+
+static QString pixelAttribute(const char *name, qreal value)
+{
+    if (value == 0)
+        return QString();
+    return attribute(name, QString::number(value) + QStringLiteral("px"));
+}
+
+static QString colorAttribute(const char *name, const QBrush &brush)
+{
+    if (brush.style() == Qt::NoBrush)
+        return QString();
+    return attribute(name, brush.color().name());
+}
+
+static int listLevel(const QTextList *list)
+{
+    return qBound(1, list->format().indent(), s_listLevels);
+}
+
+KDReports::OdtWriter::OdtWriter(const QTextDocument *document)
+    : DocumentWriter(document)
+{
+}
+
+void KDReports::OdtWriter::writeDocument()
+{
+    write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<office:document"
+          " xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\""
+          " xmlns:style=\"urn:oasis:names:tc:opendocument:xmlns:style:1.0\""
+          " xmlns:text=\"urn:oasis:names:tc:opendocument:xmlns:text:1.0\""
+          " xmlns:table=\"urn:oasis:names:tc:opendocument:xmlns:table:1.0\""
+          " xmlns:draw=\"urn:oasis:names:tc:opendocument:xmlns:drawing:1.0\""
+          " xmlns:fo=\"urn:oasis:names:tc:opendocument:xmlns:xsl-fo-compatible:1.0\""
+          " xmlns:svg=\"urn:oasis:names:tc:opendocument:xmlns:svg-compatible:1.0\""
+          " xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+          " xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+          " office:version=\"1.2\" office:mimetype=\"application/vnd.oasis.opendocument.text\">\n");
+
+    const QString title = m_document->metaInformation(QTextDocument::DocumentTitle);
+    if (!title.isEmpty()) {
+        write("<office:meta><dc:title>");
+        writeText(title);
+        write("</dc:title></office:meta>\n");
+    }
+
+    QString defaultTextProperties = attribute("fo:font-family", m_defaultFont.family());
+    if (m_defaultFont.pointSizeF() > 0)
+        defaultTextProperties += attribute("fo:font-size", QString::number(m_defaultFont.pointSizeF()) + QStringLiteral("pt"));
+    write(QStringLiteral("<office:styles>\n<style:default-style style:family=\"paragraph\"><style:text-properties") + defaultTextProperties
+          + QStringLiteral("/></style:default-style>\n"));
+    writeFillImages();
+    write("</office:styles>\n");
+
+    writeAutomaticStyles();
+
+    write("<office:body>\n<office:text>\n");
+    writeItems(m_document->rootFrame()->begin());
+    write("</office:text>\n</office:body>\n</office:document>\n");
+}
+
+void KDReports::OdtWriter::writeFillImages()
+{
+    // A flat file has no pictures directory which several frames could refer to, so each image
+    // is written once as a fill image, which is then used as the background of its frames
+    const QVector<QTextFormat> formats = m_document->allFormats();
+    for (const QTextFormat &format : formats) {
+        if (!format.isImageFormat())
+            continue;
+        const QImage image = imageResource(format.toImageFormat());
+        if (image.isNull() || m_imageNumbers.contains(image.cacheKey()))
+            continue;
+        const int number = m_imageNumbers.size() + 1;
+        m_imageNumbers.insert(image.cacheKey(), number);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        write(QStringLiteral("<draw:fill-image draw:name=\"Image") + QString::number(number) + QStringLiteral("\"><office:binary-data>"));
+        write(buffer.data().toBase64());
+        write("</office:binary-data></draw:fill-image>\n");
+    }
+}
+
+void KDReports::OdtWriter::writeAutomaticStyles()
+{
+    write("<office:automatic-styles>\n");
+
+    // One style per format: identical formats share the same index in the document
+    const QVector<QTextFormat> formats = m_document->allFormats();
+    QVector<int> tableCellFormats;
+    for (int index = 0; index < formats.size(); ++index) {
+        if (formats.at(index).isTableCellFormat())
+            tableCellFormats.append(index);
+    }
+    for (int index = 0; index < formats.size(); ++index) {
+        const QTextFormat &format = formats.at(index);
+        if (format.isBlockFormat()) {
+            write(QStringLiteral("<style:style style:name=\"P") + QString::number(index) + QStringLiteral("\" style:family=\"paragraph\"><style:paragraph-properties")
+                  + paragraphProperties(format.toBlockFormat()) + QStringLiteral("/></style:style>\n"));
+        } else if (format.isTableFormat()) {
+            const QTextTableFormat tableFormat = format.toTableFormat();
+            QString tableProperties;
+            if (tableFormat.alignment() & Qt::AlignHCenter)
+                tableProperties += attribute("table:align", QStringLiteral("center"));
+            else if (tableFormat.alignment() & Qt::AlignRight)
+                tableProperties += attribute("table:align", QStringLiteral("right"));
+            else if (tableFormat.width().type() != QTextLength::VariableLength)
+                tableProperties += attribute("table:align", QStringLiteral("left"));
+            if (tableFormat.width().type() == QTextLength::PercentageLength)
+                tableProperties += attribute("style:rel-width", QString::number(tableFormat.width().rawValue()) + QLatin1Char('%'));
+            else if (tableFormat.width().type() == QTextLength::FixedLength)
+                tableProperties += pixelAttribute("style:width", tableFormat.width().rawValue());
+            tableProperties += colorAttribute("fo:background-color", tableFormat.background());
+            const QString name = QStringLiteral("Tbl") + QString::number(index);
+            write(QStringLiteral("<style:style style:name=\"") + name + QStringLiteral("\" style:family=\"table\"><style:table-properties") + tableProperties
+                  + QStringLiteral("/></style:style>\n"));
+            // The borders and padding of a table are properties of its cells in ODF,
+            // so each table format gets its cell styles
+            write(QStringLiteral("<style:style style:name=\"") + name + QStringLiteral("C\" style:family=\"table-cell\"><style:table-cell-properties")
+                  + tableCellProperties(tableFormat, QTextTableCellFormat()) + QStringLiteral("/></style:style>\n"));
+            for (int cellIndex : std::as_const(tableCellFormats)) {
+                write(QStringLiteral("<style:style style:name=\"") + name + QLatin1Char('C') + QString::number(cellIndex)
+                      + QStringLiteral("\" style:family=\"table-cell\"><style:table-cell-properties")
+                      + tableCellProperties(tableFormat, formats.at(cellIndex).toTableCellFormat()) + QStringLiteral("/></style:style>\n"));
+            }
+        } else if (format.isCharFormat() && format.objectType() == QTextFormat::NoObject) {
+            const QString properties = textProperties(format.toCharFormat());
+            if (!properties.isEmpty()) {
+                m_textStyles.insert(index);
+                write(QStringLiteral("<style:style style:name=\"T") + QString::number(index) + QStringLiteral("\" style:family=\"text\"><style:text-properties")
+                      + properties + QStringLiteral("/></style:style>\n"));
+            }
+        }
+    }
+
+    // One frame style per image, see writeFillImages
+    for (int number = 1; number <= m_imageNumbers.size(); ++number) {
+        write(QStringLiteral("<style:style style:name=\"Gr") + QString::number(number) + QStringLiteral("\" style:family=\"graphic\"><style:graphic-properties")
+              + QStringLiteral(" draw:fill=\"bitmap\" draw:fill-image-name=\"Image") + QString::number(number)
+              + QStringLiteral("\" style:repeat=\"stretch\" draw:stroke=\"none\" fo:border=\"none\" fo:padding=\"0\"/></style:style>\n"));
+    }
+
+    // List styles, by nesting level: Qt lists are flat, they only have an indentation
+    for (int level = 1; level <= s_listLevels; ++level) {
+        const QString levelProperties = QStringLiteral("<style:list-level-properties") + pixelAttribute("text:space-before", (level - 1) * m_document->indentWidth())
+            + pixelAttribute("text:min-label-width", m_document->indentWidth()) + QStringLiteral("/>");
+        write(QStringLiteral("<text:list-style style:name=\"LB") + QString::number(level) + QStringLiteral("\"><text:list-level-style-bullet text:level=\"1\" text:bullet-char=\"")
+              + QChar(0x2022) + QStringLiteral("\">") + levelProperties + QStringLiteral("</text:list-level-style-bullet></text:list-style>\n"));
+        write(QStringLiteral("<text:list-style style:name=\"LN") + QString::number(level)
+              + QStringLiteral("\"><text:list-level-style-number text:level=\"1\" style:num-suffix=\".\" style:num-format=\"1\">") + levelProperties
+              + QStringLiteral("</text:list-level-style-number></text:list-style>\n"));
+    }
+
+    write("</office:automatic-styles>\n");
+}
+
+QString KDReports::OdtWriter::paragraphProperties(const QTextBlockFormat &format) const
+{
+    QString properties;
+    switch (format.alignment() & Qt::AlignHorizontal_Mask) {
+    case Qt::AlignRight:
+        properties += attribute("fo:text-align", QStringLiteral("end"));
+        break;
+    case Qt::AlignHCenter:
+        properties += attribute("fo:text-align", QStringLiteral("center"));
+        break;
+    case Qt::AlignJustify:
+        properties += attribute("fo:text-align", QStringLiteral("justify"));
+        break;
+    default:
+        break;
+    }
+    properties += pixelAttribute("fo:margin-top", format.topMargin());
+    properties += pixelAttribute("fo:margin-bottom", format.bottomMargin());
+    properties += pixelAttribute("fo:margin-left", format.leftMargin() + format.indent() * m_document->indentWidth());
+    properties += pixelAttribute("fo:margin-right", format.rightMargin());
+    properties += pixelAttribute("fo:text-indent", format.textIndent());
+    properties += colorAttribute("fo:background-color", format.background());
+    if (format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysBefore)
+        properties += attribute("fo:break-before", QStringLiteral("page"));
+    if (format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysAfter)
+        properties += attribute("fo:break-after", QStringLiteral("page"));
+    return properties;
+}
+
+QString KDReports::OdtWriter::textProperties(const QTextCharFormat &format) const
+{
+    const QFont font = format.font().resolve(m_defaultFont);
+    QString properties;
+    if (font.family() != m_defaultFont.family())
+        properties += attribute("fo:font-family", font.family());
+    if (font.pointSizeF() > 0 && font.pointSizeF() != m_defaultFont.pointSizeF())
+        properties += attribute("fo:font-size", QString::number(font.pointSizeF()) + QStringLiteral("pt"));
+    else if (font.pixelSize() > 0 && font.pixelSize() != m_defaultFont.pixelSize())
+        properties += pixelAttribute("fo:font-size", font.pixelSize());
+    if (font.bold() != m_defaultFont.bold())
+        properties += attribute("fo:font-weight", font.bold() ? QStringLiteral("bold") : QStringLiteral("normal"));
+    if (font.italic() != m_defaultFont.italic())
+        properties += attribute("fo:font-style", font.italic() ? QStringLiteral("italic") : QStringLiteral("normal"));
+    if (font.underline())
+        properties += QStringLiteral(" style:text-underline-style=\"solid\" style:text-underline-width=\"auto\" style:text-underline-color=\"font-color\"");
+    if (font.strikeOut())
+        properties += attribute("style:text-line-through-style", QStringLiteral("solid"));
+    if (format.verticalAlignment() == QTextCharFormat::AlignSuperScript)
+        properties += attribute("style:text-position", QStringLiteral("super 58%"));
+    else if (format.verticalAlignment() == QTextCharFormat::AlignSubScript)
+        properties += attribute("style:text-position", QStringLiteral("sub 58%"));
+    properties += colorAttribute("fo:color", format.foreground());
+    properties += colorAttribute("fo:background-color", format.background());
+    return properties;
+}
+
+QString KDReports::OdtWriter::tableCellProperties(const QTextTableFormat &tableFormat, const QTextTableCellFormat &cellFormat) const
+{
+    QString properties;
+    if (tableFormat.border() > 0) {
+        properties += attribute("fo:border", QString::number(tableFormat.border()) + QStringLiteral("px solid ") + tableFormat.borderBrush().color().name());
+    }
+    properties += pixelAttribute("fo:padding", tableFormat.cellPadding());
+    properties += colorAttribute("fo:background-color", cellFormat.background());
+    switch (cellFormat.verticalAlignment()) {
+    case QTextCharFormat::AlignMiddle:
+        properties += attribute("style:vertical-align", QStringLiteral("middle"));
+        break;
+    case QTextCharFormat::AlignBottom:
+        properties += attribute("style:vertical-align", QStringLiteral("bottom"));
+        break;
+    default:
+        break;
+    }
+    return properties;
+}
+
+void KDReports::OdtWriter::beginList(const QTextList *list)
+{
+    const QString styleName = (isOrderedList(list) ? QStringLiteral("LN") : QStringLiteral("LB")) + QString::number(listLevel(list));
+    write(QStringLiteral("<text:list text:style-name=\"") + styleName + QStringLiteral("\">\n"));
+    m_inList = true;
+}
+
+void KDReports::OdtWriter::endList(const QTextList *)
+{
+    write("</text:list>\n");
+    m_inList = false;
+}
+
+void KDReports::OdtWriter::writeTable(const QTextTable *table)
+{
+    const QTextTableFormat format = table->format();
+    const QString styleName = QStringLiteral("Tbl") + QString::number(table->formatIndex());
+    write(QStringLiteral("<table:table table:name=\"Table") + QString::number(++m_tableCount) + QStringLiteral("\" table:style-name=\"") + styleName
+          + QStringLiteral("\">\n<table:table-column table:number-columns-repeated=\"") + QString::number(table->columns()) + QStringLiteral("\"/>\n"));
+    const int headerRowCount = qMin(format.headerRowCount(), table->rows());
+    for (int row = 0; row < table->rows(); ++row) {
+        if (row == 0 && headerRowCount > 0)
+            write("<table:table-header-rows>\n");
+        write("<table:table-row>\n");
+        for (int column = 0; column < table->columns(); ++column) {
+            const QTextTableCell cell = table->cellAt(row, column);
+            if (cell.row() != row || cell.column() != column) {
+                write("<table:covered-table-cell/>\n");
+                continue;
+            }
+            QString cellStyleName = styleName + QLatin1Char('C');
+            if (cell.format().isTableCellFormat())
+                cellStyleName += QString::number(cell.tableCellFormatIndex());
+            QString attributes = attribute("table:style-name", cellStyleName);
+            if (cell.rowSpan() > 1)
+                attributes += attribute("table:number-rows-spanned", QString::number(cell.rowSpan()));
+            if (cell.columnSpan() > 1)
+                attributes += attribute("table:number-columns-spanned", QString::number(cell.columnSpan()));
+            write(QStringLiteral("<table:table-cell") + attributes + QStringLiteral(" office:value-type=\"string\">\n"));
+            const bool inList = m_inList;
+            m_inList = false;
+            writeItems(cell.begin());
+            m_inList = inList;
+            write("</table:table-cell>\n");
+        }
+        write("</table:table-row>\n");
+        if (row == headerRowCount - 1)
+            write("</table:table-header-rows>\n");
+    }
+    write("</table:table>\n");
+}
+
+void KDReports::OdtWriter::writeBlock(const QTextBlock &block)
+{
+    if (m_inList) {
+        write("<text:list-item");
+        const QTextList *list = block.textList();
+        const int itemNumber = list->itemNumber(block);
+        if (isOrderedList(list) && itemNumber > 0 && block.previous().textList() != list) {
+            // The list was interrupted, e.g. by a nested list, so it's a new text:list in ODF
+            write(QStringLiteral(" text:start-value=\"") + QString::number(itemNumber + 1) + QLatin1Char('"'));
+        }
+        write(">");
+    }
+    write(QStringLiteral("<text:p text:style-name=\"P") + QString::number(block.blockFormatIndex()) + QStringLiteral("\">"));
+    writeFragments(block);
+    write("</text:p>");
+    if (m_inList)
+        write("</text:list-item>");
+    write("\n");
+}
+
+void KDReports::OdtWriter::writeFragment(const QTextFragment &fragment)
+{
+    const QTextCharFormat format = fragment.charFormat();
+    if (format.isImageFormat()) {
+        // One object replacement character per image
+        for (int i = 0; i < fragment.length(); ++i)
+            writeImage(format.toImageFormat());
+        return;
+    }
+    if (format.objectType() != QTextFormat::NoObject)
+        return; // other objects, like charts and lines, have no ODT representation
+
+    if (format.isAnchor()) {
+        const QStringList names = format.anchorNames();
+        for (const QString &name : names)
+            write(QStringLiteral("<text:bookmark") + attribute("text:name", name) + QStringLiteral("/>"));
+    }
+    const QString href = format.isAnchor() ? format.anchorHref() : QString();
+    if (!href.isEmpty())
+        write(QStringLiteral("<text:a xlink:type=\"simple\"") + attribute("xlink:href", href) + QLatin1Char('>'));
+    const bool hasStyle = m_textStyles.contains(fragment.charFormatIndex());
+    if (hasStyle)
+        write(QStringLiteral("<text:span text:style-name=\"T") + QString::number(fragment.charFormatIndex()) + QStringLiteral("\">"));
+    writeText(fragment.text());
+    if (hasStyle)
+        write("</text:span>");
+    if (!href.isEmpty())
+        write("</text:a>");
+}
+
+QImage KDReports::OdtWriter::imageResource(const QTextImageFormat &format) const
+{
+    return m_document->resource(QTextDocument::ImageResource, QUrl(format.name())).value<QImage>();
+}
+
+void KDReports::OdtWriter::writeImage(const QTextImageFormat &format)
+{
+    const QImage image = imageResource(format);
+    const auto it = m_imageNumbers.constFind(image.cacheKey());
+    if (image.isNull() || it == m_imageNumbers.constEnd())
+        return;
+    const qreal width = format.width() > 0 ? format.width() : image.width();
+    const qreal height = format.height() > 0 ? format.height() : image.height();
+    write(QStringLiteral("<draw:frame text:anchor-type=\"as-char\" draw:style-name=\"Gr") + QString::number(*it) + QLatin1Char('"')
+          + pixelAttribute("svg:width", width) + pixelAttribute("svg:height", height) + QStringLiteral("><draw:text-box/></draw:frame>"));
+}
+
+void KDReports::OdtWriter::writeText(const QString &text)
+{
+    QString escaped;
+    escaped.reserve(text.size());
+    QChar previous;
+    for (const QChar ch : text) {
+        switch (ch.unicode()) {
+        case '<':
+            escaped += QStringLiteral("&lt;");
+            break;
+        case '>':
+            escaped += QStringLiteral("&gt;");
+            break;
+        case '&':
+            escaped += QStringLiteral("&amp;");
+            break;
+        case ' ':
+            // Consecutive spaces are collapsed in ODF, unless written as <text:s/>
+            if (previous == QLatin1Char(' '))
+                escaped += QStringLiteral("<text:s/>");
+            else
+                escaped += ch;
+            break;
+        case '\t':
+            escaped += QStringLiteral("<text:tab/>");
+            break;
+        case QChar::LineSeparator:
+            escaped += QStringLiteral("<text:line-break/>");
+            break;
+        case QChar::ObjectReplacementCharacter:
+            break;
+        default:
+            escaped += ch;
+            break;
+        }
+        previous = ch;
+    }
+    write(escaped);
+}
@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSODTWRITER_P_H
+#define KDREPORTSODTWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsDocumentWriter_p.h"
+
+#include <QHash>
+#include <QSet>
+
+QT_BEGIN_NAMESPACE
+class QImage;
+class QTextBlockFormat;
+class QTextCharFormat;
+class QTextImageFormat;
+class QTextTableFormat;
+class QTextTableCellFormat;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Writes a QTextDocument as a flat OpenDocument Text file (.fodt): a single XML document,
+ * which, unlike a zipped .odt package, can be written as the document is walked.
+ * Images are embedded once each, as PNG fill images, which are the background of a frame for each occurrence.
+ *
+ * The styles are written before the body, from QTextDocument::allFormats(), so that the
+ * paragraphs and spans can then refer to them by format index without a first pass over the document.
+ */
+class OdtWriter : public DocumentWriter
+{
+public:
+    explicit OdtWriter(const QTextDocument *document);
+
+protected:
+    void writeDocument() override;
+    void beginList(const QTextList *list) override;
+    void endList(const QTextList *list) override;
+    void writeTable(const QTextTable *table) override;
+    void writeBlock(const QTextBlock &block) override;
+    void writeFragment(const QTextFragment &fragment) override;
+
+private:
+    void writeFillImages();
+    void writeAutomaticStyles();
+    QString paragraphProperties(const QTextBlockFormat &format) const;
+    QString textProperties(const QTextCharFormat &format) const;
+    QString tableCellProperties(const QTextTableFormat &tableFormat, const QTextTableCellFormat &cellFormat) const;
+    QImage imageResource(const QTextImageFormat &format) const;
+    void writeImage(const QTextImageFormat &format);
+    void writeText(const QString &text);
+
+    QSet<int> m_textStyles; // the char format indexes which have a text style
+    QHash<qint64, int> m_imageNumbers; // the number of the fill image, by QImage::cacheKey()
+    int m_tableCount = 0;
+    bool m_inList = false;
+};
+
+}
+
+#endif /* KDREPORTSODTWRITER_P_H */
@@ -0,0 +1,154 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsPageListModel_p.h"
+
+#include <QImage>
+
+#include <algorithm>
+
+// About 200 thumbnails of 200x200 pixels, whatever the number of pages
+static const int s_thumbnailCacheSizeKB = 32 * 1024;
+
+KDReports::PageListModel::PageListModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_thumbnails(s_thumbnailCacheSizeKB)
+{
+    m_requestTimer.setSingleShot(true);
+    connect(&m_requestTimer, &QTimer::timeout, this, [this]() { requestMissingThumbnails(); });
+}
+
+void KDReports::PageListModel::setPageCount(int pageCount)
+{
+    if (pageCount > m_pageCount) {
+        beginInsertRows(QModelIndex(), m_pageCount, pageCount - 1);
+        m_checked.resize(pageCount);
+        m_checked.fill(true, m_pageCount, pageCount);
+        m_pageCount = pageCount;
+        endInsertRows();
+    } else if (pageCount < m_pageCount) {
+        beginRemoveRows(QModelIndex(), pageCount, m_pageCount - 1);
+        for (int pageNumber = pageCount; pageNumber < m_pageCount; ++pageNumber)
+            m_thumbnails.remove(pageNumber);
+        m_checked.resize(pageCount);
+        m_pageCount = pageCount;
+        endRemoveRows();
+    }
+}
+
+void KDReports::PageListModel::setThumbnailSize(int size, qreal devicePixelRatio)
+{
+    if (!m_placeholder.isNull() && m_placeholder.width() == qRound(size * devicePixelRatio) && m_placeholder.devicePixelRatio() == devicePixelRatio)
+        return;
+    m_placeholder = QPixmap(qRound(size * devicePixelRatio), qRound(size * devicePixelRatio));
+    m_placeholder.setDevicePixelRatio(devicePixelRatio);
+    m_placeholder.fill(Qt::white);
+    clearThumbnails();
+}
+
+void KDReports::PageListModel::setThumbnail(int pageNumber, const QImage &image)
+{
+    if (pageNumber < 0 || pageNumber >= m_pageCount)
+        return;
+    const int costKB = qMax(1, image.bytesPerLine() * image.height() / 1024);
+    m_thumbnails.insert(pageNumber, new QPixmap(QPixmap::fromImage(image)), costKB);
+    const QModelIndex idx = index(pageNumber);
+    Q_EMIT dataChanged(idx, idx, {Qt::DecorationRole});
+}
+
+void KDReports::PageListModel::clearThumbnails()
+{
+    m_thumbnails.clear();
+    m_missing.clear();
+    if (m_pageCount > 0)
+        Q_EMIT dataChanged(index(0), index(m_pageCount - 1), {Qt::DecorationRole});
+}
+
+bool KDReports::PageListModel::isChecked(int pageNumber) const
+{
+    return pageNumber >= 0 && pageNumber < m_pageCount && m_checked.testBit(pageNumber);
+}
+
+int KDReports::PageListModel::checkedCount() const
+{
+    return m_checked.count(true);
+}
+
+void KDReports::PageListModel::setCheckedRange(int fromPage, int toPage)
+{
+    m_checked.fill(false);
+    fromPage = qMax(fromPage, 0);
+    toPage = qMin(toPage, m_pageCount - 1);
+    if (fromPage <= toPage)
+        m_checked.fill(true, fromPage, toPage + 1);
+    if (m_pageCount > 0)
+        Q_EMIT dataChanged(index(0), index(m_pageCount - 1), {Qt::CheckStateRole});
+}
+
+int KDReports::PageListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_pageCount;
+}
+
+QVariant KDReports::PageListModel::data(const QModelIndex &index, int role) const
+{
+    const int pageNumber = index.row();
+    if (!index.isValid() || pageNumber >= m_pageCount)
+        return QVariant();
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString::number(pageNumber + 1);
+    case Qt::CheckStateRole:
+        return m_checked.testBit(pageNumber) ? Qt::Checked : Qt::Unchecked;
+    case Qt::DecorationRole:
+        if (const QPixmap *thumbnail = m_thumbnails.object(pageNumber))
+            return *thumbnail;
+        // The view only asks for the items it paints, so these are the visible pages
+        if (!m_missing.contains(pageNumber))
+            m_missing.append(pageNumber);
+        m_requestTimer.start(0);
+        return m_placeholder;
+    default:
+        return QVariant();
+    }
+}
+
+bool KDReports::PageListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row() >= m_pageCount || role != Qt::CheckStateRole)
+        return false;
+    m_checked.setBit(index.row(), static_cast<Qt::CheckState>(value.toInt()) == Qt::Checked);
+    Q_EMIT dataChanged(index, index, {Qt::CheckStateRole});
+    return true;
+}
+
+Qt::ItemFlags KDReports::PageListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+}
+
+void KDReports::PageListModel::requestMissingThumbnails()
+{
+    if (m_missing.isEmpty())
+        return;
+    // The visible pages, then as many pages after them, in advance for scrolling down
+    QVector<int> pageNumbers = m_missing;
+    int pageNumber = *std::max_element(m_missing.constBegin(), m_missing.constEnd()) + 1;
+    for (int prefetched = 0; prefetched < m_missing.size() && pageNumber < m_pageCount; ++pageNumber) {
+        if (!m_thumbnails.contains(pageNumber)) {
+            pageNumbers.append(pageNumber);
+            ++prefetched;
+        }
+    }
+    m_missing.clear();
+    Q_EMIT thumbnailsNeeded(pageNumbers);
+}
@@ -0,0 +1,85 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSPAGELISTMODEL_P_H
+#define KDREPORTSPAGELISTMODEL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QAbstractListModel>
+#include <QBitArray>
+#include <QCache>
+#include <QPixmap>
+#include <QTimer>
+#include <QVector>
+
+namespace KDReports {
+
+/**
+ * @internal
+ * The list of pages shown next to the preview: one row per page, with the page number,
+ * the thumbnail, and a check box to select the pages to print.
+ *
+ * Nothing is allocated per page apart from one bit for the check state: the thumbnails
+ * are kept in a cache of limited size, and the ones which are missing when the view asks
+ * for them (i.e. the visible ones) are requested with thumbnailsNeeded().
+ * The view should use uniform item sizes, so that it doesn't ask for all the thumbnails to lay them out.
+ */
+class PageListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit PageListModel(QObject *parent = nullptr);
+
+    /// New pages are checked
+    void setPageCount(int pageCount);
+    /// \p size is the size of the square thumbnails, in device independent pixels
+    void setThumbnailSize(int size, qreal devicePixelRatio);
+    void setThumbnail(int pageNumber, const QImage &image);
+    /// Drops all thumbnails, e.g. because the layout changed. The visible ones will be requested again.
+    void clearThumbnails();
+
+    bool isChecked(int pageNumber) const;
+    int checkedCount() const;
+    /// Checks the pages from \p fromPage to \p toPage (included), and unchecks all other pages
+    void setCheckedRange(int fromPage, int toPage);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+Q_SIGNALS:
+    /// The thumbnails of \p pageNumbers should be rendered and set with setThumbnail(), in this order
+    void thumbnailsNeeded(const QVector<int> &pageNumbers);
+
+private:
+    void requestMissingThumbnails();
+
+    int m_pageCount = 0;
+    QBitArray m_checked;
+    mutable QCache<int, QPixmap> m_thumbnails; // cost in KB
+    QPixmap m_placeholder;
+    mutable QVector<int> m_missing; // asked for by the view since the last request
+    mutable QTimer m_requestTimer; // to request the thumbnails once per repaint of the view
+};
+
+}
+
+#endif /* KDREPORTSPAGELISTMODEL_P_H */
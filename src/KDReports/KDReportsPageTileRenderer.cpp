@@ -0,0 +1,386 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsPageTileRenderer_p.h"
+#include "KDReportsReport.h"
+#include "KDReportsReport_p.h"
+
+#include <QPainter>
+#include <QRunnable>
+#include <QSet>
+#include <qmath.h> // qCeil
+
+#include <algorithm>
+
+// In device pixels
+static const int s_tileSize = 256;
+// About 250 tiles of 256x256 pixels, i.e. a few screens full (at a device pixel ratio of 1)
+static const int s_tileCacheSizeKB = 64 * 1024;
+// Enough to rasterize the tiles of a screen without allocating
+static const int s_imagePoolSize = 32;
+// The zoom levels (per thousand) of the whole page images, and their largest size in device pixels
+static const int s_mipmapLevels[] = {250, 500, 1000, 2000};
+static const int s_maxMipmapSize = 2560;
+// A few pages at 100% and 200% (at a device pixel ratio of 1)
+static const int s_mipmapCacheSizeKB = 48 * 1024;
+
+namespace {
+// Rasterizes a tile of a page recorded into a QPicture.
+// Runs in a thread pool: it doesn't touch the report.
+class TileRasterizer : public QRunnable
+{
+public:
+    TileRasterizer(KDReports::PageTileRenderer *renderer, int generation, int pageNumber, int zoomKey, int column, int row, const QRect &tileRect,
+                   const QPicture &picture, QSizeF paperSize, qreal scale, qreal devicePixelRatio, QImage image)
+        : m_renderer(renderer)
+        , m_generation(generation)
+        , m_pageNumber(pageNumber)
+        , m_zoomKey(zoomKey)
+        , m_column(column)
+        , m_row(row)
+        , m_tileRect(tileRect)
+        , m_paperSize(paperSize)
+        , m_scale(scale)
+        , m_devicePixelRatio(devicePixelRatio)
+        , m_image(std::move(image))
+    {
+        // A deep copy: the tiles of a page are rasterized in parallel, the report keeps the picture
+        // in its page cache, and playing a QPicture isn't reentrant
+        m_picture.setData(picture.data(), picture.size());
+    }
+
+    void run() override
+    {
+        // Opaque, so that painting the tile is a mere copy
+        QImage img = m_image.size() == m_tileRect.size() ? std::move(m_image) : QImage(m_tileRect.size(), QImage::Format_RGB32);
+        img.setDevicePixelRatio(1); // painted in device pixels
+        img.fill(Qt::white);
+        QPainter painter(&img);
+        painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform, true);
+        painter.translate(-m_tileRect.topLeft());
+        painter.scale(m_scale, m_scale);
+        const QRectF pageRect(QPointF(0, 0), m_paperSize);
+        painter.drawPicture(0, 0, m_picture);
+        painter.setPen(QPen(1));
+        painter.drawRect(pageRect);
+        painter.end();
+        img.setDevicePixelRatio(m_devicePixelRatio);
+
+        // Queued, so it's called in the GUI thread. The renderer waits for the rasterizers before being deleted.
+        QMetaObject::invokeMethod(m_renderer, "rasterized", Qt::QueuedConnection, Q_ARG(int, m_generation), Q_ARG(int, m_pageNumber), Q_ARG(int, m_zoomKey),
+                                  Q_ARG(int, m_column), Q_ARG(int, m_row), Q_ARG(QImage, img));
+    }
+
+private:
+    KDReports::PageTileRenderer *m_renderer;
+    const int m_generation;
+    const int m_pageNumber;
+    const int m_zoomKey;
+    const int m_column;
+    const int m_row;
+    const QRect m_tileRect;
+    QPicture m_picture;
+    const QSizeF m_paperSize;
+    const qreal m_scale;
+    const qreal m_devicePixelRatio;
+    QImage m_image; // from the image pool, or null
+};
+}
+
+KDReports::PageTileRenderer::Tile::~Tile()
+{
+    if (image.width() == s_tileSize && image.height() == s_tileSize && pool->size() < s_imagePoolSize)
+        pool->append(image);
+}
+
+KDReports::PageTileRenderer::PageTileRenderer(QObject *parent)
+    : QObject(parent)
+    , m_tiles(s_tileCacheSizeKB)
+    , m_mipmaps(s_mipmapCacheSizeKB)
+{
+    m_renderTimer.setSingleShot(true);
+    connect(&m_renderTimer, &QTimer::timeout, this, [this]() { renderNextTiles(); });
+}
+
+KDReports::PageTileRenderer::~PageTileRenderer()
+{
+    // The rasterizers refer to this object
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void KDReports::PageTileRenderer::setReport(Report *report)
+{
+    m_report = report;
+    invalidate();
+}
+
+void KDReports::PageTileRenderer::setDevicePixelRatio(qreal devicePixelRatio)
+{
+    if (devicePixelRatio == m_devicePixelRatio)
+        return;
+    invalidate();
+    m_devicePixelRatio = devicePixelRatio;
+    m_tiles.setMaxCost(qRound(s_tileCacheSizeKB * devicePixelRatio * devicePixelRatio)); // as many tiles on screen
+    m_mipmaps.setMaxCost(qRound(s_mipmapCacheSizeKB * devicePixelRatio * devicePixelRatio));
+}
+
+int KDReports::PageTileRenderer::zoomKey(qreal zoom)
+{
+    return qRound(zoom * 1000);
+}
+
+QSize KDReports::PageTileRenderer::pageSize(qreal zoom) const
+{
+    const qreal scale = zoomKey(zoom) / 1000.0;
+    return QSize(qCeil(m_paperSize.width() * scale), qCeil(m_paperSize.height() * scale));
+}
+
+QSize KDReports::PageTileRenderer::devicePageSize(int zoomKey) const
+{
+    const QSize size = pageSize(zoomKey / 1000.0);
+    return QSize(qCeil(size.width() * m_devicePixelRatio), qCeil(size.height() * m_devicePixelRatio));
+}
+
+QRect KDReports::PageTileRenderer::tileRect(const TileKey &key) const
+{
+    if (key.column < 0) // a mipmap
+        return QRect(QPoint(0, 0), devicePageSize(key.zoomKey));
+    const QRect rect(key.column * s_tileSize, key.row * s_tileSize, s_tileSize, s_tileSize);
+    return rect.intersected(QRect(QPoint(0, 0), devicePageSize(key.zoomKey)));
+}
+
+QVector<KDReports::PageTileRenderer::TileKey> KDReports::PageTileRenderer::tilesIn(int pageNumber, int zoomKey, const QRect &deviceRect) const
+{
+    QVector<TileKey> tiles;
+    const QRect rect = deviceRect.intersected(QRect(QPoint(0, 0), devicePageSize(zoomKey)));
+    if (rect.isEmpty())
+        return tiles;
+    for (int row = rect.top() / s_tileSize; row <= rect.bottom() / s_tileSize; ++row) {
+        for (int column = rect.left() / s_tileSize; column <= rect.right() / s_tileSize; ++column)
+            tiles.append(TileKey {pageNumber, zoomKey, column, row});
+    }
+    return tiles;
+}
+
+void KDReports::PageTileRenderer::paintPage(QPainter &painter, int pageNumber, qreal zoom, const QRect &rect)
+{
+    if (!m_report)
+        return;
+    const qreal dpr = m_devicePixelRatio;
+    const QRect deviceRect = QRectF(rect.x() * dpr, rect.y() * dpr, rect.width() * dpr, rect.height() * dpr).toAlignedRect();
+    const QVector<TileKey> tiles = tilesIn(pageNumber, zoomKey(zoom), deviceRect);
+    for (const TileKey &tile : tiles) {
+        if (const Tile *cached = m_tiles.object(tile)) {
+            const QRect r = tileRect(tile);
+            painter.drawImage(QPointF(r.x() / dpr, r.y() / dpr), cached->image);
+        } else {
+            paintFallback(painter, tile);
+        }
+    }
+}
+
+void KDReports::PageTileRenderer::requestTiles(int pageNumber, qreal zoom, const QRect &rect, int priority)
+{
+    if (!m_report || m_frozen)
+        return;
+    const qreal dpr = m_devicePixelRatio;
+    const QRect deviceRect = QRectF(rect.x() * dpr, rect.y() * dpr, rect.width() * dpr, rect.height() * dpr).toAlignedRect();
+    if (m_mipmaps.contains(TileKey {pageNumber, zoomKey(zoom), -1, -1}))
+        return; // painted from the whole page image at this zoom level
+    const QVector<TileKey> tiles = tilesIn(pageNumber, zoomKey(zoom), deviceRect);
+    for (const TileKey &tile : tiles) {
+        if (!m_tiles.contains(tile) && !m_inFlight.contains(tile))
+            m_requests.append(TileRequest {tile, priority});
+    }
+}
+
+void KDReports::PageTileRenderer::requestMipmaps(int pageNumber, qreal zoom, int priority)
+{
+    if (!m_report || m_frozen)
+        return;
+    QVector<int> levels; // those which aren't too large
+    for (int level : s_mipmapLevels) {
+        const QSize size = devicePageSize(level);
+        if (qMax(size.width(), size.height()) <= s_maxMipmapSize)
+            levels.append(level);
+    }
+    if (levels.isEmpty())
+        return;
+    // The two levels from the zoom on: zooming out, or in up to the next level, downscales one of them.
+    // Beyond the largest level, the largest one.
+    auto it = std::lower_bound(levels.constBegin(), levels.constEnd(), zoomKey(zoom));
+    if (it == levels.constEnd())
+        --it;
+    for (int i = 0; i < 2 && it != levels.constEnd(); ++i, ++it) {
+        const TileKey mipmap {pageNumber, *it, -1, -1};
+        if (!m_mipmaps.contains(mipmap) && !m_inFlight.contains(mipmap))
+            m_requests.append(TileRequest {mipmap, priority + i});
+    }
+}
+
+void KDReports::PageTileRenderer::commitRequests()
+{
+    // In the order of the requests for the same priority, which keeps the tiles of a page together
+    std::stable_sort(m_requests.begin(), m_requests.end(), [](const TileRequest &a, const TileRequest &b) { return a.priority < b.priority; });
+    m_queue.clear();
+    QSet<TileKey> queued;
+    for (const TileRequest &request : std::as_const(m_requests)) {
+        if (!queued.contains(request.key)) {
+            queued.insert(request.key);
+            m_queue.append(request.key);
+        }
+    }
+    m_requests.clear();
+    if (!m_queue.isEmpty())
+        m_renderTimer.start(0);
+}
+
+void KDReports::PageTileRenderer::paintFallback(QPainter &painter, const TileKey &key)
+{
+    const qreal dpr = m_devicePixelRatio;
+    const QRect target = tileRect(key);
+    const QRectF logicalTarget(target.x() / dpr, target.y() / dpr, target.width() / dpr, target.height() / dpr);
+
+    // Best: a whole page image at this zoom level or above it, downscaled.
+    // Then the tiles of another zoom level, then a whole page image below this zoom level, upscaled.
+    const QImage *larger = nullptr;
+    const QImage *smaller = nullptr;
+    qreal largerScale = 0;
+    qreal smallerScale = 0;
+    for (int level : s_mipmapLevels) {
+        const QImage *image = m_mipmaps.object(TileKey {key.pageNumber, level, -1, -1});
+        if (!image)
+            continue;
+        if (level >= key.zoomKey && !larger) {
+            larger = image;
+            largerScale = qreal(key.zoomKey) / level;
+        } else if (level < key.zoomKey) {
+            smaller = image;
+            smallerScale = qreal(key.zoomKey) / level;
+        }
+    }
+    if (larger) {
+        paintMipmap(painter, target, *larger, largerScale);
+        return;
+    }
+
+    painter.fillRect(logicalTarget, QBrush(Qt::white));
+
+    // Prefer the highest zoom level below this one: it's the sharpest one needing few tiles.
+    // Otherwise the lowest one above it.
+    int fallbackZoomKey = 0;
+    for (int level : m_zoomKeys.value(key.pageNumber)) {
+        if (level == key.zoomKey)
+            continue;
+        const bool bestIsLower = fallbackZoomKey > 0 && fallbackZoomKey < key.zoomKey;
+        if (fallbackZoomKey == 0 || (level < key.zoomKey && (!bestIsLower || level > fallbackZoomKey)) || (level > key.zoomKey && !bestIsLower && level < fallbackZoomKey))
+            fallbackZoomKey = level;
+    }
+    if (fallbackZoomKey == 0) {
+        if (smaller)
+            paintMipmap(painter, target, *smaller, smallerScale);
+        return;
+    }
+
+    const qreal scale = qreal(key.zoomKey) / fallbackZoomKey; // from the fallback level to this one
+    const QRect source = QRectF(target.x() / scale, target.y() / scale, target.width() / scale, target.height() / scale).toAlignedRect();
+    painter.save();
+    painter.setClipRect(logicalTarget, Qt::IntersectClip);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    for (const TileKey &tile : tilesIn(key.pageNumber, fallbackZoomKey, source)) {
+        if (const Tile *cached = m_tiles.object(tile)) {
+            const QRect r = tileRect(tile);
+            const QRectF scaled(r.x() * scale / dpr, r.y() * scale / dpr, r.width() * scale / dpr, r.height() * scale / dpr);
+            painter.drawImage(scaled, cached->image, QRectF(cached->image.rect()));
+        }
+    }
+    painter.restore();
+}
+
+void KDReports::PageTileRenderer::paintMipmap(QPainter &painter, const QRect &target, const QImage &mipmap, qreal scale)
+{
+    // scale goes from the mipmap to the zoom level of target, both in device pixels
+    const qreal dpr = m_devicePixelRatio;
+    const QRectF logicalTarget(target.x() / dpr, target.y() / dpr, target.width() / dpr, target.height() / dpr);
+    const QRectF source(target.x() / scale, target.y() / scale, target.width() / scale, target.height() / scale);
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter.drawImage(logicalTarget, mipmap, source);
+    painter.restore();
+}
+
+void KDReports::PageTileRenderer::invalidate()
+{
+    ++m_generation;
+    if (m_report && !m_frozen)
+        m_paperSize = m_report->paperSize();
+    m_tiles.clear();
+    m_mipmaps.clear();
+    m_zoomKeys.clear();
+    m_pictureNumber = -1;
+    m_picture = QPicture();
+    m_requests.clear();
+    m_queue.clear();
+    m_inFlight.clear();
+    m_renderTimer.stop();
+    m_pool.clear(); // the rasterizers which didn't start yet
+}
+
+void KDReports::PageTileRenderer::setFrozen(bool frozen)
+{
+    m_frozen = frozen;
+}
+
+void KDReports::PageTileRenderer::renderNextTiles()
+{
+    if (!m_report || m_frozen)
+        return;
+    bool fetched = false;
+    while (!m_queue.isEmpty() && m_inFlight.size() < m_pool.maxThreadCount()) {
+        const TileKey key = m_queue.first();
+        if (key.pageNumber != m_pictureNumber) {
+            // Painting a page reads the report, unless it's in its page cache:
+            // only one per event loop iteration, to keep the GUI responsive
+            if (fetched)
+                break;
+            m_picture = m_report->d->pagePicture(key.pageNumber);
+            m_pictureNumber = key.pageNumber;
+            fetched = true;
+        }
+        m_queue.removeFirst();
+        m_inFlight.append(key);
+        // Moved, so that the rasterizer doesn't share it with anything
+        m_pool.start(new TileRasterizer(this, m_generation, key.pageNumber, key.zoomKey, key.column, key.row, tileRect(key), m_picture, m_paperSize,
+                                        key.zoomKey / 1000.0 * m_devicePixelRatio, m_devicePixelRatio, m_imagePool.isEmpty() ? QImage() : m_imagePool.takeLast()));
+    }
+    if (!m_queue.isEmpty() && m_inFlight.size() < m_pool.maxThreadCount())
+        m_renderTimer.start(0);
+}
+
+void KDReports::PageTileRenderer::rasterized(int generation, int pageNumber, int zoomKey, int column, int row, const QImage &image)
+{
+    if (generation != m_generation)
+        return; // invalidated in the meantime
+    const TileKey key {pageNumber, zoomKey, column, row};
+    m_inFlight.removeOne(key);
+    const int cost = qMax(1, image.bytesPerLine() * image.height() / 1024);
+    if (column < 0) {
+        m_mipmaps.insert(key, new QImage(image), cost);
+    } else {
+        m_tiles.insert(key, new Tile(&m_imagePool, image), cost);
+        QVector<int> &zoomKeys = m_zoomKeys[pageNumber];
+        if (!zoomKeys.contains(zoomKey))
+            zoomKeys.append(zoomKey);
+    }
+    Q_EMIT tileReady(pageNumber);
+    if (!m_queue.isEmpty())
+        m_renderTimer.start(0);
+}
@@ -0,0 +1,155 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSPAGETILERENDERER_P_H
+#define KDREPORTSPAGETILERENDERER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPicture>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QPainter;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+class Report;
+
+/**
+ * @internal
+ * Renders the pages shown in the main preview, in tiles, without blocking the GUI thread.
+ *
+ * Only the requested tiles are rendered, and they are cached per page and zoom level.
+ * A missing tile is replaced meanwhile by a scaled image of the same page at another zoom level,
+ * so that zooming shows the page immediately rather than a white one: preferably a whole page image
+ * from a small pyramid of zoom levels (25%, 50%, 100%, 200%) kept for the recently viewed pages,
+ * downscaled, otherwise the cached tiles of another zoom level.
+ * The requests have priorities, e.g. the visible tiles first, then those of the pages around them.
+ *
+ * Like in ThumbnailRenderer, the pages are recorded into a QPicture in the GUI thread (or
+ * taken from the page cache of the report), and the tiles are rasterized from it in a thread pool.
+ */
+class PageTileRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PageTileRenderer(QObject *parent = nullptr);
+    ~PageTileRenderer() override;
+
+    void setReport(Report *report);
+    void setDevicePixelRatio(qreal devicePixelRatio);
+
+    /// Returns the size of page \p pageNumber at \p zoom, in device independent pixels
+    QSize pageSize(qreal zoom) const;
+
+    /// Paints the area \p rect of page \p pageNumber at \p zoom, with (0, 0) being the top left corner of the page
+    void paintPage(QPainter &painter, int pageNumber, qreal zoom, const QRect &rect);
+
+    /// Requests the missing tiles in the area \p rect of the page; the lower \p priority, the sooner they are rendered
+    void requestTiles(int pageNumber, qreal zoom, const QRect &rect, int priority);
+    /// Requests the whole page images of the zoom levels around \p zoom, to zoom from them instantly later
+    void requestMipmaps(int pageNumber, qreal zoom, int priority);
+    /// Renders the tiles requested since the last call, instead of the previous ones: tileReady() is emitted for each of them
+    void commitRequests();
+
+    /// Drops all tiles and recorded pages, e.g. because the layout changed
+    void invalidate();
+    /// While frozen, the report isn't used at all (e.g. while it's being layouted in another thread):
+    /// the pages are painted with the tiles which are already there, and no tiles are requested.
+    void setFrozen(bool frozen);
+
+Q_SIGNALS:
+    void tileReady(int pageNumber);
+
+private:
+    struct TileKey
+    {
+        int pageNumber;
+        int zoomKey; // per thousand
+        int column; // -1 for the whole page, in m_mipmaps
+        int row;
+        bool operator==(const TileKey &other) const
+        {
+            return pageNumber == other.pageNumber && zoomKey == other.zoomKey && column == other.column && row == other.row;
+        }
+        friend uint qHash(const TileKey &key, uint seed)
+        {
+            return qHash(key.pageNumber, seed) ^ qHash(key.zoomKey << 16 ^ key.column << 8 ^ key.row, seed);
+        }
+    };
+
+    // A tile in m_tiles. Its image goes back to m_imagePool when it's evicted, to rasterize another tile into it.
+    struct Tile
+    {
+        Tile(QVector<QImage> *pool, const QImage &image)
+            : pool(pool)
+            , image(image)
+        {
+        }
+        ~Tile();
+        Tile(const Tile &) = delete;
+        Tile &operator=(const Tile &) = delete;
+        QVector<QImage> *pool;
+        QImage image;
+    };
+
+    struct TileRequest
+    {
+        TileKey key;
+        int priority;
+    };
+
+    static int zoomKey(qreal zoom);
+    QSize devicePageSize(int zoomKey) const;
+    QRect tileRect(const TileKey &key) const; // in device pixels
+    QVector<TileKey> tilesIn(int pageNumber, int zoomKey, const QRect &deviceRect) const;
+    void paintFallback(QPainter &painter, const TileKey &key);
+    void paintMipmap(QPainter &painter, const QRect &target, const QImage &mipmap, qreal scale);
+    void renderNextTiles();
+    Q_INVOKABLE void rasterized(int generation, int pageNumber, int zoomKey, int column, int row, const QImage &image);
+
+    Report *m_report = nullptr;
+    qreal m_devicePixelRatio = 1.0;
+    QSizeF m_paperSize; // as of the last invalidate()
+    bool m_frozen = false;
+    QVector<QImage> m_imagePool; // before m_tiles, which returns its images here when destroyed
+    QCache<TileKey, Tile> m_tiles; // cost in KB
+    QCache<TileKey, QImage> m_mipmaps; // the whole page images, cost in KB
+    QHash<int, QVector<int>> m_zoomKeys; // the zoom levels with cached tiles, per page
+    int m_pictureNumber = -1; // the page recorded in m_picture
+    QPicture m_picture;
+    QVector<TileRequest> m_requests; // since the last commitRequests()
+    QVector<TileKey> m_queue;
+    QVector<TileKey> m_inFlight; // being rasterized
+    int m_generation = 0; // to drop the results of the requests made before invalidate()
+    QTimer m_renderTimer;
+    QThreadPool m_pool;
+};
+
+}
+
+#endif /* KDREPORTSPAGETILERENDERER_P_H */
@@ -0,0 +1,282 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsPdfMerger_p.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QIODevice>
+#include <QMap>
+#include <QRegularExpression>
+
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+struct PdfDocument
+{
+    QByteArray header; // "%PDF-1.x" and the binary comment
+    QVector<int> objectNumbers; // all objects in use, according to the xref table
+    QMap<int, QByteArray> objects; // "N 0 obj ... endobj", by object number
+    QByteArray trailer;
+    int catalog = 0;
+    int info = 0;
+    int pageTree = 0;
+    QVector<int> pages;
+};
+
+bool isWhiteSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+bool isRegular(char c)
+{
+    return !isWhiteSpace(c) && !strchr("()<>[]{}/%", c);
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Returns the object number of the indirect reference following \p key, e.g. 3 for "/Root 3 0 R"
+int referenceAfter(const QByteArray &text, const QString &key)
+{
+    const QRegularExpression rx(QRegularExpression::escape(key) + QStringLiteral("\\s+(\\d+)\\s+\\d+\\s+R"));
+    const QRegularExpressionMatch match = rx.match(QString::fromLatin1(text));
+    return match.hasMatch() ? match.captured(1).toInt() : 0;
+}
+
+bool parseDocument(const QByteArray &data, PdfDocument *doc)
+{
+    const int startXRef = data.lastIndexOf("startxref");
+    if (startXRef < 0)
+        return false;
+    const QByteArray tail = data.mid(startXRef + 9);
+    bool ok = false;
+    const int xrefOffset = tail.left(tail.indexOf("%%EOF")).trimmed().toInt(&ok);
+    if (!ok || xrefOffset <= 0 || data.mid(xrefOffset, 4) != "xref")
+        return false;
+    const int trailerOffset = data.indexOf("trailer", xrefOffset);
+    if (trailerOffset < 0)
+        return false;
+    doc->trailer = data.mid(trailerOffset, startXRef - trailerOffset);
+
+    // Subsections of "first count" followed by count entries of "offset generation n|f"
+    const QList<QByteArray> tokens = data.mid(xrefOffset + 4, trailerOffset - xrefOffset - 4).simplified().split(' ');
+    QMap<int, int> objectsByOffset;
+    int i = 0;
+    while (i + 1 < tokens.size()) {
+        const int first = tokens.at(i).toInt();
+        const int count = tokens.at(i + 1).toInt();
+        i += 2;
+        for (int entry = 0; entry < count && i + 2 < tokens.size(); ++entry, i += 3) {
+            if (tokens.at(i + 2) != "n")
+                continue;
+            const int number = first + entry;
+            doc->objectNumbers.append(number);
+            const int offset = tokens.at(i).toInt();
+            if (offset > 0 && offset < xrefOffset)
+                objectsByOffset.insert(offset, number);
+        }
+    }
+    if (objectsByOffset.isEmpty())
+        return false;
+
+    // Each object extends until the next one, the last one until the xref table
+    doc->header = data.left(objectsByOffset.firstKey());
+    for (auto it = objectsByOffset.constBegin(); it != objectsByOffset.constEnd(); ++it) {
+        const auto next = std::next(it);
+        const int end = next == objectsByOffset.constEnd() ? xrefOffset : next.key();
+        doc->objects.insert(it.value(), data.mid(it.key(), end - it.key()));
+    }
+
+    doc->catalog = referenceAfter(doc->trailer, QStringLiteral("/Root"));
+    doc->info = referenceAfter(doc->trailer, QStringLiteral("/Info"));
+    doc->pageTree = referenceAfter(doc->objects.value(doc->catalog), QStringLiteral("/Pages"));
+    const QString pageTree = QString::fromLatin1(doc->objects.value(doc->pageTree));
+    const QRegularExpressionMatch kids = QRegularExpression(QStringLiteral("/Kids\\s*\\[([^\\]]*)\\]")).match(pageTree);
+    if (!kids.hasMatch())
+        return false;
+    QRegularExpressionMatchIterator refs = QRegularExpression(QStringLiteral("(\\d+)\\s+\\d+\\s+R")).globalMatch(kids.captured(1));
+    while (refs.hasNext()) {
+        doc->pages.append(refs.next().captured(1).toInt());
+    }
+    return !doc->pages.isEmpty();
+}
+
+// Renumbers the object itself ("N G obj") and the indirect references ("N G R") in its dictionary.
+// Stream data is copied unchanged, as are literal strings.
+// Sets \p ok to false if it references an object which isn't in the merged document.
+QByteArray renumberObject(const QByteArray &object, int newNumber, const QHash<int, int> &numbers, bool *ok)
+{
+    const int size = object.size();
+    int pos = 0;
+    while (pos < size && isDigit(object.at(pos)))
+        ++pos;
+    if (pos == 0)
+        return object;
+    QByteArray result = QByteArray::number(newNumber);
+    int copyFrom = pos;
+    while (pos < size) {
+        const char c = object.at(pos);
+        if (c == '(') {
+            // Literal string, with balanced or escaped parentheses
+            int depth = 0;
+            for (; pos < size; ++pos) {
+                const char s = object.at(pos);
+                if (s == '\\')
+                    ++pos;
+                else if (s == '(')
+                    ++depth;
+                else if (s == ')' && --depth == 0)
+                    break;
+            }
+            ++pos;
+            continue;
+        }
+        if (c == 's' && !isRegular(object.at(pos - 1)) && object.mid(pos, 6) == "stream" && pos + 6 < size
+            && (object.at(pos + 6) == '\n' || object.at(pos + 6) == '\r')) {
+            break; // binary data follows
+        }
+        if (isDigit(c) && !isRegular(object.at(pos - 1))) {
+            int end = pos;
+            while (end < size && isDigit(object.at(end)))
+                ++end;
+            int p = end;
+            while (p < size && isWhiteSpace(object.at(p)))
+                ++p;
+            const int generationStart = p;
+            while (p < size && isDigit(object.at(p)))
+                ++p;
+            const bool hasGeneration = p > generationStart && p < size && isWhiteSpace(object.at(p));
+            while (p < size && isWhiteSpace(object.at(p)))
+                ++p;
+            if (hasGeneration && p < size && object.at(p) == 'R' && (p + 1 == size || !isRegular(object.at(p + 1)))) {
+                const int number = object.mid(pos, end - pos).toInt();
+                const auto newReference = numbers.constFind(number);
+                if (newReference == numbers.constEnd()) {
+                    qWarning() << "mergePdfDocuments: reference to object" << number << "which isn't in the merged document";
+                    *ok = false;
+                    return QByteArray();
+                }
+                result += object.mid(copyFrom, pos - copyFrom);
+                result += QByteArray::number(newReference.value());
+                result += " 0 R";
+                pos = p + 1;
+                copyFrom = pos;
+            } else {
+                pos = end;
+            }
+            continue;
+        }
+        ++pos;
+    }
+    result += object.mid(copyFrom);
+    return result;
+}
+
+QByteArray replacePageList(const QByteArray &pageTree, const QByteArray &kids, int count)
+{
+    QString str = QString::fromLatin1(pageTree);
+    str.replace(QRegularExpression(QStringLiteral("/Kids\\s*\\[[^\\]]*\\]")), QStringLiteral("/Kids\n[\n") + QString::fromLatin1(kids) + QStringLiteral("]"));
+    str.replace(QRegularExpression(QStringLiteral("/Count\\s+\\d+")), QStringLiteral("/Count ") + QString::number(count));
+    return str.toLatin1();
+}
+
+}
+
+bool KDReports::mergePdfDocuments(const QVector<QByteArray> &documents, QIODevice *device)
+{
+    QVector<PdfDocument> docs(documents.size());
+    for (int i = 0; i < documents.size(); ++i) {
+        if (!parseDocument(documents.at(i), &docs[i])) {
+            qWarning() << "mergePdfDocuments: unsupported PDF structure in document" << i;
+            return false;
+        }
+    }
+    if (docs.isEmpty())
+        return false;
+
+    // The catalog, info and page tree of the first document are used for the merged document,
+    // the ones of the other documents are dropped, and their pages point to the first page tree.
+    auto isDropped = [&docs](int docIndex, int number) {
+        const PdfDocument &doc = docs.at(docIndex);
+        return docIndex > 0 && (number == doc.catalog || number == doc.info || number == doc.pageTree);
+    };
+    QVector<QHash<int, int>> numbers(docs.size());
+    int nextNumber = 1;
+    for (int i = 0; i < docs.size(); ++i) {
+        for (int number : std::as_const(docs.at(i).objectNumbers)) {
+            if (!isDropped(i, number))
+                numbers[i].insert(number, nextNumber++);
+        }
+        if (i > 0)
+            numbers[i].insert(docs.at(i).pageTree, numbers.at(0).value(docs.at(0).pageTree));
+    }
+
+    QByteArray kids;
+    int pageCount = 0;
+    for (int i = 0; i < docs.size(); ++i) {
+        for (int page : std::as_const(docs.at(i).pages)) {
+            kids += QByteArray::number(numbers.at(i).value(page)) + " 0 R\n";
+            ++pageCount;
+        }
+    }
+
+    qint64 pos = 0;
+    bool ok = true;
+    auto write = [&](const QByteArray &bytes) {
+        ok = ok && device->write(bytes) == bytes.size();
+        pos += bytes.size();
+    };
+
+    QVector<qint64> offsets(nextNumber, -1); // -1 for free objects
+    write(docs.at(0).header);
+    for (int i = 0; i < docs.size(); ++i) {
+        const PdfDocument &doc = docs.at(i);
+        for (auto it = doc.objects.constBegin(); it != doc.objects.constEnd(); ++it) {
+            if (isDropped(i, it.key()))
+                continue;
+            const int newNumber = numbers.at(i).value(it.key());
+            bool renumbered = true;
+            QByteArray object = renumberObject(it.value(), newNumber, numbers.at(i), &renumbered);
+            if (!renumbered)
+                return false; // e.g. to the catalog of another document, which was dropped
+            if (i == 0 && it.key() == doc.pageTree)
+                object = replacePageList(object, kids, pageCount);
+            offsets[newNumber] = pos;
+            write(object);
+        }
+    }
+
+    const qint64 xrefOffset = pos;
+    write("xref\n0 " + QByteArray::number(nextNumber) + "\n0000000000 65535 f \n");
+    for (int number = 1; number < nextNumber; ++number) {
+        if (offsets.at(number) < 0)
+            write("0000000000 00000 f \n");
+        else
+            write(QByteArray::number(offsets.at(number)).rightJustified(10, '0') + " 00000 n \n");
+    }
+
+    const PdfDocument &first = docs.at(0);
+    QByteArray trailer = "trailer\n<<\n/Size " + QByteArray::number(nextNumber) + '\n';
+    if (first.info)
+        trailer += "/Info " + QByteArray::number(numbers.at(0).value(first.info)) + " 0 R\n";
+    trailer += "/Root " + QByteArray::number(numbers.at(0).value(first.catalog)) + " 0 R\n";
+    const QRegularExpressionMatch id = QRegularExpression(QStringLiteral("/ID\\s*\\[[^\\]]*\\]")).match(QString::fromLatin1(first.trailer));
+    if (id.hasMatch())
+        trailer += id.captured(0).toLatin1() + '\n';
+    trailer += ">>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n";
+    write(trailer);
+    return ok;
+}
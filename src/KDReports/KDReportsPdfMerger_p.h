@@ -0,0 +1,50 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSPDFMERGER_P_H
+#define KDREPORTSPDFMERGER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QByteArray>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Concatenates PDF documents generated by QPdfWriter into a single PDF document, written to \p device.
+ *
+ * The objects of each document are renumbered, the pages of all documents are moved
+ * into the page tree of the first document, and a new cross-reference table is written.
+ * Only the structure written by QPdfWriter is supported: a single cross-reference table
+ * (no cross-reference streams, no incremental updates) and a flat page tree.
+ * Fonts and images used by several documents end up once per document in the result.
+ * Returns false if an object references one which was dropped (e.g. the catalog of a document
+ * other than the first one), in which case \p device contains an incomplete document.
+ */
+bool mergePdfDocuments(const QVector<QByteArray> &documents, QIODevice *device);
+
+}
+
+#endif /* KDREPORTSPDFMERGER_P_H */
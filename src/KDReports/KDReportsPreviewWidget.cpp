@@ -10,16 +10,23 @@
 
 #include "KDReportsPreviewWidget.h"
 #include "KDReportsReport.h"
+#include "KDReportsReport_p.h"
+#include "KDReportsPageListModel_p.h"
+#include "KDReportsPageTileRenderer_p.h"
+#include "KDReportsTextSearcher_p.h"
+#include "KDReportsThumbnailRenderer_p.h"
 #include <QDebug>
+#include <QFutureWatcher>
 #include <QKeyEvent>
 #include <QPainter>
 #include <QPointer>
 #include <QPrintDialog>
 #include <QProgressDialog>
+#include <QScrollBar>
 #include <QShortcut>
-#include <QTime>
 #include <QTimer>
-#include <qmath.h> // qCeil
+
+#include <algorithm>
 
 #include "ui_previewdialogbase.h"
 
@@ -28,65 +35,199 @@ enum
     PreviewSize = 200
 };
 
+// Between the pages, when scrolling continuously
+static const int s_pageSpacing = 10;
+// After the visible tiles and those rendered in advance
+static const int s_mipmapPriority = 1000;
+
 /// @internal
-/// The widget showing the large preview on the right
+/// The widget showing the large preview on the right: the current page, or all pages one below
+/// the other when scrolling continuously. It's as large as its contents, in the scroll area.
 class PagePreviewWidget : public QWidget
 {
     Q_OBJECT
 public:
-    PagePreviewWidget(QWidget *parent = nullptr)
+    PagePreviewWidget(KDReports::PageTileRenderer *renderer, QWidget *parent = nullptr)
         : QWidget(parent)
+        , m_renderer(renderer)
     {
         // For link hovered functionality
         setMouseTracking(true);
     }
-    void setPixmap(const QPixmap &pixmap)
+    void setPage(int pageNumber, qreal zoom)
+    {
+        m_pageNumber = pageNumber;
+        m_zoom = zoom;
+        m_pageSize = m_renderer->pageSize(zoom);
+        update();
+    }
+    void setPageCount(int pageCount)
     {
-        m_pixmap = pixmap;
+        m_pageCount = pageCount;
         update();
     }
-    int pixmapWidth() const
+    void setContinuous(bool continuous)
     {
-        return m_pixmap.width();
+        m_continuous = continuous;
+        update();
     }
-    int pixmapHeight() const
+    /// Continuous scrolling was requested, and is possible
+    bool isContinuous() const
     {
-        return m_pixmap.height();
+        return m_continuous && fitsContinuously();
     }
-    QSize pixmapSize() const
+    /// Whether all the pages fit one below the other, in a widget no higher than QWIDGETSIZE_MAX
+    /// (not with tens of thousands of pages, or thousands at a high zoom level)
+    bool fitsContinuously() const
     {
-        return m_pixmap.size();
+        return qint64(m_pageCount) * (m_pageSize.height() + s_pageSpacing) + s_pageSpacing <= QWIDGETSIZE_MAX;
+    }
+    int pageNumber() const
+    {
+        return m_pageNumber;
+    }
+    QSize pageSize() const
+    {
+        return m_pageSize;
+    }
+    /// The size needed to show the page, or all the pages
+    QSize contentsSize() const
+    {
+        if (!isContinuous())
+            return m_pageSize;
+        return QSize(m_pageSize.width() + 2 * s_pageSpacing, m_pageCount * (m_pageSize.height() + s_pageSpacing) + s_pageSpacing);
+    }
+    /// The position of the top left corner of the page in the widget
+    QPoint pagePosition(int pageNumber) const
+    {
+        const int x = (width() - m_pageSize.width()) / 2;
+        if (!isContinuous())
+            return QPoint(x, (height() - m_pageSize.height()) / 2);
+        return QPoint(x, s_pageSpacing + pageNumber * (m_pageSize.height() + s_pageSpacing));
+    }
+    /// The page shown at \p y, or the nearest one
+    int pageAt(int y) const
+    {
+        if (!isContinuous())
+            return m_pageNumber;
+        const int page = (y - s_pageSpacing / 2) / qMax(1, m_pageSize.height() + s_pageSpacing);
+        return qBound(0, page, m_pageCount - 1);
     }
 
-Q_SIGNALS:
-    void mouseMoved(QPoint pos);
-    void mouseClicked(QPoint pos);
+    /// Repaints the page, if it's visible, e.g. when a tile is ready
+    void updatePage(int pageNumber)
+    {
+        if (!isContinuous() && pageNumber != m_pageNumber)
+            return;
+        const QRect rect = QRect(pagePosition(pageNumber), m_pageSize).intersected(visibleRegion().boundingRect());
+        if (!rect.isEmpty())
+            update(rect);
+    }
 
-protected:
-    QPoint pixmapOffset() const
+    /// A search hit, in page coordinates
+    struct Highlight
     {
-        return QPoint((width() - m_pixmap.width()) / 2, (height() - m_pixmap.height()) / 2);
+        int pageNumber;
+        QRect rect;
+        bool current; // the hit the user went to
+        bool operator==(const Highlight &other) const
+        {
+            return pageNumber == other.pageNumber && rect == other.rect && current == other.current;
+        }
+    };
+    void setHighlights(const QVector<Highlight> &highlights)
+    {
+        if (highlights == m_highlights)
+            return;
+        m_highlights = highlights;
+        update();
     }
 
-    void paintEvent(QPaintEvent *) override
+Q_SIGNALS:
+    void mouseMoved(int pageNumber, QPoint pos);
+    void mouseClicked(int pageNumber, QPoint pos);
+
+protected:
+    void paintEvent(QPaintEvent *event) override
     {
+        if (m_pageNumber < 0)
+            return;
         QPainter painter(this);
         // painter.fillRect( event->rect(), QColor(224,224,224) );
-        painter.drawPixmap(pixmapOffset(), m_pixmap);
+        const QRect exposed = event->rect();
+        for (int page = pageAt(exposed.top()); page <= pageAt(exposed.bottom()); ++page) {
+            const QPoint offset = pagePosition(page);
+            const QRect rect = exposed.translated(-offset).intersected(QRect(QPoint(0, 0), m_pageSize));
+            if (rect.isEmpty())
+                continue;
+            painter.save();
+            painter.translate(offset);
+            // Only the tiles in the exposed area (at most the visible part of the page) are painted
+            m_renderer->paintPage(painter, page, m_zoom, rect);
+            // Over the tiles, rather than in them: moving to another hit doesn't render the page again
+            painter.scale(m_zoom, m_zoom);
+            for (const Highlight &highlight : std::as_const(m_highlights)) {
+                if (highlight.pageNumber == page)
+                    painter.fillRect(highlight.rect, highlight.current ? QColor(255, 128, 0, 130) : QColor(255, 255, 0, 100));
+            }
+            painter.restore();
+        }
+        requestTiles();
     }
     /// \reimp
     void mouseMoveEvent(QMouseEvent *ev) override
     {
-        Q_EMIT mouseMoved(ev->pos() - pixmapOffset());
+        const int page = pageAt(ev->pos().y());
+        Q_EMIT mouseMoved(page, ev->pos() - pagePosition(page));
     }
     /// \reimp
     void mouseReleaseEvent(QMouseEvent *ev) override
     {
-        Q_EMIT mouseClicked(ev->pos() - pixmapOffset());
+        const int page = pageAt(ev->pos().y());
+        Q_EMIT mouseClicked(page, ev->pos() - pagePosition(page));
     }
 
 private:
-    QPixmap m_pixmap;
+    // Requests the tiles of the whole visible area, not only of the exposed one (e.g. a strip when scrolling),
+    // then those around it, in advance, and last the whole images of the visible pages for zooming
+    void requestTiles()
+    {
+        const QRect visible = visibleRegion().boundingRect();
+        if (visible.isEmpty())
+            return;
+        if (isContinuous()) {
+            // The pages up to one more screen above and below, the nearest first
+            const QRect prefetch = visible.adjusted(0, -visible.height(), 0, visible.height());
+            const int firstVisible = pageAt(visible.top());
+            const int lastVisible = pageAt(visible.bottom());
+            for (int page = pageAt(prefetch.top()); page <= pageAt(prefetch.bottom()); ++page) {
+                const QPoint offset = pagePosition(page);
+                const int distance = page < firstVisible ? firstVisible - page : qMax(0, page - lastVisible);
+                m_renderer->requestTiles(page, m_zoom, visible.translated(-offset), 0);
+                m_renderer->requestTiles(page, m_zoom, prefetch.translated(-offset), 1 + distance);
+                if (distance == 0)
+                    m_renderer->requestMipmaps(page, m_zoom, s_mipmapPriority);
+            }
+        } else {
+            // Then the same area of the adjacent pages
+            const QRect rect = visible.translated(-pagePosition(m_pageNumber));
+            m_renderer->requestTiles(m_pageNumber, m_zoom, rect, 0);
+            for (int adjacentPage : {m_pageNumber + 1, m_pageNumber - 1}) {
+                if (adjacentPage >= 0 && adjacentPage < m_pageCount)
+                    m_renderer->requestTiles(adjacentPage, m_zoom, rect, 1);
+            }
+            m_renderer->requestMipmaps(m_pageNumber, m_zoom, s_mipmapPriority);
+        }
+        m_renderer->commitRequests();
+    }
+
+    KDReports::PageTileRenderer *m_renderer;
+    int m_pageNumber = -1;
+    int m_pageCount = 0;
+    bool m_continuous = false;
+    qreal m_zoom = 1.0;
+    QSize m_pageSize;
+    QVector<Highlight> m_highlights;
 };
 
 class KDReports::PreviewWidgetPrivate : public Ui::PreviewWidgetBase
@@ -97,21 +238,36 @@ public:
     // not in ctor because the init calls q->slotFoo which uses d->, so d must be set first.
     void init();
 
-    void paintItem(QListWidgetItem *item, int index) const;
-    QPixmap paintPreview(int index) const;
+    int currentPage() const;
+    void setCurrentPage(int pageNumber);
+    void requestThumbnails(const QVector<int> &pageNumbers);
     void printSelectedPages();
     void setupComboBoxes();
     void pageCountChanged();
+    bool applyPageLayout();
+    bool relayout();
+    void relayoutFinished();
+    void waitForRelayout();
     void centerPreview();
     void zoomChanged();
     void fillZoomCombo();
     void updatePageButtons();
     void updatePreview();
     void pageNumberReturnPressed();
+    void startSearch();
+    void searchHitsFound(int first);
+    void searchFinished();
+    void goToHit(int hit);
+    void updateSearchResult();
+    void updateHighlights();
     void setReport(KDReports::Report *report);
 
-    void handleMouseMove(QPoint pos);
-    void handleMouseRelease(QPoint pos);
+    void handleMouseMove(int pageNumber, QPoint pos);
+    void handleMouseRelease(int pageNumber, QPoint pos);
+    void setContinuous(bool continuous);
+    void scrollToPage(int pageNumber);
+    void previewScrolled();
+    void visiblePages(int *first, int *last) const;
     void slotCurrentPageChanged();
     void slotFirstPage();
     void slotPrevPage();
@@ -122,31 +278,58 @@ public:
     void slotZoomIn();
     void slotZoomOut();
     void slotZoomChanged();
-    void previewNextItems();
+    void slotFindNext();
+    void slotFindPrevious();
 
+    KDReports::PageTileRenderer *m_tileRenderer;
     PagePreviewWidget *m_previewWidget;
     QPrinter m_printer;
     qreal m_zoomFactor = 1.0;
     qreal m_endlessPrinterWidth = 114.0;
     KDReports::Report *m_report = nullptr;
-    QTimer m_previewTimer;
+    KDReports::PageListModel *m_pageListModel;
+    KDReports::ThumbnailRenderer m_thumbnailRenderer;
+    QFutureWatcher<bool> m_relayoutWatcher;
+    bool m_relayoutPending = false; // the page geometry changed again during the relayout
+    KDReports::TextSearcher m_textSearcher;
+    QTimer m_searchTimer; // to search once the user stops typing
+    int m_currentHit = -1;
+    bool m_jumpToFirstHit = false; // when the user typed something, but not when searching again after a relayout
+    bool m_followingScroll = false; // the current page and the scroll position are being synchronized, when scrolling continuously
+    QPair<int, int> m_highlightedPages {-1, -1};
     KDReports::PreviewWidget *q;
     int m_pageCount = 0;
-    int m_firstDirtyPreviewItem = -1;
     bool m_eatPageNumberClick = false;
     bool m_onAnchor = false;
 };
 
 KDReports::PreviewWidgetPrivate::PreviewWidgetPrivate(KDReports::PreviewWidget *w)
-    : m_previewWidget(new PagePreviewWidget)
+    : m_tileRenderer(new PageTileRenderer(w))
+    , m_previewWidget(new PagePreviewWidget(m_tileRenderer))
+    , m_pageListModel(new PageListModel(w))
     , q(w)
 {
-    QObject::connect(&m_previewTimer, &QTimer::timeout, q, [this]() { previewNextItems(); });
-    QObject::connect(m_previewWidget, &PagePreviewWidget::mouseMoved, q, [this](QPoint pos) {
-        handleMouseMove(pos);
+    QObject::connect(m_pageListModel, &PageListModel::thumbnailsNeeded, q, [this](const QVector<int> &pageNumbers) {
+        requestThumbnails(pageNumbers);
+    });
+    QObject::connect(&m_thumbnailRenderer, &ThumbnailRenderer::thumbnailReady, m_pageListModel, &PageListModel::setThumbnail);
+    QObject::connect(&m_relayoutWatcher, &QFutureWatcher<bool>::finished, q, [this]() { relayoutFinished(); });
+    QObject::connect(m_tileRenderer, &PageTileRenderer::tileReady, q, [this](int pageNumber) {
+        m_previewWidget->updatePage(pageNumber);
     });
-    QObject::connect(m_previewWidget, &PagePreviewWidget::mouseClicked, q, [this](QPoint pos) {
-        handleMouseRelease(pos);
+    QObject::connect(&m_textSearcher, &TextSearcher::hitsFound, q, [this](int first) { searchHitsFound(first); });
+    QObject::connect(&m_textSearcher, &TextSearcher::finished, q, [this]() { searchFinished(); });
+    m_searchTimer.setSingleShot(true);
+    m_searchTimer.setInterval(250);
+    QObject::connect(&m_searchTimer, &QTimer::timeout, q, [this]() {
+        m_jumpToFirstHit = true;
+        startSearch();
+    });
+    QObject::connect(m_previewWidget, &PagePreviewWidget::mouseMoved, q, [this](int pageNumber, QPoint pos) {
+        handleMouseMove(pageNumber, pos);
+    });
+    QObject::connect(m_previewWidget, &PagePreviewWidget::mouseClicked, q, [this](int pageNumber, QPoint pos) {
+        handleMouseRelease(pageNumber, pos);
     });
 }
 
@@ -160,13 +343,19 @@ void KDReports::PreviewWidgetPrivate::init()
     pageList->setIconSize(QSize(PreviewSize, PreviewSize));
     pageList->setViewMode(QListView::IconMode);
     pageList->setMovement(QListView::Static);
+    // So that the layout doesn't need the thumbnails of all pages
+    pageList->setUniformItemSizes(true);
+    pageList->setModel(m_pageListModel);
     previewArea->setWidget(m_previewWidget);
     setupComboBoxes();
     previewArea->setFocus();
     fillZoomCombo();
 
     // m_tableBreakingButton = buttonBox->addButton( tr("Table Breaking / Font Scaling..." ), QDialogButtonBox::ActionRole );
-    QObject::connect(tableBreakingButton, &QAbstractButton::clicked, q, &PreviewWidget::tableSettingsClicked);
+    QObject::connect(tableBreakingButton, &QAbstractButton::clicked, q, [this]() {
+        waitForRelayout(); // the application modifies the report
+        Q_EMIT q->tableSettingsClicked();
+    });
 
     QObject::connect(firstPage, &QAbstractButton::clicked, q, [this]() { slotFirstPage(); });
     QObject::connect(prevPage, &QAbstractButton::clicked, q, [this]() { slotPrevPage(); });
@@ -175,7 +364,7 @@ void KDReports::PreviewWidgetPrivate::init()
     QObject::connect(zoomIn, &QAbstractButton::clicked, q, [this]() { slotZoomIn(); });
     QObject::connect(zoomOut, &QAbstractButton::clicked, q, [this]() { slotZoomOut(); });
     QObject::connect(zoomCombo, QOverload<int>::of(&QComboBox::activated), q, [this]() { slotZoomChanged(); });
-    QObject::connect(pageList, &QListWidget::currentRowChanged, q, [this]() { slotCurrentPageChanged(); });
+    QObject::connect(pageList->selectionModel(), &QItemSelectionModel::currentRowChanged, q, [this]() { slotCurrentPageChanged(); });
     QObject::connect(paperSizeCombo, QOverload<int>::of(&QComboBox::activated), q, [this](int idx) { slotPaperSizeActivated(idx); });
     QObject::connect(paperOrientationCombo, QOverload<int>::of(&QComboBox::activated), q, [this](int idx) { slotPaperOrientationActivated(idx); });
 
@@ -187,78 +376,48 @@ void KDReports::PreviewWidgetPrivate::init()
     QObject::connect(prevPageShortcut, &QShortcut::activated, q, [this]() { slotPrevPage(); });
     pageNumber->setValidator(new QIntValidator(1, 100000, pageNumber));
     pageNumber->installEventFilter(q);
-}
 
-void KDReports::PreviewWidgetPrivate::paintItem(QListWidgetItem *item, int index) const
-{
-    // qDebug() << "paintItem" << index;
+    QObject::connect(continuousScroll, &QAbstractButton::toggled, q, [this](bool checked) { setContinuous(checked); });
+    QObject::connect(previewArea->verticalScrollBar(), &QAbstractSlider::valueChanged, q, [this]() { previewScrolled(); });
 
-    // Use a QImage so that the raster paint engine is used.
-    // Gives a 7.7 times speedup (!) compared to X11.
-    const qreal dpr = q->devicePixelRatioF();
-    QImage img(PreviewSize * dpr, PreviewSize * dpr, QImage::Format_ARGB32_Premultiplied);
-    img.setDevicePixelRatio(dpr);
-    img.fill(Qt::transparent);
-    const QSizeF paperSize = m_report->paperSize();
-    const qreal paperWidth = paperSize.width();
-    const qreal paperHeight = paperSize.height();
-    const qreal longestSide = qMax(paperWidth, paperHeight);
-    const qreal width = PreviewSize * paperWidth / longestSide;
-    const qreal height = PreviewSize * paperHeight / longestSide;
-    QPainter painter(&img);
-    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform, true);
-    painter.translate((PreviewSize - width) / 2, (PreviewSize - height) / 2);
-    painter.fillRect(QRectF(0, 0, width, height), QBrush(Qt::white));
-    painter.scale(PreviewSize / longestSide, PreviewSize / longestSide);
-    m_report->paintPage(index, painter);
-    painter.setPen(QPen(1));
-    painter.drawRect(QRectF(0, 0, paperWidth, paperHeight));
-
-    item->setIcon(QIcon(QPixmap::fromImage(img)));
+    QObject::connect(searchText, &QLineEdit::textChanged, q, [this]() { m_searchTimer.start(); });
+    QObject::connect(findNext, &QAbstractButton::clicked, q, [this]() { slotFindNext(); });
+    QObject::connect(findPrevious, &QAbstractButton::clicked, q, [this]() { slotFindPrevious(); });
+    auto *findShortcut = new QShortcut(QKeySequence::Find, q);
+    QObject::connect(findShortcut, &QShortcut::activated, q, [this]() {
+        searchText->setFocus();
+        searchText->selectAll();
+    });
+    auto *findNextShortcut = new QShortcut(QKeySequence::FindNext, q);
+    QObject::connect(findNextShortcut, &QShortcut::activated, q, [this]() { slotFindNext(); });
+    auto *findPreviousShortcut = new QShortcut(QKeySequence::FindPrevious, q);
+    QObject::connect(findPreviousShortcut, &QShortcut::activated, q, [this]() { slotFindPrevious(); });
+    searchText->installEventFilter(q);
+    updateSearchResult();
 }
 
-void KDReports::PreviewWidgetPrivate::previewNextItems()
+int KDReports::PreviewWidgetPrivate::currentPage() const
 {
-    if (m_firstDirtyPreviewItem == -1 || m_firstDirtyPreviewItem >= m_pageCount) {
-        m_previewTimer.stop();
-        m_firstDirtyPreviewItem = -1;
-    } else {
-        // Do next preview
-        paintItem(pageList->item(m_firstDirtyPreviewItem), m_firstDirtyPreviewItem);
-        ++m_firstDirtyPreviewItem;
-    }
+    return pageList->currentIndex().row();
 }
 
-QPixmap KDReports::PreviewWidgetPrivate::paintPreview(int index) const
+void KDReports::PreviewWidgetPrivate::setCurrentPage(int pageNumber)
 {
-    const QSizeF paperSize = m_report->paperSize();
-    const int width = qCeil(paperSize.width() * m_zoomFactor);
-    const int height = qCeil(paperSize.height() * m_zoomFactor);
-    const qreal dpr = q->devicePixelRatioF();
-
-    QPixmap pixmap(width * dpr, height * dpr);
-    pixmap.setDevicePixelRatio(dpr);
-    pixmap.fill(Qt::transparent);
-    // qDebug() << width << "," << height;
-
-    // qDebug() << "paintPreview " << index;
-
-    QPainter painter(&pixmap);
-    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform, true);
-
-    painter.fillRect(QRectF(0, 0, width, height), QBrush(Qt::white));
-    painter.scale(m_zoomFactor, m_zoomFactor);
-    m_report->paintPage(index, painter);
-    painter.setPen(QPen(1));
-    painter.drawRect(QRectF(0, 0, paperSize.width(), paperSize.height()));
+    pageList->setCurrentIndex(m_pageListModel->index(pageNumber));
+}
 
-    return pixmap;
+void KDReports::PreviewWidgetPrivate::requestThumbnails(const QVector<int> &pageNumbers)
+{
+    m_thumbnailRenderer.setThumbnailSize(PreviewSize, q->devicePixelRatioF());
+    m_thumbnailRenderer.requestThumbnails(pageNumbers);
 }
 
-void KDReports::PreviewWidgetPrivate::handleMouseMove(QPoint pos)
+void KDReports::PreviewWidgetPrivate::handleMouseMove(int pageNumber, QPoint pos)
 {
+    if (m_relayoutWatcher.isRunning())
+        return;
     const QPoint unscaledPos = pos / m_zoomFactor;
-    const QString link = m_report->anchorAt(pageList->currentRow(), unscaledPos);
+    const QString link = m_report->anchorAt(pageNumber, unscaledPos);
     if (link.isEmpty()) { // restore cursor
         q->unsetCursor();
         m_onAnchor = false;
@@ -268,10 +427,12 @@ void KDReports::PreviewWidgetPrivate::handleMouseMove(QPoint pos)
     }
 }
 
-void KDReports::PreviewWidgetPrivate::handleMouseRelease(QPoint pos)
+void KDReports::PreviewWidgetPrivate::handleMouseRelease(int pageNumber, QPoint pos)
 {
+    if (m_relayoutWatcher.isRunning())
+        return;
     const QPoint unscaledPos = pos / m_zoomFactor;
-    const QString link = m_report->anchorAt(pageList->currentRow(), unscaledPos);
+    const QString link = m_report->anchorAt(pageNumber, unscaledPos);
     if (!link.isEmpty()) {
         Q_EMIT q->linkActivated(QUrl(link));
     }
@@ -279,20 +440,16 @@ void KDReports::PreviewWidgetPrivate::handleMouseRelease(QPoint pos)
 
 void KDReports::PreviewWidgetPrivate::printSelectedPages()
 {
-    // Well, the user can modify the page size in the printer dialog too - ensure layout matches
-    // qDebug() << "pageSize: " << m_printer.pageSize();
-    m_report->setPageSize(m_printer.pageLayout().pageSize());
-    m_report->setPageOrientation(m_printer.pageLayout().orientation());
-    pageCountChanged();
+    waitForRelayout();
+    // Well, the user can modify the page size in the printer dialog too - ensure layout matches.
+    // Usually it didn't change, then the pages which are shown are printed as is.
+    if (applyPageLayout())
+        pageCountChanged();
 
     // ### But how do we match "marked pages" from a previous layout into the new layout?
     // ### Hardly makes sense...
 
-    int markedPages = 0;
-    for (int pageIndex = 0; pageIndex < pageList->count(); ++pageIndex) {
-        if (pageList->item(pageIndex)->checkState() == Qt::Checked)
-            ++markedPages;
-    }
+    const int markedPages = m_pageListModel->checkedCount();
 
     QProgressDialog dialog(QObject::tr("Printing"), QObject::tr("Cancel"), 0, markedPages, q);
     dialog.setWindowModality(Qt::ApplicationModal);
@@ -315,7 +472,8 @@ void KDReports::PreviewWidgetPrivate::printSelectedPages()
             if (!firstPage)
                 m_printer.newPage();
 
-            m_report->paintPage(pageIndex, painter);
+            // Replayed from the page cache if the page was recorded for the preview already
+            painter.drawPicture(0, 0, m_report->d->pagePicture(pageIndex));
             dialog.setValue(++printed);
             firstPage = false;
         }
@@ -369,69 +527,259 @@ void KDReports::PreviewWidgetPrivate::slotCurrentPageChanged()
 
 void KDReports::PreviewWidgetPrivate::updatePageButtons()
 {
-    prevPage->setEnabled(pageList->currentRow() > 0);
-    nextPage->setEnabled(pageList->currentRow() < pageList->count() - 1);
-    pageNumber->setText(QString::number(pageList->currentRow() + 1));
+    prevPage->setEnabled(currentPage() > 0);
+    nextPage->setEnabled(currentPage() < m_pageCount - 1);
+    pageNumber->setText(QString::number(currentPage() + 1));
 }
 
 void KDReports::PreviewWidgetPrivate::updatePreview()
 {
-    if (!pageList->currentItem())
+    if (currentPage() < 0)
         return;
-    const QSize oldSize = m_previewWidget->pixmapSize();
-    const QPixmap pixmap = paintPreview(pageList->currentRow());
-    m_previewWidget->setPixmap(pixmap);
-    if (pixmap.size() != oldSize) {
+    const QSize oldSize = m_previewWidget->contentsSize();
+    m_tileRenderer->setDevicePixelRatio(q->devicePixelRatioF());
+    m_previewWidget->setPage(currentPage(), m_zoomFactor);
+    // Otherwise one page is shown at a time, even if continuous scrolling is on
+    continuousScroll->setEnabled(m_previewWidget->fitsContinuously());
+    if (m_previewWidget->contentsSize() != oldSize) {
         centerPreview();
     }
+    if (m_previewWidget->isContinuous() && !m_followingScroll)
+        scrollToPage(currentPage());
+    updateHighlights();
+}
+
+void KDReports::PreviewWidgetPrivate::setContinuous(bool continuous)
+{
+    m_previewWidget->setContinuous(continuous);
+    centerPreview();
+    if (continuous)
+        scrollToPage(currentPage());
+    updateHighlights();
+}
+
+void KDReports::PreviewWidgetPrivate::scrollToPage(int pageNumber)
+{
+    if (pageNumber < 0)
+        return;
+    // The last pages can't always be scrolled to the top: the current page stays the requested one
+    m_followingScroll = true;
+    previewArea->verticalScrollBar()->setValue(m_previewWidget->pagePosition(pageNumber).y() - s_pageSpacing);
+    m_followingScroll = false;
+}
+
+// When scrolling continuously, the current page is the one at the top of the viewport.
+// The pages are only painted where visible, see PagePreviewWidget::requestTiles.
+void KDReports::PreviewWidgetPrivate::previewScrolled()
+{
+    if (!m_previewWidget->isContinuous() || m_pageCount == 0)
+        return;
+    const int page = m_previewWidget->pageAt(previewArea->verticalScrollBar()->value() + s_pageSpacing);
+    if (page != currentPage() && !m_followingScroll) {
+        m_followingScroll = true;
+        setCurrentPage(page);
+        m_followingScroll = false;
+    }
+    int first;
+    int last;
+    visiblePages(&first, &last);
+    if (qMakePair(first, last) != m_highlightedPages)
+        updateHighlights();
+}
+
+void KDReports::PreviewWidgetPrivate::visiblePages(int *first, int *last) const
+{
+    if (!m_previewWidget->isContinuous()) {
+        *first = *last = currentPage();
+        return;
+    }
+    const int top = previewArea->verticalScrollBar()->value();
+    *first = m_previewWidget->pageAt(top);
+    *last = m_previewWidget->pageAt(top + previewArea->viewport()->height());
 }
 
 void KDReports::PreviewWidgetPrivate::pageNumberReturnPressed()
 {
     bool ok;
     const int newPageNumber = pageNumber->text().toInt(&ok) - 1;
-    if (!ok || newPageNumber < 0 || newPageNumber > pageList->count() - 1)
+    if (!ok || newPageNumber < 0 || newPageNumber > m_pageCount - 1)
+        return;
+    setCurrentPage(newPageNumber);
+}
+
+// Searches the text of the report, as indexed after the last layout, in a thread.
+// The hits are highlighted on the pages as they are found.
+void KDReports::PreviewWidgetPrivate::startSearch()
+{
+    m_searchTimer.stop();
+    m_currentHit = -1;
+    const QString text = searchText->text();
+    if (text.isEmpty() || !m_report || m_relayoutWatcher.isRunning()) {
+        // After a relayout, pageCountChanged() searches again
+        m_textSearcher.clear();
+    } else {
+        m_textSearcher.search(m_report->d->pageTextIndex(), text, Qt::CaseInsensitive);
+    }
+    updateSearchResult();
+    updateHighlights();
+}
+
+void KDReports::PreviewWidgetPrivate::searchHitsFound(int first)
+{
+    const QVector<SearchHit> &hits = m_textSearcher.hits();
+    if (m_jumpToFirstHit) {
+        // The first hit from the current page on
+        for (int i = first; i < hits.size(); ++i) {
+            if (hits.at(i).pageNumber >= currentPage()) {
+                m_jumpToFirstHit = false;
+                goToHit(i);
+                return;
+            }
+        }
+    }
+    updateSearchResult();
+    for (int i = first; i < hits.size(); ++i) {
+        if (hits.at(i).pageNumber == currentPage()) {
+            updateHighlights();
+            break;
+        }
+    }
+}
+
+void KDReports::PreviewWidgetPrivate::searchFinished()
+{
+    if (m_jumpToFirstHit && !m_textSearcher.hits().isEmpty()) {
+        // Nothing after the current page: wrap around
+        m_jumpToFirstHit = false;
+        goToHit(0);
         return;
-    pageList->setCurrentRow(newPageNumber);
+    }
+    m_jumpToFirstHit = false;
+    updateSearchResult();
+}
+
+void KDReports::PreviewWidgetPrivate::slotFindNext()
+{
+    if (m_searchTimer.isActive()) {
+        m_searchTimer.stop();
+        m_jumpToFirstHit = true;
+        startSearch();
+        return;
+    }
+    const QVector<SearchHit> &hits = m_textSearcher.hits();
+    if (hits.isEmpty())
+        return;
+    if (m_currentHit >= 0) {
+        goToHit((m_currentHit + 1) % hits.size());
+        return;
+    }
+    auto it = std::find_if(hits.constBegin(), hits.constEnd(), [this](const SearchHit &hit) { return hit.pageNumber >= currentPage(); });
+    goToHit(it == hits.constEnd() ? 0 : static_cast<int>(std::distance(hits.constBegin(), it)));
+}
+
+void KDReports::PreviewWidgetPrivate::slotFindPrevious()
+{
+    const QVector<SearchHit> &hits = m_textSearcher.hits();
+    if (m_searchTimer.isActive() || hits.isEmpty())
+        return;
+    if (m_currentHit >= 0) {
+        goToHit((m_currentHit + hits.size() - 1) % hits.size());
+        return;
+    }
+    int hit = hits.size() - 1;
+    while (hit > 0 && hits.at(hit).pageNumber > currentPage())
+        --hit;
+    goToHit(hit);
+}
+
+// Shows the hit, on the pages of the current layout: nothing is layouted again
+void KDReports::PreviewWidgetPrivate::goToHit(int hit)
+{
+    m_currentHit = hit;
+    const SearchHit &searchHit = m_textSearcher.hits().at(hit);
+    if (searchHit.pageNumber != currentPage())
+        setCurrentPage(searchHit.pageNumber); // updates the highlights
+    else
+        updateHighlights();
+    updateSearchResult();
+
+    if (m_relayoutWatcher.isRunning())
+        return;
+    const QVector<QRect> rects = m_report->d->textRects(searchHit.pageNumber, searchHit.position, searchHit.length);
+    if (!rects.isEmpty()) {
+        const QRect rect(rects.first().topLeft() * m_zoomFactor, rects.first().size() * m_zoomFactor);
+        const QPoint center = rect.center() + m_previewWidget->pagePosition(searchHit.pageNumber);
+        previewArea->ensureVisible(center.x(), center.y(), rect.width() / 2 + 50, rect.height() / 2 + 50);
+    }
+}
+
+void KDReports::PreviewWidgetPrivate::updateSearchResult()
+{
+    const int count = m_textSearcher.hits().size();
+    findNext->setEnabled(count > 0);
+    findPrevious->setEnabled(count > 0);
+    if (searchText->text().isEmpty() || m_searchTimer.isActive())
+        searchResult->clear();
+    else if (count == 0)
+        searchResult->setText(m_textSearcher.isFinished() ? PreviewWidget::tr("Not found") : QString());
+    else if (m_currentHit >= 0)
+        searchResult->setText(PreviewWidget::tr("%1 of %2").arg(m_currentHit + 1).arg(count));
+    else
+        searchResult->setText(PreviewWidget::tr("%n match(es)", nullptr, count));
+}
+
+void KDReports::PreviewWidgetPrivate::updateHighlights()
+{
+    if (m_relayoutWatcher.isRunning())
+        return; // the pages of the previous layout are still shown, with their highlights
+    int first;
+    int last;
+    visiblePages(&first, &last);
+    m_highlightedPages = qMakePair(first, last);
+    QVector<PagePreviewWidget::Highlight> highlights;
+    const QVector<SearchHit> &hits = m_textSearcher.hits();
+    for (int i = 0; i < hits.size(); ++i) {
+        const SearchHit &hit = hits.at(i);
+        if (hit.pageNumber < first || hit.pageNumber > last)
+            continue;
+        const QVector<QRect> rects = m_report->d->textRects(hit.pageNumber, hit.position, hit.length);
+        for (const QRect &rect : rects)
+            highlights.append(PagePreviewWidget::Highlight {hit.pageNumber, rect, i == m_currentHit});
+    }
+    m_previewWidget->setHighlights(highlights);
 }
 
 void KDReports::PreviewWidgetPrivate::slotFirstPage()
 {
-    pageList->setCurrentRow(0);
+    setCurrentPage(0);
 }
 
 void KDReports::PreviewWidgetPrivate::slotPrevPage()
 {
-    if (!pageList->currentItem() || pageList->currentRow() == 0)
+    if (currentPage() <= 0)
         return;
-    pageList->setCurrentRow(pageList->currentRow() - 1);
+    setCurrentPage(currentPage() - 1);
 }
 
 void KDReports::PreviewWidgetPrivate::slotNextPage()
 {
-    if (!pageList->currentItem() || pageList->currentRow() >= pageList->count() - 1)
+    if (currentPage() < 0 || currentPage() >= m_pageCount - 1)
         return;
-    pageList->setCurrentRow(pageList->currentRow() + 1);
+    setCurrentPage(currentPage() + 1);
 }
 
 void KDReports::PreviewWidgetPrivate::slotLastPage()
 {
-    if (pageList->count() == 0) // can't happen
+    if (m_pageCount == 0) // can't happen
         return;
-    pageList->setCurrentRow(pageList->count() - 1);
+    setCurrentPage(m_pageCount - 1);
 }
 
 void KDReports::PreviewWidgetPrivate::slotPaperSizeActivated(int index)
 {
     const QPageSize qPageSize(static_cast<QPageSize::PageSizeId>(paperSizeCombo->itemData(index).toInt()));
     m_printer.setPageSize(qPageSize);
-    if (qPageSize.id() == QPageSize::Custom) {
-        m_report->setWidthForEndlessPrinter(m_endlessPrinterWidth);
-    } else {
-        m_report->setWidthForEndlessPrinter(0);
-        m_report->setPageSize(qPageSize);
-    }
-    pageCountChanged();
+    relayout();
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     emit q->pageSizeChanged(static_cast<QPrinter::PageSize>(qPageSize.id()));
 #else
@@ -443,8 +791,7 @@ void KDReports::PreviewWidgetPrivate::slotPaperOrientationActivated(int index)
 {
     const QPageLayout::Orientation orientation = static_cast<QPageLayout::Orientation>(paperOrientationCombo->itemData(index).toInt());
     m_printer.setPageOrientation(orientation);
-    m_report->setPageOrientation(orientation);
-    pageCountChanged();
+    relayout();
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     emit q->orientationChanged(static_cast<QPrinter::Orientation>(orientation));
 #else
@@ -452,9 +799,68 @@ void KDReports::PreviewWidgetPrivate::slotPaperOrientationActivated(int index)
 #endif
 }
 
+// Applies the page geometry of m_printer to the report.
+// Returns false if it didn't change, i.e. the current layout is still valid.
+bool KDReports::PreviewWidgetPrivate::applyPageLayout()
+{
+    const QPageLayout pageLayout = m_printer.pageLayout();
+    // Only marks the layout dirty, the layouting is up to the caller
+    if (pageLayout.pageSize().id() == QPageSize::Custom) {
+        m_report->d->setWidthForEndlessPrinter(m_endlessPrinterWidth);
+    } else {
+        m_report->d->setWidthForEndlessPrinter(0);
+        m_report->setPageSize(pageLayout.pageSize());
+    }
+    m_report->setPageOrientation(pageLayout.orientation());
+    return m_report->d->m_pageContentSizeDirty;
+}
+
+// Layouts the report for the page geometry of m_printer in the background.
+// The pages of the previous layout are shown until it's done, from the tiles and thumbnails
+// which were already rendered: the report can't be used in the meantime.
+// Returns false if no layouting was started, because the geometry didn't change.
+bool KDReports::PreviewWidgetPrivate::relayout()
+{
+    if (m_relayoutWatcher.isRunning()) {
+        m_relayoutPending = true; // the report can't be modified until the current relayout is done
+        return true;
+    }
+    m_relayoutPending = false;
+    if (!applyPageLayout())
+        return false;
+
+    m_tileRenderer->setFrozen(true);
+    m_thumbnailRenderer.setFrozen(true);
+    m_relayoutWatcher.setFuture(m_report->layoutAsync());
+    return true;
+}
+
+void KDReports::PreviewWidgetPrivate::relayoutFinished()
+{
+    m_tileRenderer->setFrozen(false);
+    m_thumbnailRenderer.setFrozen(false);
+    if (m_relayoutPending && relayout()) {
+        return; // for the latest geometry, still showing the old pages
+    }
+    // Switch to the new layout, all at once; it doesn't block since the report is layouted already
+    pageCountChanged();
+}
+
+// Waits until the report can be used from the GUI thread again.
+// A geometry chosen during the relayout is applied to the report, which layouts when it's used next.
+void KDReports::PreviewWidgetPrivate::waitForRelayout()
+{
+    m_relayoutWatcher.waitForFinished();
+    m_tileRenderer->setFrozen(false);
+    m_thumbnailRenderer.setFrozen(false);
+    if (m_relayoutPending) {
+        m_relayoutPending = false;
+        applyPageLayout();
+    }
+}
+
 void KDReports::PreviewWidgetPrivate::pageCountChanged()
 {
-    qApp->setOverrideCursor(Qt::WaitCursor); // layouting could take a long time
     if (m_printer.pageLayout().pageSize().id() == QPageSize::Custom) {
         // Printing without page breaks -> only one page
         m_pageCount = 1;
@@ -472,48 +878,25 @@ void KDReports::PreviewWidgetPrivate::pageCountChanged()
     pageNumber->setMaximumWidth(numberWidth);
     pageCount->setText(QStringLiteral(" / ") + QString::number(m_pageCount));
 
-    // Ensure that the treewidget has the right number of items
-    int numberOfItems = pageList->count();
-    while (numberOfItems < m_pageCount) {
-        auto *item = new QListWidgetItem(pageList);
-        item->setText(QString::number(numberOfItems + 1));
-        item->setCheckState(Qt::Checked);
-        ++numberOfItems;
-    }
-    if (pageList->currentRow() >= m_pageCount) { // avoid crash
+    // Ensure that the page list has the right number of items
+    if (currentPage() >= m_pageCount) { // avoid crash
         // qDebug() << "Adjusting current row to" << m_pageCount - 1;
-        pageList->setCurrentRow(m_pageCount - 1);
-    }
-    while (numberOfItems > m_pageCount) {
-        delete pageList->item(numberOfItems - 1);
-        --numberOfItems;
+        setCurrentPage(m_pageCount - 1);
     }
+    m_pageListModel->setPageCount(m_pageCount);
+    m_previewWidget->setPageCount(m_pageCount);
 
-    QPixmap whitePixmap(PreviewSize, PreviewSize);
-    whitePixmap.fill(Qt::white);
-
-    for (int index = 0; index < m_pageCount; ++index)
-        pageList->item(index)->setIcon(whitePixmap);
-
-    m_firstDirtyPreviewItem = 0;
-// #define PAINT_ALL_PREVIEWS
-#ifdef PAINT_ALL_PREVIEWS
-    QTime dt;
-    dt.start();
-    while (m_firstDirtyPreviewItem != -1) {
-        previewNextItems();
-    }
-    // Debug mode:
-    // 500 rows, Qt-4.5 or 4.6, no antialiasing, T500 laptop, -O0 or -O2: 42 previews in 8.2s to 8.8s
-    qDebug() << m_pageCount << "previews in" << dt.elapsed() / 1000.0 << "s";
-#else
-    m_previewTimer.start(0);
-#endif
+    // The thumbnails and the preview tiles are rendered in the background, when shown
+    m_thumbnailRenderer.invalidate();
+    m_tileRenderer->invalidate();
+    m_pageListModel->setThumbnailSize(PreviewSize, q->devicePixelRatioF());
+    m_pageListModel->clearThumbnails();
 
     updatePageButtons();
     updatePreview();
     centerPreview();
-    qApp->restoreOverrideCursor();
+    // The hits moved to other pages
+    startSearch();
 }
 
 void KDReports::PreviewWidgetPrivate::centerPreview()
@@ -526,8 +909,8 @@ void KDReports::PreviewWidgetPrivate::centerPreview()
     m_previewWidget->move( offset );
 #endif
     // So: make it big, instead. At least as big as the viewport.
-    int width = qMax(m_previewWidget->pixmapWidth(), previewArea->viewport()->width());
-    int height = qMax(m_previewWidget->pixmapHeight(), previewArea->viewport()->height());
+    int width = qMax(m_previewWidget->contentsSize().width(), previewArea->viewport()->width());
+    int height = qMax(m_previewWidget->contentsSize().height(), previewArea->viewport()->height());
     m_previewWidget->resize(width, height);
 }
 
@@ -600,14 +983,12 @@ KDReports::PreviewWidget::PreviewWidget(QWidget *parent)
 
 KDReports::PreviewWidget::~PreviewWidget()
 {
+    d->waitForRelayout();
 }
 
 bool KDReports::PreviewWidget::isSelected(int pageNumber) const
 {
-    if (pageNumber >= 0 && pageNumber < d->pageList->count())
-        return (d->pageList->item(pageNumber)->checkState() == Qt::Checked);
-    else
-        return false;
+    return d->m_pageListModel->isChecked(pageNumber);
 }
 
 void KDReports::PreviewWidget::resizeEvent(QResizeEvent *)
@@ -632,6 +1013,18 @@ bool KDReports::PreviewWidget::eventFilter(QObject *obj, QEvent *ev)
 {
     // Watch for Return in the pageNumber lineedit.
     // We could just connect to returnPressed(), but the dialog's OK button would still trigger.
+    // Return in the search field goes to the next hit, Shift+Return to the previous one
+    if (obj == d->searchText && ev->type() == QEvent::KeyPress) {
+        auto *keyev = static_cast<QKeyEvent *>(ev);
+        if (keyev->key() == Qt::Key_Enter || keyev->key() == Qt::Key_Return) {
+            if (keyev->modifiers() & Qt::ShiftModifier)
+                d->slotFindPrevious();
+            else
+                d->slotFindNext();
+            keyev->accept();
+            return true;
+        }
+    }
     if (obj == d->pageNumber) {
         if (ev->type() == QEvent::KeyPress) {
             auto *keyev = static_cast<QKeyEvent *>(ev);
@@ -660,6 +1053,7 @@ void KDReports::PreviewWidget::setWidthForEndlessPrinter(qreal widthMM)
 
 KDReports::Report *KDReports::PreviewWidget::report() const
 {
+    d->waitForRelayout(); // so that the caller can use the report right away
     return d->m_report;
 }
 
@@ -675,17 +1069,12 @@ bool KDReports::PreviewWidget::printWithDialog()
     if (dialog->exec() == QDialog::Accepted && dialog) {
         if (dialog->printRange() == QAbstractPrintDialog::AllPages) {
             // Select all pages
-            for (int pageIndex = 0; pageIndex < d->pageList->count(); ++pageIndex) {
-                d->pageList->item(pageIndex)->setCheckState(Qt::Checked);
-            }
+            d->m_pageListModel->setCheckedRange(0, d->m_pageCount - 1);
         } else if (dialog->printRange() == QAbstractPrintDialog::PageRange) {
             const int fromPage = dialog->fromPage() - 1; // dialog is 1 based
             const int toPage = dialog->toPage() - 1;
             // Select only pages from <fromPage> to <toPage>
-            for (int pageIndex = 0; pageIndex < d->pageList->count(); ++pageIndex) {
-                const bool checked = (pageIndex >= fromPage && pageIndex <= toPage);
-                d->pageList->item(pageIndex)->setCheckState(checked ? Qt::Checked : Qt::Unchecked);
-            }
+            d->m_pageListModel->setCheckedRange(fromPage, toPage);
         }
         d->printSelectedPages();
         ok = true;
@@ -702,7 +1091,10 @@ void KDReports::PreviewWidget::setReport(KDReports::Report *report)
 void KDReports::PreviewWidgetPrivate::setReport(KDReports::Report *report)
 {
     Q_ASSERT(report);
+    waitForRelayout();
     m_report = report;
+    m_thumbnailRenderer.setReport(report);
+    m_tileRenderer->setReport(report);
     actionBar->setEnabled(true);
 
     // initialize combos from report
@@ -717,14 +1109,19 @@ void KDReports::PreviewWidgetPrivate::setReport(KDReports::Report *report)
 
     m_report->setupPrinter(&m_printer);
     pageCountChanged();
-    if (!pageList->currentItem()) {
+    if (currentPage() < 0) {
         // No page selected yet - select the first one
-        pageList->setCurrentItem(pageList->item(0));
+        setCurrentPage(0);
     }
     slotCurrentPageChanged(); // update preview and buttons
     pageList->scrollToTop();
 }
 
+void KDReports::PreviewWidget::setContinuousScrolling(bool continuous)
+{
+    d->continuousScroll->setChecked(continuous);
+}
+
 void KDReports::PreviewWidget::setShowPageListWidget(bool show)
 {
     d->pageList->setVisible(show);
@@ -732,6 +1129,7 @@ void KDReports::PreviewWidget::setShowPageListWidget(bool show)
 
 void KDReports::PreviewWidget::repaint()
 {
+    d->waitForRelayout();
     d->pageCountChanged();
     d->slotCurrentPageChanged(); // update preview and buttons
 }
@@ -74,6 +74,8 @@ public:
 
     /**
      * \return the report passed to the constructor or to setReport.
+     * If the report is being layouted in the background for a new page size,
+     * this waits until it's done, so that the report can be printed or modified right away.
      */
     KDReports::Report *report() const;
 
@@ -88,6 +90,15 @@ public:
      */
     void setShowPageListWidget(bool show);
 
+    /**
+     * Shows all pages one below the other, instead of one page at a time.
+     * Only the pages in view are rendered. The user can toggle this with a button too.
+     * When the pages don't fit one below the other in a widget (whose height is limited
+     * to QWIDGETSIZE_MAX, i.e. about 15000 A4 pages at 100%), one page is shown at a time.
+     * \since 2.4
+     */
+    void setContinuousScrolling(bool continuous);
+
     /**
      * Updates the preview. Call this after the report has changed.
      */
@@ -99,6 +110,8 @@ public:
     QSize sizeHint() const override;
 
 Q_SIGNALS:
+    // The report is being layouted in the background when these are emitted (see Report::layoutAsync()),
+    // calling PreviewWidget::report() or repaint() waits until it's done.
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     /// Emitted when the user changes the page size.
     void pageSizeChanged(QPrinter::PageSize pageSize);
@@ -13,32 +13,82 @@
 #include "KDReportsHeader.h"
 #include "KDReportsLayoutHelper_p.h"
 #include "KDReportsMainTable.h"
+#include "KDReportsPdfMerger_p.h"
 #include "KDReportsReport_p.h"
 #include "KDReportsSpreadsheetReportLayout_p.h"
 #include "KDReportsTextDocReportLayout_p.h"
+#include "KDReportsTiffWriter_p.h"
 #include "KDReportsXmlParser_p.h"
 
+#include <QAbstractItemModel>
 #include <QAbstractTextDocumentLayout>
 #include <QApplication>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFile>
+#include <QFuture>
 #include <QMap>
+#include <QMutexLocker>
 #include <QPainter>
+#include <QPdfWriter>
+#include <QPicture>
 #include <QPointer>
 #include <QPrintDialog>
 #include <QProgressDialog>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QStyle>
 #include <QStyleOption>
 #include <QThread>
+#include <QThreadPool>
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 Q_GUI_EXPORT extern int qt_defaultDpi(); // This is what QTextDocument uses...
 QT_END_NAMESPACE
 
+namespace {
+// The asynchronous operation running in the current thread, see ReportPrivate::reportPageProgress
+thread_local QFutureInterface<bool> *s_asyncInterface = nullptr;
+
+// Runs a print or export operation in a thread pool, see Report::printAsync
+class AsyncJob : public QRunnable
+{
+public:
+    AsyncJob(QMutex *jobMutex, const std::function<bool()> &job)
+        : m_jobMutex(jobMutex)
+        , m_job(job)
+    {
+    }
+
+    void run() override
+    {
+        QMutexLocker locker(m_jobMutex);
+        if (!m_interface.isCanceled()) {
+            s_asyncInterface = &m_interface;
+            const bool result = m_job();
+            s_asyncInterface = nullptr;
+            m_interface.reportResult(result);
+        }
+        m_interface.reportFinished();
+    }
+
+    QFutureInterface<bool> m_interface;
+
+private:
+    QMutex *m_jobMutex;
+    const std::function<bool()> m_job;
+};
+}
+
 KDReports::ReportPrivate::ReportPrivate(Report *report)
     : m_layoutWidth(0)
     , m_endlessPrinterWidth(0)
@@ -75,10 +125,17 @@ KDReports::ReportPrivate::ReportPrivate(Report *report)
     , m_mainTable(new MainTable)
     , q(report)
 {
+    m_pageCache.setMaxCost(16 * 1024);
+    clearPageCacheOnChanges(static_cast<TextDocReportLayout *>(m_layout)->textDocument().contentDocument());
 }
 
 KDReports::ReportPrivate::~ReportPrivate()
 {
+    // The asynchronous operations use the report
+    for (QFuture<bool> &future : m_asyncJobs)
+        future.cancel();
+    for (QFuture<bool> &future : m_asyncJobs)
+        future.waitForFinished();
     delete m_layout;
     delete m_mainTable;
 }
@@ -102,11 +159,53 @@ QSizeF KDReports::ReportPrivate::paperSize() const
     return m_paperSize;
 }
 
+void KDReports::ReportPrivate::setPageGeometry(const QPageSize &pageSize, QPageLayout::Orientation orientation)
+{
+    const QSizeF oldPaperSize = m_paperSize;
+    m_pageSize = pageSize;
+    m_orientation = orientation;
+    m_paperSize = QSizeF();
+    // Same paper size: the layout is still valid (e.g. when printing from the preview)
+    if (!wantEndlessPrinting() && !oldPaperSize.isEmpty() && paperSize() == oldPaperSize)
+        return;
+    m_pageContentSizeDirty = true;
+}
+
+KDReports::ReportPrivate::PageGeometry KDReports::ReportPrivate::pageGeometry() const
+{
+    return PageGeometry {m_pageSize, m_orientation, m_paperSize};
+}
+
+void KDReports::ReportPrivate::restorePageGeometry(const PageGeometry &geometry)
+{
+    m_pageSize = geometry.pageSize;
+    m_orientation = geometry.orientation;
+    m_paperSize = geometry.paperSize;
+    m_pageContentSizeDirty = true;
+}
+
+void KDReports::ReportPrivate::setWidthForEndlessPrinter(qreal widthMM)
+{
+    if (widthMM) {
+        if (widthMM != m_endlessPrinterWidth || !wantEndlessPrinting()) {
+            m_endlessPrinterWidth = widthMM;
+            m_layoutWidth = mmToPixels(widthMM);
+            m_pageContentSizeDirty = true;
+        }
+    } else if (wantEndlessPrinting()) {
+        m_layoutWidth = 0;
+        m_pageContentSizeDirty = true;
+        // caller will call setPageSize...
+    }
+}
+
 void KDReports::ReportPrivate::ensureLayouted()
 {
+    QMutexLocker locker(&m_paintMutex);
     // We need to do a layout if
     // m_pageContentSizeDirty is true, i.e. page size has changed etc.
     if (m_pageContentSizeDirty) {
+        m_pageCache.clear(); // the pages are painted differently, e.g. the headers changed
         if (!wantEndlessPrinting()) {
             setPaperSizeFromPrinter(paperSize());
         } else {
@@ -249,22 +348,33 @@ KDReports::HeaderLocations KDReports::HeaderMap::headerLocation(Header *header)
     return loc;
 }
 
+void KDReports::ReportPrivate::prepareHeadersForPage(int pageNumber, Header **header, Header **footer)
+{
+    // When streaming, the pages before this one have been removed from the document already,
+    // and the last page of the report isn't known until endStreaming
+    const int reportPageNumber = m_streamedPageCount + pageNumber;
+    const int pageCount = m_lastPageKnown ? m_streamedPageCount + m_layout->numberOfPages() : -1;
+    *header = m_headers.headerForPage(reportPageNumber + 1, pageCount);
+    if (*header) {
+        (*header)->preparePaintingPage(reportPageNumber + m_firstPageNumber - 1);
+    }
+    *footer = m_footers.headerForPage(reportPageNumber + 1, pageCount);
+    if (*footer) {
+        (*footer)->preparePaintingPage(reportPageNumber + m_firstPageNumber - 1);
+    }
+}
+
 void KDReports::ReportPrivate::paintPage(int pageNumber, QPainter &painter)
 {
+    QMutexLocker locker(&m_paintMutex);
     ensureLayouted();
 
-    const int pageCount = m_layout->numberOfPages();
-    KDReports::Header *header = m_headers.headerForPage(pageNumber + 1, pageCount);
-    if (header) {
-        header->preparePaintingPage(pageNumber + m_firstPageNumber - 1);
-    }
-    KDReports::Header *footer = m_footers.headerForPage(pageNumber + 1, pageCount);
-    if (footer) {
-        footer->preparePaintingPage(pageNumber + m_firstPageNumber - 1);
-    }
+    KDReports::Header *header = nullptr;
+    KDReports::Header *footer = nullptr;
+    prepareHeadersForPage(pageNumber, &header, &footer);
 
     if (m_watermarkFunction) {
-        m_watermarkFunction(painter, pageNumber);
+        m_watermarkFunction(painter, m_streamedPageCount + pageNumber);
     }
 
     const QRect textDocRect = mainTextDocRect();
@@ -381,7 +491,8 @@ bool KDReports::ReportPrivate::doPrint(QPrinter *printer, QWidget *parent)
             if (dialog->wasCanceled())
                 break;
         }
-        emit q->printingProgress(pageIndex);
+        if (!reportPageProgress(pageIndex, pageCount))
+            return false; // canceled, see Report::printAsync
 
         if (!firstPage)
             printer->newPage();
@@ -393,6 +504,148 @@ bool KDReports::ReportPrivate::doPrint(QPrinter *printer, QWidget *parent)
     return true;
 }
 
+QFuture<bool> KDReports::ReportPrivate::runAsync(const std::function<bool()> &job)
+{
+    auto *asyncJob = new AsyncJob(&m_asyncJobMutex, job);
+    asyncJob->m_interface.reportStarted();
+    QFuture<bool> future = asyncJob->m_interface.future();
+    m_asyncJobs.erase(std::remove_if(m_asyncJobs.begin(), m_asyncJobs.end(), [](const QFuture<bool> &job) { return job.isFinished(); }), m_asyncJobs.end());
+    m_asyncJobs.append(future);
+    QThreadPool::globalInstance()->start(asyncJob);
+    return future;
+}
+
+QByteArray KDReports::ReportPrivate::pageContentHash(int pageNumber)
+{
+    QMutexLocker locker(&m_paintMutex);
+    ensureLayouted();
+    const QByteArray contentHash = m_layout->pageContentHash(pageNumber);
+    if (contentHash.isEmpty() || m_watermarkFunction)
+        return QByteArray(); // unknown, e.g. in Spreadsheet mode, or painted by the application
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(contentHash);
+
+    QByteArray pageSettings;
+    QDataStream stream(&pageSettings, QIODevice::WriteOnly);
+    stream << m_paperSize << mainTextDocRect() << skipHeadersFooters() << m_watermarkText << m_watermarkRotation << m_watermarkColor << m_watermarkFont
+           << m_watermarkImage.cacheKey();
+    hash.addData(pageSettings);
+
+    KDReports::Header *header = nullptr;
+    KDReports::Header *footer = nullptr;
+    prepareHeadersForPage(pageNumber, &header, &footer); // so that the hash includes the variables
+    for (KDReports::Header *h : {header, footer}) {
+        if (h)
+            hash.addData(h->doc().contentDocumentData().contentHash(0, h->doc().contentDocument().characterCount()));
+    }
+    return hash.result();
+}
+
+void KDReports::ReportPrivate::paintPageIncrementally(int pageNumber, QPainter &painter)
+{
+    QMutexLocker locker(&m_paintMutex);
+    ensureLayouted();
+    m_exportedPages.resize(m_layout->numberOfPages());
+    RecordedPage &page = m_exportedPages[pageNumber];
+    const QByteArray contentHash = pageContentHash(pageNumber);
+    if (contentHash.isEmpty() || contentHash != page.contentHash) {
+        QPicture picture;
+        QPainter picturePainter(&picture);
+        paintPage(pageNumber, picturePainter);
+        picturePainter.end();
+        page.picture = picture;
+        page.contentHash = contentHash;
+    }
+    painter.drawPicture(0, 0, page.picture);
+}
+
+QPicture KDReports::ReportPrivate::pagePicture(int pageNumber)
+{
+    QMutexLocker printLayoutLocker(&m_printLayoutMutex); // wait until print() restored the page geometry
+    QMutexLocker locker(&m_paintMutex);
+    ensureLayouted(); // before hashing, since layouting clears m_pageCache
+    const QByteArray contentHash = pageContentHash(pageNumber);
+    if (!contentHash.isEmpty()) {
+        const RecordedPage *page = m_pageCache.object(pageNumber);
+        if (page && page->contentHash == contentHash)
+            return page->picture;
+    }
+    QPicture picture;
+    QPainter painter(&picture);
+    paintPage(pageNumber, painter);
+    painter.end();
+    if (!contentHash.isEmpty())
+        m_pageCache.insert(pageNumber, new RecordedPage {contentHash, picture}, qMax(1, static_cast<int>(picture.size() / 1024)));
+    return picture;
+}
+
+void KDReports::ReportPrivate::clearPageCacheOnChanges(QTextDocument &document)
+{
+    // Rather than relying on pageContentHash only, which could miss a change
+    // Direct, since the document is modified in the thread of an asynchronous operation too
+    QObject::connect(
+        &document, &QTextDocument::contentsChanged, &document,
+        [this]() {
+            QMutexLocker locker(&m_paintMutex);
+            m_pageCache.clear();
+        },
+        Qt::DirectConnection);
+}
+
+KDReports::PageTextIndex KDReports::ReportPrivate::pageTextIndex()
+{
+    QMutexLocker locker(&m_paintMutex);
+    ensureLayouted();
+    return m_layout->pageTextIndex();
+}
+
+QVector<QRect> KDReports::ReportPrivate::textRects(int pageNumber, int position, int length)
+{
+    QMutexLocker locker(&m_paintMutex);
+    ensureLayouted();
+    const QPoint textDocPos = mainTextDocRect().topLeft();
+    QVector<QRect> result;
+    const auto rects = m_layout->textRects(pageNumber, position, length);
+    for (const QRectF &rect : rects)
+        result.append(rect.translated(textDocPos).toAlignedRect());
+    return result;
+}
+
+QPageLayout KDReports::ReportPrivate::pdfPageLayout() const
+{
+    // m_paperSize is what the layout used, including for the endless printer
+    const QSizeF paperSizePoints = m_paperSize * pixelsToPointsMultiplier(qt_defaultDpi());
+    return QPageLayout(QPageSize(paperSizePoints, QPageSize::Point), QPageLayout::Portrait, QMarginsF());
+}
+
+bool KDReports::ReportPrivate::reportPageProgress(int pageIndex, int pageCount)
+{
+    emit q->printingProgress(pageIndex);
+    if (s_asyncInterface) {
+        s_asyncInterface->setProgressRange(0, pageCount);
+        s_asyncInterface->setProgressValue(pageIndex + 1);
+        return !s_asyncInterface->isCanceled();
+    }
+    return true;
+}
+
+void KDReports::ReportPrivate::printStreamedPages(int pageCount)
+{
+    for (int pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+        if (m_streamedPageCount + pageIndex > 0)
+            m_streamingPrinter->newPage();
+        emit q->printingProgress(m_streamedPageCount + pageIndex);
+        paintPage(pageIndex, *m_streamingPainter);
+    }
+    m_streamedPageCount += pageCount;
+
+    // These pages are final, free their contents
+    ReportBuilder *builder = this->builder();
+    builder->contentDocumentData().clear();
+    builder->contentsCleared();
+}
+
 #ifndef NDEBUG
 void KDReports::ReportPrivate::debugLayoutToPdf(const char *fileName)
 {
@@ -491,9 +744,7 @@ void KDReports::Report::setPageSize(QPageSize::PageSizeId size)
 
 void KDReports::Report::setPageSize(const QPageSize &size)
 {
-    d->m_pageSize = size;
-    d->m_paperSize = QSizeF();
-    d->m_pageContentSizeDirty = true;
+    d->setPageGeometry(size, d->m_orientation);
 }
 
 void KDReports::Report::setPaperSize(QSizeF paperSize, QPrinter::Unit unit)
@@ -514,7 +765,10 @@ void KDReports::Report::setPaperSize(QSizeF paperSize, QPrinter::Unit unit)
     default:
         qWarning("Unsupported printer unit %d", unit);
     }
-    d->m_paperSize = QSizeF(paperSize.width() * factor, paperSize.height() * factor);
+    const QSizeF newPaperSize(paperSize.width() * factor, paperSize.height() * factor);
+    if (newPaperSize == d->m_paperSize && !d->wantEndlessPrinting())
+        return;
+    d->m_paperSize = newPaperSize;
     d->m_pageContentSizeDirty = true;
 }
 
@@ -533,9 +787,7 @@ QPageSize KDReports::Report::pageSize() const
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 void KDReports::Report::setOrientation(QPrinter::Orientation orientation)
 {
-    d->m_orientation = static_cast<QPageLayout::Orientation>(orientation);
-    d->m_paperSize = QSizeF();
-    d->m_pageContentSizeDirty = true;
+    d->setPageGeometry(d->m_pageSize, static_cast<QPageLayout::Orientation>(orientation));
 }
 
 QPrinter::Orientation KDReports::Report::orientation() const
@@ -546,9 +798,7 @@ QPrinter::Orientation KDReports::Report::orientation() const
 
 void KDReports::Report::setPageOrientation(QPageLayout::Orientation orientation)
 {
-    d->m_orientation = orientation;
-    d->m_paperSize = QSizeF();
-    d->m_pageContentSizeDirty = true;
+    d->setPageGeometry(d->m_pageSize, orientation);
 }
 
 QPageLayout::Orientation KDReports::Report::pageOrientation() const
@@ -629,16 +879,9 @@ qreal KDReports::Report::bottomPageMargins() const
 
 void KDReports::Report::setWidthForEndlessPrinter(qreal widthMM)
 {
-    if (widthMM) {
-        d->m_endlessPrinterWidth = widthMM;
-        d->m_layoutWidth = mmToPixels(widthMM);
-        d->m_pageContentSizeDirty = true;
+    d->setWidthForEndlessPrinter(widthMM);
+    if (widthMM)
         d->ensureLayouted();
-    } else {
-        d->m_layoutWidth = 0;
-        d->m_pageContentSizeDirty = true;
-        // caller will call setPageSize...
-    }
 }
 
 void KDReports::Report::paintPage(int pageNumber, QPainter &painter)
@@ -680,8 +923,13 @@ bool KDReports::Report::printWithDialog(QWidget *parent)
 
 bool KDReports::Report::print(QPrinter *printer, QWidget *parent)
 {
-    // save the old page size
-    const auto savePageSize = pageSize();
+    // The preview (see pagePicture) must not paint the report while it's layouted for the printer.
+    // The paint mutex itself is only held while relayouting and while painting each page.
+    QMutexLocker printLayoutLocker(&d->m_printLayoutMutex);
+    QMutexLocker locker(&d->m_paintMutex);
+    // Restored afterwards: unless the printer needed another layout, the report doesn't need to be layouted again
+    const ReportPrivate::PageGeometry savedGeometry = d->pageGeometry();
+    bool relayouted = false;
     if (d->wantEndlessPrinting()) {
         // ensure that the printer is set up with the right size
         d->ensureLayouted();
@@ -689,18 +937,29 @@ bool KDReports::Report::print(QPrinter *printer, QWidget *parent)
         printer->setPageSize(QPageSize(d->m_paperSize * pixelsToPointsMultiplier(printer->resolution()), QPageSize::Point));
 
     } else {
-        // ensure that the layout matches the printer
-        d->setPaperSizeFromPrinter(printer->pageLayout().fullRectPixels(printer->resolution()).size());
+        // ensure that the layout matches the printer; the printer's size is rounded to whole pixels
+        const QSizeF printerPaperSize = printer->pageLayout().fullRectPixels(printer->resolution()).size();
+        const QSizeF paperSize = d->paperSize();
+        if (d->m_pageContentSizeDirty || qAbs(printerPaperSize.width() - paperSize.width()) >= 1 || qAbs(printerPaperSize.height() - paperSize.height()) >= 1) {
+            d->setPaperSizeFromPrinter(printerPaperSize);
+            relayouted = true;
+        }
     }
 
+    locker.unlock(); // doPrint locks it for each page
+    if (!relayouted)
+        printLayoutLocker.unlock(); // same layout: the preview can paint pages in the meantime
+
     printer->setFullPage(true);
 
     // don't call ensureLayouted here, it would use the wrong printer!
 
     const bool ret = d->doPrint(printer, parent);
 
-    // Reset the page size
-    setPageSize(savePageSize);
+    if (relayouted) {
+        locker.relock();
+        d->restorePageGeometry(savedGeometry);
+    }
 
     return ret;
 }
@@ -716,6 +975,49 @@ bool KDReports::Report::exportToFile(const QString &fileName, QWidget *parent)
     return ret;
 }
 
+bool KDReports::Report::beginStreaming(QPrinter *printer)
+{
+    if (d->m_reportMode != WordProcessing) {
+        qWarning("beginStreaming is only supported in WordProcessing mode");
+        return false;
+    }
+    if (d->m_streamingPainter) {
+        qWarning("beginStreaming: already streaming");
+        return false;
+    }
+    setupPrinter(printer);
+    d->m_streamingPainter.reset(new QPainter);
+    if (!d->m_streamingPainter->begin(printer)) {
+        qWarning() << "QPainter failed to initialize on the given printer";
+        d->m_streamingPainter.reset();
+        return false;
+    }
+    d->m_streamingPrinter = printer;
+    d->m_streamedPageCount = 0;
+    d->m_lastPageKnown = false;
+    return true;
+}
+
+bool KDReports::Report::endStreaming()
+{
+    if (!d->m_streamingPainter) {
+        qWarning("endStreaming: beginStreaming wasn't called");
+        return false;
+    }
+    d->m_lastPageKnown = true;
+    d->ensureLayouted();
+    d->printStreamedPages(d->m_layout->numberOfPages());
+    const bool ret = d->m_streamingPainter->end();
+    d->m_streamingPainter.reset();
+    d->m_streamingPrinter = nullptr;
+    return ret;
+}
+
+int KDReports::Report::numberOfStreamedPages() const
+{
+    return d->m_streamedPageCount;
+}
+
 bool KDReports::Report::exportToHtml(const QString &fileName)
 {
     const QString html = d->m_layout->asHtml();
@@ -728,11 +1030,370 @@ bool KDReports::Report::exportToHtml(const QString &fileName)
     return false;
 }
 
+bool KDReports::Report::exportToHtml(QIODevice *device)
+{
+    if (!d->m_layout->writeHtml(device))
+        return false;
+    d->m_layout->finishHtmlExport();
+    return true;
+}
+
+bool KDReports::Report::exportToMarkdown(QIODevice *device)
+{
+    return d->m_layout->writeMarkdown(device);
+}
+
+bool KDReports::Report::exportToOdt(QIODevice *device)
+{
+    return d->m_layout->writeOdt(device);
+}
+
+bool KDReports::Report::exportToCsv(QIODevice *device, QChar separator)
+{
+    if (d->m_reportMode != SpreadSheet) {
+        qWarning("exportToCsv is only supported in SpreadSheet mode");
+        return false;
+    }
+    return static_cast<SpreadsheetReportLayout *>(d->m_layout)->writeCsv(device, separator);
+}
+
+bool KDReports::Report::exportToSpreadsheetXml(QIODevice *device)
+{
+    if (d->m_reportMode != SpreadSheet) {
+        qWarning("exportToSpreadsheetXml is only supported in SpreadSheet mode");
+        return false;
+    }
+    return static_cast<SpreadsheetReportLayout *>(d->m_layout)->writeSpreadsheetXml(device, d->m_documentName);
+}
+
+QFuture<bool> KDReports::Report::printAsync(QPrinter *printer)
+{
+    return d->runAsync([this, printer] { return print(printer); });
+}
+
+QFuture<bool> KDReports::Report::exportToFileAsync(const QString &fileName)
+{
+    return d->runAsync([this, fileName] { return exportToFile(fileName); });
+}
+
+QFuture<bool> KDReports::Report::exportPagesToImagesAsync(const QString &directory, int dpi, const char *format, int fromPage, int toPage)
+{
+    const QByteArray imageFormat(format); // the caller's string might not live long enough
+    return d->runAsync([this, directory, dpi, imageFormat, fromPage, toPage] { return exportPagesToImages(directory, dpi, imageFormat.constData(), fromPage, toPage); });
+}
+
+QFuture<bool> KDReports::Report::exportToHtmlAsync(const QString &fileName)
+{
+    return d->runAsync([this, fileName] {
+        // Not paginated, so the whole export has to be serialized with painting
+        QMutexLocker locker(&d->m_paintMutex);
+        return exportToHtml(fileName);
+    });
+}
+
+QFuture<bool> KDReports::Report::layoutAsync()
+{
+    return d->runAsync([this] {
+        d->ensureLayouted();
+        d->pageTextIndex(); // built now rather than when searching in the preview
+        return true;
+    });
+}
+
 QString KDReports::Report::toHtml() const
 {
     return d->m_layout->toStandaloneHtml();
 }
 
+namespace {
+// Rasterizes a page recorded into a QPicture, and saves it into an image file.
+// Runs in a thread pool: it doesn't touch the report.
+class PageRasterizer : public QRunnable
+{
+public:
+    PageRasterizer(const QPicture &picture, QSize imageSize, int dpi, const QString &fileName, const char *format, char *result, QSemaphore *pagesInFlight)
+        : m_picture(picture)
+        , m_imageSize(imageSize)
+        , m_dpi(dpi)
+        , m_fileName(fileName)
+        , m_format(format)
+        , m_result(result)
+        , m_pagesInFlight(pagesInFlight)
+    {
+    }
+
+    void run() override
+    {
+        QImage image(m_imageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        const qreal zoomFactor = qreal(m_dpi) / qt_defaultDpi();
+        painter.scale(zoomFactor, zoomFactor);
+        painter.drawPicture(0, 0, m_picture);
+        painter.end();
+        // Only now, otherwise the fonts would be scaled up twice
+        const int dotsPerMeter = qRound(m_dpi / 0.0254);
+        image.setDotsPerMeterX(dotsPerMeter);
+        image.setDotsPerMeterY(dotsPerMeter);
+        *m_result = image.save(m_fileName, m_format.constData());
+        m_pagesInFlight->release();
+    }
+
+private:
+    const QPicture m_picture;
+    const QSize m_imageSize;
+    const int m_dpi;
+    const QString m_fileName;
+    const QByteArray m_format;
+    char *m_result;
+    QSemaphore *m_pagesInFlight;
+};
+}
+
+bool KDReports::Report::exportPagesToImages(const QString &directory, int dpi, const char *format, int fromPage, int toPage)
+{
+    const QDir dir(directory);
+    if (!dir.exists() && !dir.mkpath(QStringLiteral("."))) {
+        qWarning() << "exportPagesToImages: could not create directory" << directory;
+        return false;
+    }
+
+    d->ensureLayouted();
+    const int pageCount = d->m_layout->numberOfPages();
+    fromPage = qMax(fromPage, 0);
+    if (toPage < 0 || toPage >= pageCount)
+        toPage = pageCount - 1;
+    if (fromPage > toPage)
+        return false;
+
+    const QSize imageSize = (d->m_paperSize * (qreal(dpi) / qt_defaultDpi())).toSize();
+    const QString suffix = QString::fromLatin1(format).toLower();
+    const int numDigits = QString::number(pageCount).length();
+    QVector<char> results(toPage - fromPage + 1, false);
+
+    QThreadPool pool;
+    // Only record a few pages ahead of the rasterization, otherwise all the pictures would be in memory at once
+    QSemaphore pagesInFlight(2 * pool.maxThreadCount());
+    for (int pageIndex = fromPage; pageIndex <= toPage; ++pageIndex) {
+        if (!d->reportPageProgress(pageIndex, pageCount)) {
+            pool.waitForDone();
+            return false; // canceled, see printAsync
+        }
+        pagesInFlight.acquire();
+        // Painting the page reads the layout and updates the variables in headers and footers,
+        // so it happens here, into a QPicture. Only the rasterization and encoding run in parallel.
+        QPicture picture;
+        QPainter painter(&picture);
+        d->paintPage(pageIndex, painter);
+        painter.end();
+
+        const QString fileName = dir.filePath(QStringLiteral("page-%1.%2").arg(pageIndex + 1, numDigits, 10, QLatin1Char('0')).arg(suffix));
+        pool.start(new PageRasterizer(picture, imageSize, dpi, fileName, format, &results[pageIndex - fromPage], &pagesInFlight));
+    }
+    pool.waitForDone();
+
+    for (char result : std::as_const(results)) {
+        if (!result)
+            return false;
+    }
+    return true;
+}
+
+namespace {
+// Plays pages recorded into QPictures into a PDF document in memory.
+// Runs in a thread pool: it doesn't touch the report.
+// The pages of one range of exportToPdfParallel, painted in the report's thread and written
+// by a PdfChunkWriter as they come
+struct PdfChunk
+{
+    explicit PdfChunk(int pageCount)
+        : pages(pageCount)
+    {
+    }
+
+    QVector<QPicture> pages; // each one is released as soon as it's written
+    QSemaphore paintedPages;
+    QByteArray result;
+};
+
+// Writes the pages of a PdfChunk to a PDF document in memory.
+// Runs in a thread pool: it doesn't touch the report.
+class PdfChunkWriter : public QRunnable
+{
+public:
+    PdfChunkWriter(PdfChunk *chunk, const QPageLayout &pageLayout, const QString &title, QSemaphore *pagesInFlight)
+        : m_chunk(chunk)
+        , m_pageLayout(pageLayout)
+        , m_title(title)
+        , m_pagesInFlight(pagesInFlight)
+    {
+    }
+
+    void run() override
+    {
+        QBuffer buffer(&m_chunk->result);
+        buffer.open(QIODevice::WriteOnly);
+        QPdfWriter writer(&buffer);
+        writer.setResolution(qt_defaultDpi()); // the unit of the layout, so the pictures are played unscaled
+        writer.setPageLayout(m_pageLayout);
+        writer.setTitle(m_title);
+        QPainter painter;
+        const bool ok = painter.begin(&writer);
+        // The pages are taken even if painting failed, so that the report's thread doesn't wait for them
+        for (int i = 0; i < m_chunk->pages.size(); ++i) {
+            m_chunk->paintedPages.acquire();
+            QPicture picture;
+            picture.swap(m_chunk->pages[i]);
+            if (ok && !picture.isNull()) { // null when canceled
+                if (i > 0)
+                    writer.newPage();
+                painter.drawPicture(0, 0, picture);
+            }
+            m_pagesInFlight->release();
+        }
+        if (ok)
+            painter.end();
+        else
+            m_chunk->result.clear();
+    }
+
+private:
+    PdfChunk *m_chunk;
+    const QPageLayout m_pageLayout;
+    const QString m_title;
+    QSemaphore *m_pagesInFlight;
+};
+}
+
+bool KDReports::Report::exportToPdf(QIODevice *device)
+{
+    d->ensureLayouted();
+    const int pageCount = d->m_layout->numberOfPages();
+
+    QPdfWriter writer(device);
+    writer.setResolution(qt_defaultDpi()); // the unit of the layout, so no scaling is needed
+    writer.setPageLayout(d->pdfPageLayout());
+    writer.setTitle(d->m_documentName);
+    writer.setCreator(QStringLiteral("KD Reports"));
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        qWarning("exportToPdf: QPainter failed to initialize on QPdfWriter");
+        return false;
+    }
+    for (int pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+        if (!d->reportPageProgress(pageIndex, pageCount))
+            return false; // canceled, see printAsync
+        if (pageIndex > 0)
+            writer.newPage();
+        if (d->m_incrementalExport)
+            d->paintPageIncrementally(pageIndex, painter);
+        else
+            d->paintPage(pageIndex, painter);
+    }
+    return painter.end();
+}
+
+void KDReports::Report::setIncrementalExportEnabled(bool enable)
+{
+    d->m_incrementalExport = enable;
+    if (!enable)
+        d->m_exportedPages.clear();
+}
+
+bool KDReports::Report::isIncrementalExportEnabled() const
+{
+    return d->m_incrementalExport;
+}
+
+void KDReports::Report::setPageCacheSize(int kiloBytes)
+{
+    QMutexLocker locker(&d->m_paintMutex);
+    d->m_pageCache.setMaxCost(kiloBytes);
+}
+
+int KDReports::Report::pageCacheSize() const
+{
+    return d->m_pageCache.maxCost();
+}
+
+QList<int> KDReports::Report::changedPages()
+{
+    QList<int> pages;
+    const int pageCount = numberOfPages();
+    for (int pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+        const QByteArray contentHash = d->pageContentHash(pageIndex);
+        if (contentHash.isEmpty() || pageIndex >= d->m_exportedPages.size() || contentHash != d->m_exportedPages.at(pageIndex).contentHash)
+            pages.append(pageIndex);
+    }
+    return pages;
+}
+
+bool KDReports::Report::exportToPdfParallel(const QString &fileName, int threadCount)
+{
+    d->ensureLayouted();
+    const int pageCount = d->m_layout->numberOfPages();
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    const int pagesPerChunk = qMax(1, (pageCount + threadCount - 1) / threadCount);
+    const int chunkCount = qMax(1, (pageCount + pagesPerChunk - 1) / pagesPerChunk);
+
+    const QPageLayout pageLayout = d->pdfPageLayout();
+
+    std::vector<std::unique_ptr<PdfChunk>> chunks;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    // Only record a few pages ahead of the writers, otherwise all the pictures would be in memory at once
+    QSemaphore pagesInFlight(2 * threadCount);
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        // Painting the pages reads the layout and updates the variables in headers and footers,
+        // so it happens here, into QPictures. Each chunk is written to PDF while it's painted.
+        const int firstPage = chunk * pagesPerChunk;
+        const int endPage = qMin(pageCount, firstPage + pagesPerChunk);
+        chunks.emplace_back(new PdfChunk(endPage - firstPage));
+        PdfChunk *pdfChunk = chunks.back().get();
+        pool.start(new PdfChunkWriter(pdfChunk, pageLayout, d->m_documentName, &pagesInFlight));
+        for (int pageIndex = firstPage; pageIndex < endPage; ++pageIndex) {
+            if (!d->reportPageProgress(pageIndex, pageCount)) {
+                pdfChunk->paintedPages.release(endPage - pageIndex); // the remaining pages stay null
+                pool.waitForDone();
+                return false; // canceled, see printAsync
+            }
+            pagesInFlight.acquire();
+            QPicture picture;
+            QPainter painter(&picture);
+            d->paintPage(pageIndex, painter);
+            painter.end();
+            pdfChunk->pages[pageIndex - firstPage] = picture;
+            pdfChunk->paintedPages.release();
+        }
+    }
+    pool.waitForDone();
+
+    QVector<QByteArray> documents;
+    for (const auto &chunk : chunks) {
+        if (chunk->result.isEmpty()) {
+            qWarning("exportToPdfParallel: QPainter failed to initialize on QPdfWriter");
+            return false;
+        }
+        documents.append(chunk->result);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "exportToPdfParallel: could not open" << fileName << file.errorString();
+        return false;
+    }
+    if (chunkCount == 1)
+        return file.write(documents.first()) == documents.first().size();
+    if (!mergePdfDocuments(documents, &file)) {
+        file.remove(); // incomplete
+        return false;
+    }
+    return true;
+}
+
 bool KDReports::Report::exportToImage(QSize size, const QString &fileName, const char *format)
 {
     // Get the document to fit into one page
@@ -767,6 +1428,110 @@ bool KDReports::Report::exportToImage(QSize size, const QString &fileName, const
     return image.save(fileName, format);
 }
 
+namespace {
+// Renders a horizontal strip of an image from a recorded page, and compresses it.
+// Runs in a thread pool: it doesn't touch the report.
+class TiffStripRenderer : public QRunnable
+{
+public:
+    TiffStripRenderer(const QByteArray &pictureData, qreal zoomFactor, const QRect &stripRect, QByteArray *result)
+        : m_pictureData(pictureData)
+        , m_zoomFactor(zoomFactor)
+        , m_stripRect(stripRect)
+        , m_result(result)
+    {
+    }
+
+    void run() override
+    {
+        // Playing a QPicture seeks in its data, so each strip uses its own copy
+        QPicture picture;
+        picture.setData(m_pictureData.constData(), uint(m_pictureData.size()));
+        QImage image(m_stripRect.size(), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter;
+        if (!painter.begin(&image)) {
+            m_result->clear();
+            return;
+        }
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.translate(-m_stripRect.topLeft());
+        painter.scale(m_zoomFactor, m_zoomFactor);
+        painter.drawPicture(0, 0, picture);
+        painter.end();
+        *m_result = KDReports::TiffWriter::compressStrip(image);
+    }
+
+private:
+    const QByteArray m_pictureData;
+    const qreal m_zoomFactor;
+    const QRect m_stripRect;
+    QByteArray *m_result;
+};
+}
+
+bool KDReports::Report::exportToTiff(QSize size, const QString &fileName, int threadCount)
+{
+    // Get the document to fit into one page, like exportToImage
+    const auto savePageSize = pageSize();
+    const qreal saveLayoutWidth = d->m_layoutWidth;
+    d->m_layoutWidth = d->m_layout->idealWidth() + mmToPixels(d->m_marginLeft + d->m_marginRight);
+    d->m_pageContentSizeDirty = true;
+    d->ensureLayouted();
+
+    const qreal zoomFactor = qMin(( qreal )size.width() / d->m_paperSize.width(), ( qreal )size.height() / d->m_paperSize.height());
+
+    QPicture picture;
+    QPainter picturePainter(&picture);
+    d->paintPage(0, picturePainter);
+    picturePainter.end();
+    const QByteArray pictureData(picture.data(), int(picture.size()));
+
+    // restore textdoc size and header widths
+    d->m_layoutWidth = saveLayoutWidth;
+    setPageSize(savePageSize); // redo layout
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "exportToTiff: could not open" << fileName << file.errorString();
+        return false;
+    }
+
+    // Each strip is at most 4 megapixels, whatever the size of the image
+    const int rowsPerStrip = qBound(1, 4 * 1024 * 1024 / qMax(1, size.width()), size.height());
+    const int stripCount = (size.height() + rowsPerStrip - 1) / rowsPerStrip;
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    // The layout is in pixels at qt_defaultDpi(), like in exportPagesToImages
+    TiffWriter writer(&file, size, rowsPerStrip, zoomFactor * qt_defaultDpi());
+    if (!writer.begin())
+        return false;
+
+    // One batch of strips at a time, so that at most threadCount strips are in memory
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    QVector<QByteArray> strips(threadCount);
+    for (int firstStrip = 0; firstStrip < stripCount; firstStrip += threadCount) {
+        const int batchSize = qMin(threadCount, stripCount - firstStrip);
+        for (int i = 0; i < batchSize; ++i) {
+            const int top = (firstStrip + i) * rowsPerStrip;
+            const QRect stripRect(0, top, size.width(), qMin(rowsPerStrip, size.height() - top));
+            pool.start(new TiffStripRenderer(pictureData, zoomFactor, stripRect, &strips[i]));
+        }
+        pool.waitForDone();
+        for (int i = 0; i < batchSize; ++i) {
+            if (strips.at(i).isEmpty()) {
+                qWarning() << "exportToTiff: QPainter failed to initialize on an image of width" << size.width();
+                return false;
+            }
+            if (!writer.writeStrip(strips.at(i)))
+                return false;
+        }
+    }
+    return writer.finish();
+}
+
 KDReports::Header &KDReports::Report::header(HeaderLocations hl)
 {
     if (!d->m_headers.contains(hl))
@@ -802,9 +1567,8 @@ qreal KDReports::Report::mmToPixels(qreal mm)
     return KDReports::mmToPixels(mm);
 }
 
-bool KDReports::Report::loadFromXML(QIODevice *iodevice, ErrorDetails *details)
+static bool readXmlDocument(QIODevice *iodevice, QDomDocument &doc, KDReports::ErrorDetails *details)
 {
-    QDomDocument doc;
     // Read document from the QIODevice, check for errors
 
     // We need to be able to see the space in <text> </text>, this is why
@@ -837,6 +1601,14 @@ bool KDReports::Report::loadFromXML(QIODevice *iodevice, ErrorDetails *details)
             qWarning("Malformed XML read in KDReports::Report::loadFromXML(): error message = %s, error line = %d, error column = %d", qPrintable(errorMsg), errorLine, errorColumn);
         return false;
     }
+    return true;
+}
+
+bool KDReports::Report::loadFromXML(QIODevice *iodevice, ErrorDetails *details)
+{
+    QDomDocument doc;
+    if (!readXmlDocument(iodevice, doc, details))
+        return false;
     return loadFromXML(doc, details);
 }
 
@@ -847,6 +1619,75 @@ bool KDReports::Report::loadFromXML(const QDomDocument &doc, ErrorDetails *detai
     return parser.processDocument(doc, d->builder());
 }
 
+bool KDReports::Report::loadFromXMLForEachRow(QIODevice *iodevice, const QAbstractItemModel *model, ErrorDetails *details)
+{
+    QDomDocument doc;
+    if (!readXmlDocument(iodevice, doc, details))
+        return false;
+    return loadFromXMLForEachRow(doc, model, details);
+}
+
+bool KDReports::Report::loadFromXMLForEachRow(const QDomDocument &doc, const QAbstractItemModel *model, ErrorDetails *details)
+{
+    if (d->m_reportMode != WordProcessing) {
+        qWarning("loadFromXMLForEachRow is only supported in WordProcessing mode");
+        return false;
+    }
+    if (!model) {
+        const QString message = QStringLiteral("loadFromXMLForEachRow: no model");
+        if (details)
+            details->setDriverMessage(message);
+        else
+            qWarning("%s", qPrintable(message));
+        return false;
+    }
+    const int rowCount = model->rowCount();
+    if (rowCount == 0)
+        return true;
+
+    // The decisions of <ifdef> and of the XmlElementHandler can depend on the row,
+    // so they can't be copied from the first row: parse and build the XML for each row.
+    if (d->m_xmlElementHandler || !doc.elementsByTagName(QStringLiteral("ifdef")).isEmpty()) {
+        for (int row = 0; row < rowCount; ++row) {
+            if (row > 0)
+                addPageBreak();
+            setCurrentRow(model, row);
+            if (!loadFromXML(doc, details))
+                return false;
+        }
+        return true;
+    }
+
+    ReportBuilder *builder = d->builder();
+    QTextCursor &cursor = builder->cursor();
+    const int startPosition = cursor.position();
+
+    // Build the report for the first row, as loadFromXML would
+    setCurrentRow(model, 0);
+    XmlParser parser(d->m_textValues, d->m_imageValues, d->m_xmlElementHandler, this, details);
+    parser.setRecordModelBindings(true);
+    d->m_pageContentSizeDirty = true;
+    if (!parser.processDocument(doc, builder))
+        return false;
+
+    // Then copy the result for the other rows, only replacing the text coming from the model
+    TextDocumentData &documentData = builder->contentDocumentData();
+    const TextDocumentData::DocumentTemplate documentTemplate = documentData.createTemplate(startPosition, cursor.position());
+    const QHash<QString, int> bindings = parser.modelBindings();
+    cursor.beginEditBlock();
+    for (int row = 1; row < rowCount; ++row) {
+        setCurrentRow(model, row);
+        builder->addPageBreakPublic();
+        QHash<QString, QString> values;
+        for (auto it = bindings.cbegin(); it != bindings.cend(); ++it) {
+            values.insert(it.key(), model->data(model->index(row, it.value())).toString());
+        }
+        documentData.appendTemplate(documentTemplate, cursor, values);
+    }
+    cursor.endEditBlock();
+    return true;
+}
+
 void KDReports::Report::associateModel(const QString &modelKey, QAbstractItemModel *model)
 {
     globalModelMap()->insert(modelKey, model);
@@ -870,11 +1711,25 @@ void KDReports::Report::endEdit()
 
 QString KDReports::Report::anchorAt(int pageNumber, QPoint pos) const
 {
+    QMutexLocker locker(&d->m_paintMutex);
+    d->ensureLayouted();
     const QRect textDocRect = d->mainTextDocRect();
     const QPoint textPos = pos - textDocRect.topLeft();
     return d->m_layout->anchorAt(pageNumber, textPos);
 }
 
+QList<QPair<QRect, QString>> KDReports::Report::anchors(int pageNumber) const
+{
+    QMutexLocker locker(&d->m_paintMutex);
+    d->ensureLayouted();
+    const QPoint textDocPos = d->mainTextDocRect().topLeft();
+    QList<QPair<QRect, QString>> result;
+    const auto anchors = d->m_layout->anchors(pageNumber);
+    for (const AbstractReportLayout::Anchor &anchor : anchors)
+        result.append(qMakePair(anchor.first.translated(textDocPos).toAlignedRect(), anchor.second));
+    return result;
+}
+
 QTextDocument *KDReports::Report::mainTextDocument() const
 {
     if (d->m_reportMode == WordProcessing) {
@@ -950,7 +1805,18 @@ KDReports::Report::WatermarkFunction KDReports::Report::watermarkFunction() cons
 
 void KDReports::Report::addPageBreak()
 {
+    if (d->m_streamingPainter && d->builder()->isEmpty()) {
+        // Nothing since the previous page break, which was printed already: don't print an empty page.
+        // Without streaming, consecutive page breaks don't create empty pages either.
+        return;
+    }
     d->builder()->addPageBreakPublic();
+    if (d->m_streamingPainter) {
+        // Everything before the page break can't reflow anymore.
+        // The last page is the empty one after the page break.
+        d->ensureLayouted();
+        d->printStreamedPages(d->m_layout->numberOfPages() - 1);
+    }
 }
 
 void KDReports::Report::associateTextValue(const QString &id, const QString &value)
@@ -961,6 +1827,16 @@ void KDReports::Report::associateTextValue(const QString &id, const QString &val
     d->m_textValues.insert(id, value); // in case the document isn't built yet
 }
 
+void KDReports::Report::associateTextValues(const QHash<QString, QString> &values)
+{
+    d->m_layout->updateTextValues(values); // in case the document is built already
+    d->m_headers.updateTextValues(values);
+    d->m_footers.updateTextValues(values);
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        d->m_textValues.insert(it.key(), it.value()); // in case the document isn't built yet
+    }
+}
+
 void KDReports::Report::associateImageValue(const QString &id, const QPixmap &value)
 {
     d->m_imageValues.insert(id, value.toImage());
@@ -1123,10 +1999,12 @@ void KDReports::Report::setReportMode(ReportMode reportMode)
 {
     if (d->m_reportMode != reportMode) {
         d->m_reportMode = reportMode;
+        d->m_pageCache.clear();
         delete d->m_layout;
         switch (reportMode) {
         case WordProcessing:
             d->m_layout = new TextDocReportLayout(this);
+            d->clearPageCacheOnChanges(*mainTextDocument());
             break;
         case SpreadSheet:
             auto *sslayout = new SpreadsheetReportLayout(this);
@@ -16,8 +16,12 @@
 
 #include <QColor>
 #include <QFont>
+#include <QFuture>
+#include <QHash>
 #include <QObject>
+#include <QPair>
 #include <QPrinter>
+#include <QRect>
 #include <QSizeF>
 #include <QTextOption>
 
@@ -449,6 +453,17 @@ public:
      */
     void associateTextValue(const QString &id, const QString &value);
 
+    /**
+     * Associate many text strings with ids at once, see associateTextValue.
+     *
+     * This is much faster than calling associateTextValue for each id
+     * when the report has been built already, since all the values are replaced
+     * in a single pass over the document.
+     *
+     * \since 2.4
+     */
+    void associateTextValues(const QHash<QString, QString> &values);
+
     /**
      * Associate a pixmap with the id of an image element.
      *
@@ -501,6 +516,35 @@ public:
      */
     bool loadFromXML(const QDomDocument &doc, ErrorDetails *details = nullptr);
 
+    /**
+     * Loads a report definition from an XML document, once for each row of \a model,
+     * starting each row on a new page (mail merge).
+     *
+     * This gives the same result as calling setCurrentRow(), loadFromXML() and addPageBreak()
+     * for each row, but it is much faster for large models: the XML is only parsed and built
+     * for the first row, and the resulting document is then copied for the other rows,
+     * replacing only the text elements bound to the current row of \a model
+     * (model="..." column="..." in the XML).
+     *
+     * Everything else is evaluated only once, for the first row: headers and footers, and auto-tables,
+     * which are not regenerated in the copies when changing table settings later on.
+     * If the XML contains ifdef elements, or if an XmlElementHandler is set, the XML is parsed
+     * and built for each row instead, since the result can differ from row to row.
+     *
+     * Only available in WordProcessing mode.
+     * \return true if the XML document was successfully loaded, false otherwise,
+     * for instance if \a model is null
+     * \since 2.4
+     */
+    bool loadFromXMLForEachRow(QIODevice *iodevice, const QAbstractItemModel *model, ErrorDetails *details = nullptr);
+
+    /**
+     * This is an overloaded member function, provided for convenience.
+     * See loadFromXML(const QDomDocument &, ErrorDetails *) about whitespace-only nodes.
+     * \since 2.4
+     */
+    bool loadFromXMLForEachRow(const QDomDocument &doc, const QAbstractItemModel *model, ErrorDetails *details = nullptr);
+
     /**
      * Sets an xml element handler.
      * The report does not take ownership of the xml element handler.
@@ -577,6 +621,96 @@ public:
      */
     bool exportToFile(const QString &fileName, QWidget *parent = nullptr);
 
+    /**
+     * Export the whole report to PDF, writing it to \p device, which must be open for writing.
+     *
+     * Unlike exportToFile(), this uses QPdfWriter directly rather than a QPrinter, so the PDF
+     * is generated without any printer setup, using the page size of the current layout.
+     * The pages are painted in a single PDF document, so each font is embedded once (as a subset)
+     * and an image painted on several pages, like a watermark or a logo in a header, is stored once.
+     * No progress dialog is shown, but the printingProgress signal is emitted.
+     *
+     * \return false if painting failed, for instance if \p device isn't writable
+     * \since 2.4
+     */
+    bool exportToPdf(QIODevice *device);
+
+    /**
+     * Enables incremental export: each page painted by exportToPdf(QIODevice*) is recorded
+     * along with a hash of its contents (text, formats, headers, footers, watermark and page size),
+     * and the next export only re-renders the pages whose contents changed, replaying the others.
+     * This speeds up exporting the same report repeatedly after small changes, e.g. after
+     * associateTextValue() for a value shown on a single page.
+     *
+     * The recorded pages use memory, call setIncrementalExportEnabled(false) to free it.
+     * Pages painted by a watermark function, and all pages in Spreadsheet mode,
+     * are considered changed on every export.
+     * \since 2.4
+     */
+    void setIncrementalExportEnabled(bool enable);
+    /**
+     * \return true if incremental export was enabled
+     * \since 2.4
+     */
+    bool isIncrementalExportEnabled() const;
+    /**
+     * \return the indexes (0-based) of the pages which will be re-rendered by the next
+     * incremental export, i.e. the pages whose contents changed since the previous one.
+     * All pages are returned before the first incremental export.
+     * Like painting, this sets the variables of the headers and footers for each page.
+     * \since 2.4
+     */
+    QList<int> changedPages();
+
+    /**
+     * Export the whole report to a PDF file, using several threads.
+     *
+     * The pages are split into one range per thread, each range is written to a separate
+     * PDF document concurrently, and the documents are then merged into \p fileName.
+     * This is faster than exportToFile() for reports with many pages, on machines with several cores.
+     * Fonts and images are embedded once per range rather than once per file, so the file can be larger.
+     * No progress dialog is shown, but the printingProgress signal is emitted.
+     *
+     * \param fileName the name of the PDF file
+     * \param threadCount the number of threads to use, or 0 for QThread::idealThreadCount()
+     * \since 2.4
+     */
+    bool exportToPdfParallel(const QString &fileName, int threadCount = 0);
+
+    /**
+     * \short Starts printing the report while it is being built (streaming mode).
+     *
+     * For very long reports, this allows to print the first pages before the whole report is built,
+     * and keeps the memory usage proportional to the size of a page rather than the size of the report.
+     *
+     * After this call, each call to addPageBreak() prints the pages before the page break
+     * to \p printer, and removes their contents from the report, since they can't change anymore.
+     * As without streaming, a page break right after another one is ignored (see addPageBreak()).
+     * Call endStreaming() after adding the last element, to print the remaining pages.
+     * The printer is set up with the page size and orientation of the report, like in exportToFile().
+     *
+     * Limitations: the page count variable (PageCount) shows the number of pages printed so far,
+     * the LastPage header and footer are only used on the very last page, and the report
+     * can't be printed or previewed again afterwards, since its contents are gone.
+     * Only available in WordProcessing mode.
+     *
+     * \return false if the printer couldn't be used
+     * \since 2.4
+     */
+    bool beginStreaming(QPrinter *printer);
+
+    /**
+     * Prints the remaining pages and ends the print job started by beginStreaming().
+     * \since 2.4
+     */
+    bool endStreaming();
+
+    /**
+     * \return the number of pages printed so far in streaming mode
+     * \since 2.4
+     */
+    int numberOfStreamedPages() const;
+
     /**
      * Export the whole report to an image file.
      * \param size the size of the image in pixels
@@ -585,6 +719,41 @@ public:
      */
     bool exportToImage(QSize size, const QString &fileName, const char *format);
 
+    /**
+     * Export the whole report to a TIFF image file, like exportToImage(), but
+     * without ever allocating an image of the full size.
+     *
+     * The image is rendered in horizontal strips of a bounded size, concurrently,
+     * and each strip is compressed and written to the file as soon as it's ready.
+     * This allows exporting very large images, e.g. poster-size reports at high resolution,
+     * with a memory usage which depends on the width of the image and the number of threads only.
+     * The file can't be bigger than 4GB.
+     *
+     * \param size the size of the image in pixels
+     * \param fileName the name of the TIFF file
+     * \param threadCount the number of threads to use, or 0 for QThread::idealThreadCount()
+     * \since 2.4
+     */
+    bool exportToTiff(QSize size, const QString &fileName, int threadCount = 0);
+
+    /**
+     * Export the pages of the report to image files, one per page,
+     * using the current page size and layout (unlike exportToImage, which puts the whole report into one image).
+     *
+     * The files are named page-N.format, for instance page-01.png, with N starting at 1 and padded
+     * with zeros so that the files sort in page order. Existing files are overwritten.
+     * The pages are rasterized and encoded concurrently, using a pool of threads.
+     *
+     * \param directory the directory where to create the images, created if necessary
+     * \param dpi the resolution of the images, in dots per inch
+     * \param format the format of the images, for instance: BMP, JPG, PNG.
+     * \param fromPage the first page to export, starting at 0
+     * \param toPage the last page to export, or -1 for the last page of the report
+     * \return false if an image couldn't be saved
+     * \since 2.4
+     */
+    bool exportPagesToImages(const QString &directory, int dpi = 150, const char *format = "PNG", int fromPage = 0, int toPage = -1);
+
     /**
      * Export the whole report to HTML.
      * Note that HTML export does not include headers and footers, nor watermark.
@@ -594,6 +763,122 @@ public:
      */
     bool exportToHtml(const QString &fileName);
 
+    /**
+     * Export the whole report to HTML, writing it to \p device in chunks of UTF-8,
+     * so that large reports don't need the whole HTML in memory.
+     * The device must be open for writing.
+     *
+     * Unlike exportToHtml(const QString &) and toHtml(), which use QTextDocument::toHtml(),
+     * the HTML is written by walking the document, and only includes the main properties:
+     * tab positions, line heights, table cell padding and borders, and charts are not exported.
+     * Like exportToHtml(const QString &), images are saved into separate files,
+     * named after the image resources, in the current directory.
+     * \since 2.4
+     */
+    bool exportToHtml(QIODevice *device);
+
+    /**
+     * Export the whole report to Markdown (CommonMark, with GitHub-style tables),
+     * writing it to \p device in chunks of UTF-8. The device must be open for writing.
+     *
+     * Only the structure of the report is exported: paragraphs, lists, tables, links, images,
+     * bold, italic and strike-out text. Like exportToHtml(), headers, footers and watermark
+     * are not exported, and the images are referred to by name: call exportToHtml() or
+     * use the image resources of the document to save them.
+     * Only available in WordProcessing mode.
+     * \since 2.4
+     */
+    bool exportToMarkdown(QIODevice *device);
+
+    /**
+     * Export the whole report to OpenDocument Text, writing it to \p device in chunks.
+     * The device must be open for writing.
+     *
+     * The document is written as a single XML file (flat ODT, usually with the extension .fodt),
+     * with the images embedded, which word processors like LibreOffice can open directly.
+     * Like exportToHtml(), headers, footers and watermark are not exported.
+     * Only available in WordProcessing mode.
+     * \since 2.4
+     */
+    bool exportToOdt(QIODevice *device);
+
+    /**
+     * Export the data of the main table to CSV (RFC 4180), writing it to \p device in chunks of UTF-8.
+     * The device must be open for writing.
+     *
+     * The rows are read straight from the model, without any layouting or pagination.
+     * The cells contain the same text as in the printed table, and the headers
+     * are written if they are visible in the printed table.
+     * Only available in SpreadSheet mode, once the main table has a model (see mainTable()).
+     *
+     * \param separator the field separator, e.g. ';' for locales which use ',' as decimal separator
+     * \since 2.4
+     */
+    bool exportToCsv(QIODevice *device, QChar separator = QLatin1Char(','));
+
+    /**
+     * Export the data of the main table to an XML spreadsheet (the XML Spreadsheet 2003 format,
+     * which Excel and LibreOffice Calc can open), writing it to \p device in chunks.
+     * The device must be open for writing.
+     *
+     * Like exportToCsv(), the rows are read straight from the model, and the headers are written
+     * if they are visible. Numbers are written as numbers, and spans as merged cells.
+     * The name of the worksheet is the document name (see setDocumentName()).
+     * Only available in SpreadSheet mode, once the main table has a model (see mainTable()).
+     * \since 2.4
+     */
+    bool exportToSpreadsheetXml(QIODevice *device);
+
+    /**
+     * \short Asynchronous version of print().
+     *
+     * Layouting and painting happen in a thread of QThreadPool::globalInstance(), so the GUI stays responsive.
+     * The returned future reports the progress in pages (see QFutureWatcher), and can be canceled:
+     * the operation then stops before painting the next page. Unless it was canceled,
+     * the result of the future is the return value of print().
+     *
+     * The text documents of the report are layouted and modified (e.g. the header variables) in that thread,
+     * so until the operation is finished, the report must not be modified or used from the GUI thread,
+     * other than for painting pages, for instance by a PreviewWidget: pages are painted one at a time.
+     * If the paper size of the printer differs from the one of the report, the report is layouted
+     * for the printer first, and the preview waits to render pages until printing is done.
+     * The printer must stay valid until then, too. No progress dialog is shown.
+     * Asynchronous operations on the same report run one after the other; deleting the report
+     * cancels them and waits for them to finish.
+     * \since 2.4
+     */
+    QFuture<bool> printAsync(QPrinter *printer);
+
+    /**
+     * Asynchronous version of exportToFile(), see printAsync().
+     * \since 2.4
+     */
+    QFuture<bool> exportToFileAsync(const QString &fileName);
+
+    /**
+     * Asynchronous version of exportPagesToImages(), see printAsync().
+     * \since 2.4
+     */
+    QFuture<bool> exportPagesToImagesAsync(const QString &directory, int dpi = 150, const char *format = "PNG", int fromPage = 0, int toPage = -1);
+
+    /**
+     * Asynchronous version of exportToHtml(), see printAsync().
+     * The HTML export isn't split into pages, so it can't be canceled once it started,
+     * and painting the report waits until it's done.
+     * \since 2.4
+     */
+    QFuture<bool> exportToHtmlAsync(const QString &fileName);
+
+    /**
+     * Layouts the report in a thread of QThreadPool::globalInstance(), e.g. after changing
+     * the page size, so that numberOfPages() and paintPage() don't block the GUI afterwards.
+     * The report must not be modified, painted or queried until the future is finished,
+     * calls from other threads would wait for the layouting to be done.
+     * The result of the future is always true.
+     * \since 2.4
+     */
+    QFuture<bool> layoutAsync();
+
     /**
      * Returns the whole report converted to HTML.
      * Note that HTML export does not include headers and footers, nor watermark.
@@ -612,6 +897,24 @@ public:
      */
     void paintPage(int pageNumber, QPainter &painter);
 
+    /**
+     * Sets the maximum amount of memory, in kilobytes, used to keep the pages recorded
+     * for PreviewWidget, which paints each page once and replays the recording for the
+     * thumbnails, the preview at each zoom level, and printing the selected pages.
+     * All the recorded pages are dropped when the report is modified or layouted again, and a page
+     * is also painted again when anything else on it changes, e.g. a header variable (see
+     * setIncrementalExportEnabled()). The least recently used pages are dropped to stay within the limit.
+     * Pages painted by a watermark function, and all pages in Spreadsheet mode, aren't kept.
+     * The default is 16 MB; 0 disables the cache.
+     * \since 2.4
+     */
+    void setPageCacheSize(int kiloBytes);
+    /**
+     * \return the maximum amount of memory used to keep the pages recorded, in kilobytes
+     * \since 2.4
+     */
+    int pageCacheSize() const;
+
     /**
      * Sets the number of the first page, so that the variable PageNumber
      * starts at another value than 1. This is useful when splitting a
@@ -686,6 +989,10 @@ public:
      * Scaling also means that the font sizes can be reduced (similar to what setFontScalingFactor does)
      * so that the report fits into the number of pages specified by this method.
      *
+     * In WordProcessing mode, tables are never broken horizontally, so only numPagesVertically
+     * is used: the fonts of the whole document are scaled down so that it fits into that many pages.
+     * Call this after adding the contents of the report.
+     *
      * \param numPagesHorizontally number of pages in the horizontal direction,
      *         1 for no table breaking in the horizontal direction.
      * \param numPagesVertically number of pages in the vertical direction, 0 for no limit
@@ -891,6 +1198,17 @@ public:
      */
     QString anchorAt(int pageNumber, QPoint pos) const;
 
+    /**
+     * Returns the hyperlinks on page \p pageNumber, e.g. to highlight them over the page:
+     * for each one, its rectangle in pixels (in the same coordinates as for anchorAt())
+     * and its target. A hyperlink spanning several lines has one rectangle per line.
+     *
+     * The hyperlinks are indexed per page once after layouting, which also makes anchorAt() fast.
+     * Only hyperlinks in the main part of the report are found, in WordProcessing mode.
+     * \since 2.4
+     */
+    QList<QPair<QRect, QString>> anchors(int pageNumber) const;
+
     /**
      * Returns the QTextDocument that contains the main part of the report,
      * assuming reportMode() is WordProcessing.
@@ -907,7 +1225,8 @@ public:
 
 Q_SIGNALS:
     /**
-     * Emitted during printWithDialog(), print() or exportToFile()
+     * Emitted during printWithDialog(), print(), exportToFile(), exportToPdf(), exportToPdfParallel(),
+     * exportPagesToImages(), and their asynchronous versions (from the thread doing the work)
      * \param pageIndex the page number, starting at 0
      * For the page count, see numberOfPages().
      * \since 2.3
@@ -933,6 +1252,8 @@ private:
     friend class Header; // doc()
     friend class PreviewDialogPrivate; // setupPrinter
     friend class PreviewWidgetPrivate; // setupPrinter
+    friend class ThumbnailRenderer; // pagePicture()
+    friend class PageTileRenderer; // pagePicture()
     friend class ReportPrivate; // setupPrinter
     std::unique_ptr<ReportPrivate> d;
 };
@@ -34,7 +34,9 @@ void KDReports::ReportBuilder::addInlineElement(const Element &element)
     // So: char format change must be done inside a single html element, not across.
     // This is also true for charts and images, and variables, which all set things into the char format.
     const QTextCharFormat origCharFormat = cursor.charFormat();
+    const int startPosition = cursor.position();
     element.build(*this);
+    m_contentDocument.registerTabBlocks(startPosition, cursor.position());
     cursor.setCharFormat(origCharFormat);
     cursor.endEditBlock();
 }
@@ -64,7 +66,9 @@ void KDReports::ReportBuilder::addBlockElement(const Element &element, Qt::Align
 
     cursor.setBlockFormat(blockFormat);
 
+    const int startPosition = cursor.position();
     element.build(*this);
+    m_contentDocument.registerTabBlocks(startPosition, cursor.position());
 
     cursor.setCharFormat(charFormat); // restore, we don't want addElement(bold text) + addInline(normal text) to make the normal text bold
     cursor.endEditBlock();
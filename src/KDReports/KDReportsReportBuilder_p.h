@@ -43,7 +43,6 @@ public:
 
     QTextCursor &cursor()
     {
-        m_contentDocument.aboutToModifyContents(TextDocumentData::Append);
         return m_cursor;
     }
     Report *report()
@@ -104,6 +103,16 @@ public:
     void setParagraphMargins(qreal left, qreal top, qreal right, qreal bottom); // in mm
     void copyStateFrom(const ReportBuilder &parentBuilder);
     int currentPosition();
+    /// Called after all the contents of the document have been removed, the next block element goes into the first block again
+    void contentsCleared()
+    {
+        m_first = true;
+    }
+    /// True if nothing was added since the construction or contentsCleared()
+    bool isEmpty() const
+    {
+        return m_first && m_contentDocument.document().isEmpty();
+    }
 
     static QTextCharFormat::VerticalAlignment toVerticalAlignment(Qt::Alignment alignment);
 
@@ -22,12 +22,18 @@
 // We mean it.
 //
 
+#include "KDReportsAbstractReportLayout_p.h"
 #include "KDReportsHeader.h"
 #include "KDReportsReport.h"
 #include "KDReportsReportBuilder_p.h"
 #include "KDReportsTextDocument_p.h"
+#include <QCache>
+#include <QFutureInterface>
 #include <QHash>
 #include <QMap>
+#include <QMutex>
+#include <QPicture>
+#include <memory>
 
 namespace KDReports {
 class XmlElementHandler;
@@ -70,6 +76,13 @@ public:
         }
     }
 
+    void updateTextValues(const QHash<QString, QString> &values)
+    {
+        for (const_iterator it = constBegin(); it != constEnd(); ++it) {
+            it.value()->doc().updateTextValues(values);
+        }
+    }
+
     qreal height() const
     {
         qreal maxHeight = 0;
@@ -91,10 +104,46 @@ public:
     ~ReportPrivate();
 
     void setPaperSizeFromPrinter(QSizeF paperSize);
+    /// Sets m_pageSize and m_orientation, and marks the layout dirty unless the paper size stays the same
+    void setPageGeometry(const QPageSize &pageSize, QPageLayout::Orientation orientation);
+    // What the layout depends on, saved before laying out for a printer and restored afterwards
+    struct PageGeometry
+    {
+        QPageSize pageSize;
+        QPageLayout::Orientation orientation;
+        QSizeF paperSize;
+    };
+    PageGeometry pageGeometry() const;
+    /// Restores the geometry after layouting for a printer, the report has to be layouted again
+    void restorePageGeometry(const PageGeometry &geometry);
+    /// Like Report::setWidthForEndlessPrinter, but only marks the layout dirty, for layoutAsync (see PreviewWidget)
+    void setWidthForEndlessPrinter(qreal widthMM);
     void ensureLayouted();
     QSizeF paperSize() const;
+    void prepareHeadersForPage(int pageNumber, Header **header, Header **footer);
     void paintPage(int pageNumber, QPainter &painter);
+    /// A hash of everything painted on the page, or an empty QByteArray if unknown (see Report::setIncrementalExportEnabled)
+    QByteArray pageContentHash(int pageNumber);
+    /// Paints the page recorded by the previous incremental export, unless its contents changed since then
+    void paintPageIncrementally(int pageNumber, QPainter &painter);
+    /// Returns the page recorded into a QPicture, from m_pageCache unless its contents changed
+    QPicture pagePicture(int pageNumber);
+    /// Drops the recorded pages when the main text document changes
+    void clearPageCacheOnChanges(QTextDocument &document);
+    /// The text of the report and the page of each line, for searching it off the GUI thread
+    PageTextIndex pageTextIndex();
+    /// The rects of the text from \p position to \p position + \p length which are on the page, in page coordinates
+    QVector<QRect> textRects(int pageNumber, int position, int length);
     bool doPrint(QPrinter *printer, QWidget *parent);
+    void printStreamedPages(int pageCount); // see Report::beginStreaming
+    /// Runs \p job in a thread of the global thread pool, see Report::printAsync
+    QFuture<bool> runAsync(const std::function<bool()> &job);
+    /// Called by the printing and export loops for each page: emits printingProgress, and reports
+    /// the progress of the asynchronous operation running in the current thread, if any.
+    /// \return false if that operation was canceled
+    bool reportPageProgress(int pageIndex, int pageCount);
+    /// The page layout for QPdfWriter, matching the current layout, used with a resolution of qt_defaultDpi
+    QPageLayout pdfPageLayout() const;
     QSizeF layoutAsOnePage(qreal docWidth);
     bool wantEndlessPrinting() const;
     bool hasNonLayoutedTextDocument() const;
@@ -138,6 +187,38 @@ public:
     bool m_pageContentSizeDirty;
     bool m_progressDialogEnabled = true;
 
+    // Streaming mode, see Report::beginStreaming
+    QPrinter *m_streamingPrinter = nullptr;
+    std::unique_ptr<QPainter> m_streamingPainter;
+    int m_streamedPageCount = 0; // pages already printed, and removed from the document
+    bool m_lastPageKnown = true; // false while streaming, until endStreaming
+
+    // Asynchronous operations, see Report::printAsync.
+    // Layouting and painting are serialized one page at a time, so that the preview can
+    // paint pages while an export is running in another thread.
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QRecursiveMutex m_paintMutex;
+#else
+    QMutex m_paintMutex { QMutex::Recursive };
+#endif
+    QMutex m_asyncJobMutex; // one asynchronous operation at a time
+    QVector<QFuture<bool>> m_asyncJobs; // canceled and waited for by the destructor
+    QMutex m_printLayoutMutex; // held by print() while the report is layouted for the printer, see pagePicture
+
+    // A page painted into a QPicture, along with pageContentHash() at the time
+    struct RecordedPage
+    {
+        QByteArray contentHash;
+        QPicture picture;
+    };
+
+    // Incremental export, see Report::setIncrementalExportEnabled
+    bool m_incrementalExport = false;
+    QVector<RecordedPage> m_exportedPages;
+
+    // Pages recorded for the preview, see Report::setPageCacheSize. Cost in KB.
+    QCache<int, RecordedPage> m_pageCache;
+
     // int m_numHorizontalPages; // for scaleTo(). 1 if not set.
     // int m_numVerticalPages;   // for scaleTo(). 0 if not set.
     // qreal m_scaleFontsBy;     // for scaleFontsBy(), 1.0 otherwise.
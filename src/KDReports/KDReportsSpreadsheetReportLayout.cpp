@@ -12,10 +12,12 @@
 #include "KDReportsLayoutHelper_p.h"
 #include "KDReportsSpreadsheetReportLayout_p.h"
 #include "KDReportsTableBreakingLogic_p.h"
+#include "KDReportsTableDataWriter_p.h"
 #include <QAbstractItemModel>
 
 #include <QBitArray>
 #include <QDebug>
+#include <QIODevice>
 #include <QIcon>
 #include <QPainter>
 #include <qmath.h> // qCeil
@@ -531,6 +533,12 @@ void KDReports::SpreadsheetReportLayout::updateTextValue(const QString &id, cons
     Q_UNUSED(newValue);
 }
 
+void KDReports::SpreadsheetReportLayout::updateTextValues(const QHash<QString, QString> &values)
+{
+    // Not implemented, see updateTextValue.
+    Q_UNUSED(values);
+}
+
 qreal KDReports::SpreadsheetReportLayout::layoutAsOnePage(qreal width)
 {
     m_tableLayout.setInitialFontScalingFactor(m_userRequestedFontScalingFactor);
@@ -546,7 +554,7 @@ qreal KDReports::SpreadsheetReportLayout::layoutAsOnePage(qreal width)
     return pageContentHeight;
 }
 
-QString KDReports::SpreadsheetReportLayout::toStandaloneHtml()
+QString KDReports::SpreadsheetReportLayout::toStandaloneHtml() const
 {
     return QStringLiteral("Not implemented");
 }
@@ -556,10 +564,47 @@ QString KDReports::SpreadsheetReportLayout::asHtml() const
     return QStringLiteral("Not implemented");
 }
 
+bool KDReports::SpreadsheetReportLayout::writeHtml(QIODevice *device) const
+{
+    return device->write(asHtml().toUtf8()) >= 0;
+}
+
+bool KDReports::SpreadsheetReportLayout::writeMarkdown(QIODevice *) const
+{
+    qWarning("Markdown export is not supported in Spreadsheet mode");
+    return false;
+}
+
+bool KDReports::SpreadsheetReportLayout::writeOdt(QIODevice *) const
+{
+    qWarning("ODT export is not supported in Spreadsheet mode");
+    return false;
+}
+
 void KDReports::SpreadsheetReportLayout::finishHtmlExport()
 {
 }
 
+bool KDReports::SpreadsheetReportLayout::writeCsv(QIODevice *device, QChar separator) const
+{
+    if (!m_tableLayout.m_model) {
+        qWarning("exportToCsv: the main table has no model, see Report::mainTable()");
+        return false;
+    }
+    TableDataWriter writer(m_tableLayout.m_model, m_tableLayout.m_horizontalHeaderVisible, m_tableLayout.m_verticalHeaderVisible);
+    return writer.writeCsv(device, separator);
+}
+
+bool KDReports::SpreadsheetReportLayout::writeSpreadsheetXml(QIODevice *device, const QString &sheetName) const
+{
+    if (!m_tableLayout.m_model) {
+        qWarning("exportToSpreadsheetXml: the main table has no model, see Report::mainTable()");
+        return false;
+    }
+    TableDataWriter writer(m_tableLayout.m_model, m_tableLayout.m_horizontalHeaderVisible, m_tableLayout.m_verticalHeaderVisible);
+    return writer.writeSpreadsheetXml(device, sheetName);
+}
+
 //@cond PRIVATE
 bool KDReports::SpreadsheetReportLayout::scaleTo(int numPagesHorizontally, int numPagesVertically)
 {
@@ -606,6 +651,35 @@ QString KDReports::SpreadsheetReportLayout::anchorAt(int pageNumber, QPoint pos)
     return {};
 }
 
+QVector<KDReports::AbstractReportLayout::Anchor> KDReports::SpreadsheetReportLayout::anchors(int pageNumber)
+{
+    // Not implemented
+    Q_UNUSED(pageNumber)
+    return {};
+}
+
+KDReports::PageTextIndex KDReports::SpreadsheetReportLayout::pageTextIndex()
+{
+    // Not implemented, nothing is found when searching
+    return {};
+}
+
+QVector<QRectF> KDReports::SpreadsheetReportLayout::textRects(int pageNumber, int position, int length)
+{
+    // Not implemented
+    Q_UNUSED(pageNumber)
+    Q_UNUSED(position)
+    Q_UNUSED(length)
+    return {};
+}
+
+QByteArray KDReports::SpreadsheetReportLayout::pageContentHash(int pageNumber)
+{
+    // Not implemented, the pages are always painted again
+    Q_UNUSED(pageNumber)
+    return {};
+}
+
 void KDReports::SpreadsheetReportLayout::setTableBreakingPageOrder(KDReports::Report::TableBreakingPageOrder order)
 {
     m_tableBreakingPageOrder = order;
@@ -44,6 +44,8 @@ public:
     /// \reimp
     void updateTextValue(const QString &id, const QString &newValue) override;
     /// \reimp
+    void updateTextValues(const QHash<QString, QString> &values) override;
+    /// \reimp
     qreal layoutAsOnePage(qreal width) override;
     /// \reimp
     bool scaleTo(int numPagesHorizontally, int numPagesVertically) override;
@@ -60,12 +62,30 @@ public:
     /// \reimp
     QString anchorAt(int pageNumber, QPoint pos) override;
     /// \reimp
-    QString toStandaloneHtml() override;
+    QVector<Anchor> anchors(int pageNumber) override;
+    /// \reimp
+    PageTextIndex pageTextIndex() override;
+    /// \reimp
+    QVector<QRectF> textRects(int pageNumber, int position, int length) override;
+    /// \reimp
+    QByteArray pageContentHash(int pageNumber) override;
+    /// \reimp
+    QString toStandaloneHtml() const override;
     /// \reimp
     QString asHtml() const override;
     /// \reimp
+    bool writeHtml(QIODevice *device) const override;
+    /// \reimp
+    bool writeMarkdown(QIODevice *device) const override;
+    /// \reimp
+    bool writeOdt(QIODevice *device) const override;
+    /// \reimp
     void finishHtmlExport() override;
 
+    /// The data of the table, without layouting it (see TableDataWriter)
+    bool writeCsv(QIODevice *device, QChar separator) const;
+    bool writeSpreadsheetXml(QIODevice *device, const QString &sheetName) const;
+
     void setModel(QAbstractItemModel *model);
     void setVerticalHeaderVisible(bool visible);
     void setHorizontalHeaderVisible(bool visible);
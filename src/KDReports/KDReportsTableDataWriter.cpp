@@ -0,0 +1,168 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsTableDataWriter_p.h"
+
+#include <QAbstractItemModel>
+#include <QRegularExpression>
+#include <QVector>
+
+static bool isNumber(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+    case QMetaType::Float:
+        return true;
+    default:
+        return false;
+    }
+}
+
+KDReports::TableDataWriter::TableDataWriter(QAbstractItemModel *model, bool horizontalHeaderVisible, bool verticalHeaderVisible)
+    : m_model(model)
+    , m_horizontalHeaderVisible(horizontalHeaderVisible)
+    , m_verticalHeaderVisible(verticalHeaderVisible)
+{
+}
+
+template<typename Function>
+void KDReports::TableDataWriter::forEachRow(Function writeRow)
+{
+    for (int row = 0; m_output.isOk(); ++row) {
+        if (row >= m_model->rowCount()) {
+            if (!m_model->canFetchMore(QModelIndex()))
+                break;
+            m_model->fetchMore(QModelIndex());
+            if (row >= m_model->rowCount())
+                break;
+        }
+        writeRow(row);
+    }
+}
+
+bool KDReports::TableDataWriter::writeCsv(QIODevice *device, QChar separator)
+{
+    m_output.begin(device);
+    const int columns = m_model->columnCount();
+    if (m_horizontalHeaderVisible) {
+        if (m_verticalHeaderVisible)
+            write(separator);
+        for (int column = 0; column < columns; ++column) {
+            if (column > 0)
+                write(separator);
+            write(csvField(m_model->headerData(column, Qt::Horizontal).toString(), separator));
+        }
+        write("\r\n");
+    }
+    forEachRow([&](int row) {
+        if (m_verticalHeaderVisible) {
+            write(csvField(m_model->headerData(row, Qt::Vertical).toString(), separator));
+            write(separator);
+        }
+        // CSV has no spans: each cell of the model is a field
+        for (int column = 0; column < columns; ++column) {
+            if (column > 0)
+                write(separator);
+            write(csvField(m_model->data(m_model->index(row, column), Qt::DisplayRole).toString(), separator));
+        }
+        write("\r\n");
+    });
+    return m_output.end();
+}
+
+QString KDReports::TableDataWriter::csvField(const QString &text, QChar separator) const
+{
+    if (!text.contains(separator) && !text.contains(QLatin1Char('"')) && !text.contains(QLatin1Char('\n')) && !text.contains(QLatin1Char('\r')))
+        return text;
+    QString quoted = text;
+    quoted.replace(QLatin1Char('"'), QStringLiteral("\"\""));
+    return QLatin1Char('"') + quoted + QLatin1Char('"');
+}
+
+bool KDReports::TableDataWriter::writeSpreadsheetXml(QIODevice *device, const QString &sheetName)
+{
+    // Worksheet names are limited to 31 characters, some of which are forbidden
+    QString name = sheetName;
+    name.remove(QRegularExpression(QStringLiteral("[\\[\\]:*?/\\\\]")));
+    name.truncate(31);
+    if (name.isEmpty())
+        name = QStringLiteral("Sheet1");
+
+    m_output.begin(device);
+    write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<?mso-application progid=\"Excel.Sheet\"?>\n"
+          "<Workbook xmlns=\"urn:schemas-microsoft-com:office:spreadsheet\" xmlns:ss=\"urn:schemas-microsoft-com:office:spreadsheet\">\n"
+          "<Styles><Style ss:ID=\"Header\"><Font ss:Bold=\"1\"/></Style></Styles>\n");
+    write(QStringLiteral("<Worksheet ss:Name=\"") + name.toHtmlEscaped() + QStringLiteral("\">\n<Table>\n"));
+
+    const int columns = m_model->columnCount();
+    const int firstColumn = m_verticalHeaderVisible ? 1 : 0;
+    if (m_horizontalHeaderVisible) {
+        write("<Row>\n");
+        for (int column = 0; column < columns; ++column) {
+            // ss:Index is 1-based, and only needed after a gap: here, above the vertical header
+            const int index = column == 0 && m_verticalHeaderVisible ? 2 : 0;
+            writeXmlCell(m_model->headerData(column, Qt::Horizontal), "Header", index, 0, 0);
+        }
+        write("</Row>\n");
+    }
+
+    // For each column, the last row covered by a cell spanning several rows
+    QVector<int> coveredUntilRow(columns, -1);
+    forEachRow([&](int row) {
+        write("<Row>\n");
+        if (m_verticalHeaderVisible)
+            writeXmlCell(m_model->headerData(row, Qt::Vertical), "Header", 0, 0, 0);
+        bool afterGap = false; // after cells covered by a span
+        for (int column = 0; column < columns; ++column) {
+            if (coveredUntilRow.at(column) >= row) {
+                afterGap = true;
+                continue;
+            }
+            const QModelIndex index = m_model->index(row, column);
+            const QSize span = m_model->span(index);
+            const int mergeAcross = qBound(0, span.width() - 1, columns - column - 1);
+            const int mergeDown = qMax(0, span.height() - 1);
+            writeXmlCell(m_model->data(index, Qt::DisplayRole), nullptr, afterGap ? firstColumn + column + 1 : 0, mergeAcross, mergeDown);
+            afterGap = mergeAcross > 0;
+            for (int c = column; c <= column + mergeAcross; ++c)
+                coveredUntilRow[c] = row + mergeDown;
+        }
+        write("</Row>\n");
+    });
+
+    write("</Table>\n</Worksheet>\n</Workbook>\n");
+    return m_output.end();
+}
+
+void KDReports::TableDataWriter::writeXmlCell(const QVariant &value, const char *styleId, int index, int mergeAcross, int mergeDown)
+{
+    QString cell = QStringLiteral("<Cell");
+    if (index > 0)
+        cell += QStringLiteral(" ss:Index=\"") + QString::number(index) + QLatin1Char('"');
+    if (styleId)
+        cell += QStringLiteral(" ss:StyleID=\"") + QString::fromLatin1(styleId) + QLatin1Char('"');
+    if (mergeAcross > 0)
+        cell += QStringLiteral(" ss:MergeAcross=\"") + QString::number(mergeAcross) + QLatin1Char('"');
+    if (mergeDown > 0)
+        cell += QStringLiteral(" ss:MergeDown=\"") + QString::number(mergeDown) + QLatin1Char('"');
+    const QString text = value.toString();
+    if (text.isEmpty()) {
+        cell += QStringLiteral("/>\n");
+    } else {
+        cell += QStringLiteral("><Data ss:Type=\"") + (isNumber(value) ? QStringLiteral("Number") : QStringLiteral("String")) + QStringLiteral("\">")
+            + text.toHtmlEscaped() + QStringLiteral("</Data></Cell>\n");
+    }
+    write(cell);
+}
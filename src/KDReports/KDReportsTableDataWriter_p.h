@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSTABLEDATAWRITER_P_H
+#define KDREPORTSTABLEDATAWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsChunkedWriter_p.h"
+
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QAbstractItemModel;
+class QIODevice;
+class QVariant;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Writes the data of a table model as CSV or as an XML spreadsheet (SpreadsheetML 2003),
+ * straight from the model: no layout is needed.
+ *
+ * The cells contain the same text as in the printed table (the DisplayRole, converted to a string),
+ * and the headers are written if they are visible in the printed table.
+ * The rows are read from the model one at a time, fetching more from models which
+ * load their data lazily, and the output is written to the device in chunks.
+ */
+class TableDataWriter
+{
+public:
+    TableDataWriter(QAbstractItemModel *model, bool horizontalHeaderVisible, bool verticalHeaderVisible);
+
+    /// Writes RFC 4180 CSV, with CRLF line endings
+    bool writeCsv(QIODevice *device, QChar separator);
+    /// Writes a single worksheet named \p sheetName, which Excel and LibreOffice can open.
+    /// Numbers are written as numbers, so that they can be used in formulas.
+    bool writeSpreadsheetXml(QIODevice *device, const QString &sheetName);
+
+private:
+    /// Calls \p writeRow for each row of the model, fetching more rows when needed
+    template<typename Function>
+    void forEachRow(Function writeRow);
+    QString csvField(const QString &text, QChar separator) const;
+    void writeXmlCell(const QVariant &value, const char *styleId, int index, int mergeAcross, int mergeDown);
+    void write(const QString &text)
+    {
+        m_output.write(text);
+    }
+    void write(const char *text)
+    {
+        m_output.write(text);
+    }
+
+    QAbstractItemModel *m_model;
+    const bool m_horizontalHeaderVisible;
+    const bool m_verticalHeaderVisible;
+    ChunkedWriter m_output;
+};
+
+}
+
+#endif /* KDREPORTSTABLEDATAWRITER_P_H */
@@ -13,12 +13,72 @@
 #include <QDebug>
 #include <QPainter>
 #include <QTextBlock>
+#include <QTextLayout>
+#include <QTextTable>
+
+#include <algorithm>
+
+namespace {
+
+// Where the lines of the block's text layout are, in document coordinates
+QPointF textLayoutPos(const QTextDocument &doc, const QTextBlock &block)
+{
+    // blockBoundingRect includes the position of the frame or table cell
+    return doc.documentLayout()->blockBoundingRect(block).topLeft() - block.layout()->boundingRect().topLeft();
+}
+
+// The rect of the characters from start to end (relative to the block) which are on the line, or a null rect
+QRectF lineRect(const QTextLine &line, int start, int end, QPointF layoutPos)
+{
+    const int lineEnd = line.textStart() + line.textLength();
+    if (line.textStart() >= end || lineEnd <= start)
+        return {};
+    const qreal x1 = line.cursorToX(qMax(start, line.textStart()));
+    const qreal x2 = line.cursorToX(qMin(end, lineEnd));
+    return QRectF(qMin(x1, x2), line.y(), qAbs(x2 - x1), line.height()).translated(layoutPos);
+}
+
+// Lines aren't split across pages
+int pageOf(const QRectF &rect, qreal pageHeight)
+{
+    return pageHeight > 0 ? static_cast<int>(rect.top() / pageHeight) : 0;
+}
+
+// The outermost table containing the block, if any
+QTextTable *outermostTable(const QTextBlock &block)
+{
+    QTextTable *result = nullptr;
+    for (QTextFrame *frame = QTextCursor(block).currentFrame(); frame; frame = frame->parentFrame()) {
+        if (auto *table = qobject_cast<QTextTable *>(frame))
+            result = table;
+    }
+    return result;
+}
+
+}
 
 KDReports::TextDocReportLayout::TextDocReportLayout(KDReports::Report *report)
     : m_textDocument()
     , m_builder(m_textDocument.contentDocumentData(), QTextCursor(&m_textDocument.contentDocument()), report)
 
 {
+    // Text and format changes move the hyperlinks and lines around; page size changes are detected in ensurePageIndex.
+    // Direct, since the document is modified in the thread of an asynchronous operation too (Report::printAsync)
+    QObject::connect(
+        &m_textDocument.contentDocument(), &QTextDocument::contentsChanged, &m_textDocument.contentDocument(),
+        [this]() {
+            m_pageIndexDirty = true;
+            if (m_scalingFonts)
+                return;
+            // New contents aren't scaled yet, and they change how many pages the report needs
+            if (m_appliedFontScalingFactor != 1.0) {
+                m_appliedFontScalingFactor = 0; // some of the contents aren't scaled, see applyFontScalingFactor
+                m_fontScalingDirty = true;
+            }
+            if (m_numVerticalPages > 0)
+                m_fontScalingDirty = true;
+        },
+        Qt::DirectConnection);
 }
 
 void KDReports::TextDocReportLayout::setLayoutDirty()
@@ -42,6 +102,7 @@ void KDReports::TextDocReportLayout::paintPageContent(int pageNumber, QPainter &
 //@cond PRIVATE
 int KDReports::TextDocReportLayout::numberOfPages()
 {
+    ensureLayouted();
     // qDebug() << "page height" << m_textDocument.contentDocument().pageSize().height();
     // qDebug() << "doc height" << m_textDocument.contentDocument().size().height();
     return m_textDocument.contentDocument().pageCount();
@@ -51,13 +112,54 @@ int KDReports::TextDocReportLayout::numberOfPages()
 void KDReports::TextDocReportLayout::setPageContentSize(QSizeF size)
 {
     m_textDocument.setPageSize(size);
+    if (m_numVerticalPages > 0)
+        m_fontScalingDirty = true; // the scaling factor that fits depends on the page size
 }
 
 void KDReports::TextDocReportLayout::ensureLayouted()
 {
+    if (!m_fontScalingDirty)
+        return;
+    m_fontScalingDirty = false;
+
+    applyFontScalingFactor(m_userRequestedFontScalingFactor);
+    if (m_numVerticalPages <= 0)
+        return;
+
+    QTextDocument &doc = m_textDocument.contentDocument();
+    if (doc.pageCount() <= m_numVerticalPages)
+        return;
+
+    // The number of pages decreases monotonically (give or take line-breaking details)
+    // with the font size, so a binary search on the factor only needs O(log n) relayouts,
+    // rather than shrinking the fonts step by step.
+    // Unittest: PageLayout::testScaleNoTables()
+    static const qreal s_minimumFactor = 0.05;
+    static const qreal s_precision = 0.01;
+    qreal fits = s_minimumFactor * m_userRequestedFontScalingFactor;
+    qreal tooBig = m_userRequestedFontScalingFactor;
+    while (tooBig - fits > s_precision * m_userRequestedFontScalingFactor) {
+        const qreal factor = (fits + tooBig) / 2;
+        applyFontScalingFactor(factor);
+        if (doc.pageCount() <= m_numVerticalPages)
+            fits = factor;
+        else
+            tooBig = factor;
+    }
+    applyFontScalingFactor(fits);
 }
 
-QString KDReports::TextDocReportLayout::toStandaloneHtml()
+void KDReports::TextDocReportLayout::applyFontScalingFactor(qreal factor)
+{
+    if (qFuzzyCompare(factor, m_appliedFontScalingFactor))
+        return;
+    m_scalingFonts = true;
+    m_textDocument.setFontScalingFactor(factor);
+    m_scalingFonts = false;
+    m_appliedFontScalingFactor = factor;
+}
+
+QString KDReports::TextDocReportLayout::toStandaloneHtml() const
 {
     return m_textDocument.toStandaloneHtml();
 }
@@ -69,6 +171,10 @@ QString KDReports::TextDocReportLayout::asHtml() const
 
 qreal KDReports::TextDocReportLayout::layoutAsOnePage(qreal docWidth)
 {
+    // Fitting into a number of pages makes no sense for an endless printer
+    m_fontScalingDirty = false;
+    applyFontScalingFactor(m_userRequestedFontScalingFactor);
+
     m_textDocument.layoutWithTextWidth(docWidth);
     qreal docHeight = m_textDocument.contentDocument().size().height();
 
@@ -87,8 +193,9 @@ qreal KDReports::TextDocReportLayout::layoutAsOnePage(qreal docWidth)
         block = block.next();
     } while (block.isValid());
     c.endEditBlock();
+    m_fontScalingDirty = false; // not a contents change that needs scaling
 
-    setPageContentSize(QSizeF(docWidth, docHeight));
+    m_textDocument.setPageSize(QSizeF(docWidth, docHeight));
     qDebug() << "m_textDocument.layoutDocument().setPageSize" << docWidth << "x" << docHeight << numberOfPages() << "pages";
     qreal newDocHeight = m_textDocument.contentDocument().size().height();
     if (newDocHeight > docHeight) {
@@ -96,7 +203,7 @@ qreal KDReports::TextDocReportLayout::layoutAsOnePage(qreal docWidth)
         // but once we set that as the page size, we end up with more height...
         // Unittest: PageLayout::testEndlessPrinterBug()
         qDebug() << "newDocHeight=" << newDocHeight << "expected" << docHeight;
-        setPageContentSize(QSizeF(docWidth, newDocHeight));
+        m_textDocument.setPageSize(QSizeF(docWidth, newDocHeight));
         newDocHeight = m_textDocument.contentDocument().size().height();
         qDebug() << "final newDocHeight=" << newDocHeight << numberOfPages() << "pages";
     }
@@ -105,6 +212,21 @@ qreal KDReports::TextDocReportLayout::layoutAsOnePage(qreal docWidth)
     return newDocHeight;
 }
 
+bool KDReports::TextDocReportLayout::writeHtml(QIODevice *device) const
+{
+    return m_textDocument.writeHtml(device);
+}
+
+bool KDReports::TextDocReportLayout::writeMarkdown(QIODevice *device) const
+{
+    return m_textDocument.writeMarkdown(device);
+}
+
+bool KDReports::TextDocReportLayout::writeOdt(QIODevice *device) const
+{
+    return m_textDocument.writeOdt(device);
+}
+
 void KDReports::TextDocReportLayout::finishHtmlExport()
 {
     m_textDocument.contentDocumentData().saveResourcesToFiles();
@@ -114,6 +236,7 @@ void KDReports::TextDocReportLayout::setDefaultFont(const QFont &font)
 {
     m_textDocument.contentDocument().setDefaultFont(font);
     m_builder.setDefaultFont(font);
+    m_pageIndexDirty = true;
 }
 
 QFont KDReports::TextDocReportLayout::defaultFont() const
@@ -126,6 +249,11 @@ void KDReports::TextDocReportLayout::updateTextValue(const QString &id, const QS
     m_textDocument.updateTextValue(id, newValue);
 }
 
+void KDReports::TextDocReportLayout::updateTextValues(const QHash<QString, QString> &values)
+{
+    m_textDocument.updateTextValues(values);
+}
+
 //@cond PRIVATE
 qreal KDReports::TextDocReportLayout::idealWidth()
 {
@@ -135,10 +263,12 @@ qreal KDReports::TextDocReportLayout::idealWidth()
 
 bool KDReports::TextDocReportLayout::scaleTo(int numPagesHorizontally, int numPagesVertically)
 {
-    Q_UNUSED(numPagesHorizontally);
-    Q_UNUSED(numPagesVertically);
-    qWarning("scaleTo is only implemented in Spreadsheet mode currently");
-    return false;
+    if (numPagesHorizontally > 1)
+        qWarning("scaleTo: breaking tables horizontally is only implemented in Spreadsheet mode, only the number of vertical pages will be used");
+    m_numHorizontalPages = 1;
+    m_numVerticalPages = numPagesVertically;
+    m_fontScalingDirty = true;
+    return true;
 }
 
 void KDReports::TextDocReportLayout::setFixedRowHeight(qreal height)
@@ -149,28 +279,152 @@ void KDReports::TextDocReportLayout::setFixedRowHeight(qreal height)
 
 int KDReports::TextDocReportLayout::maximumNumberOfPagesForHorizontalScaling() const
 {
-    return 1;
+    return m_numHorizontalPages;
 }
 
 int KDReports::TextDocReportLayout::maximumNumberOfPagesForVerticalScaling() const
 {
-    return 1; // not implemented
+    return m_numVerticalPages;
 }
 //@endcond
 
 void KDReports::TextDocReportLayout::setUserRequestedFontScalingFactor(qreal factor)
 {
-    Q_UNUSED(factor);
-    qWarning("font scaling is only implemented in Spreadsheet mode currently");
+    m_userRequestedFontScalingFactor = factor;
+    m_numHorizontalPages = 1;
+    m_numVerticalPages = 0;
+    m_fontScalingDirty = true;
 }
 
 qreal KDReports::TextDocReportLayout::userRequestedFontScalingFactor() const
 {
-    return 1; // not implemented
+    return m_userRequestedFontScalingFactor;
 }
 
 QString KDReports::TextDocReportLayout::anchorAt(int pageNumber, QPoint pos)
 {
-    const QPointF posInPage = pos + QPointF(0, pageNumber * m_textDocument.contentDocument().pageSize().height());
-    return m_textDocument.contentDocument().documentLayout()->anchorAt(posInPage);
+    ensurePageIndex();
+    if (pageNumber < 0 || pageNumber >= m_anchorsByPage.size())
+        return {};
+    // Sorted by top, and no rect is higher than m_maxAnchorHeight: only the rects starting
+    // between pos.y() - m_maxAnchorHeight and pos.y() can contain pos
+    const QVector<Anchor> &anchors = m_anchorsByPage.at(pageNumber);
+    auto it = std::lower_bound(anchors.constBegin(), anchors.constEnd(), pos.y() - m_maxAnchorHeight,
+                               [](const Anchor &anchor, qreal top) { return anchor.first.top() < top; });
+    for (; it != anchors.constEnd() && it->first.top() <= pos.y(); ++it) {
+        if (it->first.contains(pos))
+            return it->second;
+    }
+    return {};
+}
+
+QVector<KDReports::AbstractReportLayout::Anchor> KDReports::TextDocReportLayout::anchors(int pageNumber)
+{
+    ensurePageIndex();
+    return m_anchorsByPage.value(pageNumber);
+}
+
+KDReports::PageTextIndex KDReports::TextDocReportLayout::pageTextIndex()
+{
+    ensurePageIndex();
+    return m_pageTextIndex;
+}
+
+QVector<QRectF> KDReports::TextDocReportLayout::textRects(int pageNumber, int position, int length)
+{
+    const QTextDocument &doc = m_textDocument.contentDocument();
+    const qreal pageHeight = doc.pageSize().height();
+    const int end = position + length;
+    QVector<QRectF> rects;
+    for (QTextBlock block = doc.findBlock(position); block.isValid() && block.position() < end; block = block.next()) {
+        const QTextLayout *textLayout = block.layout();
+        const QPointF layoutPos = textLayoutPos(doc, block);
+        for (int i = 0; i < textLayout->lineCount(); ++i) {
+            const QRectF rect = lineRect(textLayout->lineAt(i), position - block.position(), end - block.position(), layoutPos);
+            if (!rect.isNull() && pageOf(rect, pageHeight) == pageNumber)
+                rects.append(rect.translated(0, -pageNumber * pageHeight));
+        }
+    }
+    return rects;
+}
+
+void KDReports::TextDocReportLayout::ensurePageIndex()
+{
+    const QTextDocument &doc = m_textDocument.contentDocument();
+    if (!m_pageIndexDirty && m_pageIndexPageSize == doc.pageSize())
+        return;
+    m_pageIndexDirty = false;
+    m_pageIndexPageSize = doc.pageSize();
+    m_maxAnchorHeight = 0;
+    m_anchorsByPage.clear();
+    m_anchorsByPage.resize(doc.pageCount());
+    m_pageTextIndex = KDReports::PageTextIndex();
+    // toPlainText() keeps one character per document position (block and table separators included)
+    m_pageTextIndex.text = doc.toPlainText();
+    const qreal pageHeight = doc.pageSize().height();
+
+    // All blocks, including those in tables and frames
+    for (QTextBlock block = doc.begin(); block.isValid(); block = block.next()) {
+        const QTextLayout *textLayout = block.layout();
+        const QPointF layoutPos = textLayoutPos(doc, block);
+        for (int i = 0; i < textLayout->lineCount(); ++i) {
+            const QTextLine line = textLayout->lineAt(i);
+            m_pageTextIndex.lineStarts.append(block.position() + line.textStart());
+            m_pageTextIndex.linePages.append(pageOf(line.rect().translated(layoutPos), pageHeight));
+        }
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            const QTextFragment fragment = it.fragment();
+            const QTextCharFormat format = fragment.charFormat();
+            if (!format.isAnchor() || format.anchorHref().isEmpty())
+                continue;
+            const int start = fragment.position() - block.position();
+            const int end = start + fragment.length();
+            for (int i = 0; i < textLayout->lineCount(); ++i) {
+                QRectF rect = lineRect(textLayout->lineAt(i), start, end, layoutPos);
+                if (rect.isNull())
+                    continue;
+                const int page = pageOf(rect, pageHeight);
+                if (page < 0 || page >= m_anchorsByPage.size())
+                    continue;
+                rect.translate(0, -page * pageHeight);
+                m_anchorsByPage[page].append(Anchor(rect, format.anchorHref()));
+                m_maxAnchorHeight = qMax(m_maxAnchorHeight, rect.height());
+            }
+        }
+    }
+
+    // Blocks in tables come in cell order, which isn't always top to bottom
+    for (QVector<Anchor> &anchors : m_anchorsByPage) {
+        std::sort(anchors.begin(), anchors.end(), [](const Anchor &a, const Anchor &b) { return a.first.top() < b.first.top(); });
+    }
+}
+
+QByteArray KDReports::TextDocReportLayout::pageContentHash(int pageNumber)
+{
+    const QTextDocument &doc = m_textDocument.contentDocument();
+    const qreal pageHeight = doc.pageSize().height();
+    const qreal top = pageNumber * pageHeight;
+    const qreal bottom = top + pageHeight;
+    QAbstractTextDocumentLayout *layout = doc.documentLayout();
+    // The blocks which intersect with the page
+    QTextBlock block = doc.findBlock(layout->hitTest(QPointF(0, top), Qt::FuzzyHit));
+    while (block.isValid() && layout->blockBoundingRect(block).bottom() <= top)
+        block = block.next();
+    if (!block.isValid())
+        return QByteArray::number(pageNumber); // empty page
+    const QTextBlock pageFirstBlock = block;
+    QTextBlock lastBlock = block;
+    for (; block.isValid() && layout->blockBoundingRect(block).top() < bottom; block = block.next())
+        lastBlock = block;
+    // A table on the page is hashed as a whole: its header rows are repeated on each page,
+    // and a change in a row on another page can move the rows of this one
+    QTextBlock firstBlock = pageFirstBlock;
+    if (QTextTable *table = outermostTable(firstBlock))
+        firstBlock = doc.findBlock(table->firstPosition());
+    if (QTextTable *table = outermostTable(lastBlock))
+        lastBlock = doc.findBlock(table->lastPosition());
+    QByteArray hash = m_textDocument.contentDocumentData().contentHash(firstBlock.position(), lastBlock.position());
+    // Where the contents start on the page, in case something before them changed height
+    hash += QByteArray::number(layout->blockBoundingRect(pageFirstBlock).top() - top);
+    return hash;
 }
@@ -41,6 +41,8 @@ public:
     /// \reimp
     void updateTextValue(const QString &id, const QString &newValue) override;
     /// \reimp
+    void updateTextValues(const QHash<QString, QString> &values) override;
+    /// \reimp
     qreal layoutAsOnePage(qreal width) override;
     /// \reimp
     bool scaleTo(int numPagesHorizontally, int numPagesVertically) override;
@@ -57,10 +59,24 @@ public:
     /// \reimp
     QString anchorAt(int pageNumber, QPoint pos) override;
     /// \reimp
-    QString toStandaloneHtml() override;
+    QVector<Anchor> anchors(int pageNumber) override;
+    /// \reimp
+    PageTextIndex pageTextIndex() override;
+    /// \reimp
+    QVector<QRectF> textRects(int pageNumber, int position, int length) override;
+    /// \reimp
+    QByteArray pageContentHash(int pageNumber) override;
+    /// \reimp
+    QString toStandaloneHtml() const override;
     /// \reimp
     QString asHtml() const override;
     /// \reimp
+    bool writeHtml(QIODevice *device) const override;
+    /// \reimp
+    bool writeMarkdown(QIODevice *device) const override;
+    /// \reimp
+    bool writeOdt(QIODevice *device) const override;
+    /// \reimp
     void finishHtmlExport() override;
 
     TextDocument &textDocument()
@@ -74,8 +90,24 @@ public:
     }
 
 private:
+    void applyFontScalingFactor(qreal factor);
+    void ensurePageIndex();
+
     TextDocument m_textDocument;
     ReportBuilder m_builder;
+    int m_numHorizontalPages = 1;
+    int m_numVerticalPages = 0;
+    qreal m_userRequestedFontScalingFactor = 1.0;
+    qreal m_appliedFontScalingFactor = 1.0; // what the fonts in the document are currently scaled by, 0 if not all of them
+    bool m_fontScalingDirty = false;
+    bool m_scalingFonts = false; // the contents changes are applyFontScalingFactor's own
+
+    // The hyperlinks of each page and the page of each line, found once after layouting, for anchorAt() and searching
+    QVector<QVector<Anchor>> m_anchorsByPage;
+    PageTextIndex m_pageTextIndex;
+    QSizeF m_pageIndexPageSize; // the page size they were found for
+    qreal m_maxAnchorHeight = 0; // the height of the highest line with a hyperlink
+    bool m_pageIndexDirty = true;
 };
 
 }
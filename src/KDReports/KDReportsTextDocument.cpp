@@ -53,18 +53,43 @@ void KDReports::TextDocument::scaleFontsBy(qreal factor)
     m_contentDocument.scaleFontsBy(factor);
 }
 
+void KDReports::TextDocument::setFontScalingFactor(qreal factor)
+{
+    m_contentDocument.setFontScalingFactor(factor);
+}
+
 void KDReports::TextDocument::updateTextValue(const QString &id, const QString &newValue)
 {
     m_contentDocument.updateTextValue(id, newValue);
 }
 
+void KDReports::TextDocument::updateTextValues(const QHash<QString, QString> &values)
+{
+    m_contentDocument.updateTextValues(values);
+}
+
 //@cond PRIVATE
 QString KDReports::TextDocument::asHtml() const
 {
     return m_contentDocument.asHtml();
 }
 
-QString KDReports::TextDocument::toStandaloneHtml()
+bool KDReports::TextDocument::writeHtml(QIODevice *device) const
+{
+    return m_contentDocument.writeHtml(device);
+}
+
+bool KDReports::TextDocument::writeMarkdown(QIODevice *device) const
+{
+    return m_contentDocument.writeMarkdown(device);
+}
+
+bool KDReports::TextDocument::writeOdt(QIODevice *device) const
+{
+    return m_contentDocument.writeOdt(device);
+}
+
+QString KDReports::TextDocument::toStandaloneHtml() const
 {
     return m_contentDocument.toStandaloneHtml();
 }
@@ -11,21 +11,45 @@
 #include "KDReportsAutoTableElement.h"
 #include "KDReportsChartTextObject_p.h"
 #include "KDReportsHLineTextObject_p.h"
+#include "KDReportsHtmlWriter_p.h"
 #include "KDReportsLayoutHelper_p.h"
+#include "KDReportsMarkdownWriter_p.h"
+#include "KDReportsOdtWriter_p.h"
 #include "KDReportsReportBuilder_p.h"
 #include "KDReportsTextDocumentData_p.h"
+#ifdef HAVE_KDCHART
+#include <KDChartAbstractCoordinatePlane>
+#include <KDChartAbstractDiagram>
+#include <KDChartChart>
+#endif
 
 #include <QAbstractTextDocumentLayout>
 #include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QSet>
+#include <QTextBlock>
 #include <QTextTable>
 #include <QUrl>
+#include <algorithm>
 
 KDReports::TextDocumentData::TextDocumentData()
-    : m_usesTabPositions(false)
+    : m_updatingTextValueMarkers(false)
+    , m_usesTabPositions(false)
 {
     m_document.setUseDesignMetrics(true);
 
+    // Keep the text value markers in place when the text is modified from the outside,
+    // e.g. the header variables (Header::preparePaintingPage) or Report::mainTextDocument().
+    // Direct, since the document is modified in the thread of an asynchronous operation too (Report::printAsync)
+    m_contentsChangeConnection = QObject::connect(
+        &m_document, &QTextDocument::contentsChange, &m_document,
+        [this](int position, int charsRemoved, int charsAdded) {
+            adjustTextValueMarkers(position, charsRemoved, charsAdded);
+        },
+        Qt::DirectConnection);
+
     HLineTextObject::registerHLineObjectHandler(&m_document);
 #ifdef HAVE_KDCHART
     ChartTextObject::registerChartTextObjectHandler(&m_document);
@@ -34,143 +58,357 @@ KDReports::TextDocumentData::TextDocumentData()
 
 KDReports::TextDocumentData::~TextDocumentData()
 {
+    QObject::disconnect(m_contentsChangeConnection);
 }
 
-void KDReports::TextDocumentData::dumpTextValueCursors() const
+void KDReports::TextDocumentData::clear()
 {
-    qDebug() << "Text value cursors:  (document size=" << m_document.characterCount() << ")";
-    QMultiMap<QString, TextValueData>::const_iterator it = m_textValueCursors.begin();
-    while (it != m_textValueCursors.end()) {
-        const TextValueData &data = *it;
-        if (data.cursor.isNull()) {
-            qDebug() << it.key() << "unresolved cursor at pos" << data.initialPosition;
-        } else {
-            qDebug() << it.key() << "QTextCursor currently at pos" << data.cursor.position() << "length" << data.valueLength;
+    // Unlike removing the text, this also frees the image resources, the unused formats and the undo stack.
+    // The default font, page size and document layout are kept.
+    m_document.clear();
+
+    m_tables.clear();
+    m_autoTables.clear();
+    m_resizableImageCursors.clear();
+    m_tabBlockCursors.clear();
+    m_textValueMarkers.clear();
+    m_textValueIndex.clear();
+    m_resourceNames.clear();
+}
+
+void KDReports::TextDocumentData::dumpTextValueMarkers() const
+{
+    qDebug() << "Text value markers:  (document size=" << m_document.characterCount() << ")";
+    for (auto it = m_textValueIndex.cbegin(); it != m_textValueIndex.cend(); ++it) {
+        for (int index : it.value()) {
+            const TextValueMarker &marker = m_textValueMarkers.at(index);
+            qDebug() << it.key() << "at pos" << marker.position << "length" << marker.valueLength;
         }
-        ++it;
     }
 }
 
-void KDReports::TextDocumentData::aboutToModifyContents(ModificationMode mode)
+void KDReports::TextDocumentData::setTextValueMarker(int pos, const QString &id, int valueLength, bool html, const QTextCharFormat &format)
 {
-    resolveCursorPositions(mode);
+    // qDebug() << "setTextValueMarker" << pos << id << valueLength << "in doc" << m_document;
+    TextValueMarker marker;
+    marker.position = pos;
+    marker.valueLength = valueLength;
+    marker.elementType = html ? ElementTypeHtml : ElementTypeText;
+    marker.revision = m_document.revision();
+    if (valueLength == 0)
+        marker.emptyValueFormat = format;
+    if (m_textValueMarkers.isEmpty() || m_textValueMarkers.last().position <= pos) {
+        // The usual case: the report is built from top to bottom
+        m_textValueIndex[id].append(m_textValueMarkers.size());
+        m_textValueMarkers.append(marker);
+        return;
+    }
+    // Keep the markers sorted, the indexes after the insertion point change
+    auto insertIt = std::upper_bound(m_textValueMarkers.begin(), m_textValueMarkers.end(), pos, [](int position, const TextValueMarker &other) {
+        return position < other.position;
+    });
+    const int insertIndex = insertIt - m_textValueMarkers.begin();
+    m_textValueMarkers.insert(insertIndex, marker);
+    for (QVector<int> &indexes : m_textValueIndex) {
+        for (int &index : indexes) {
+            if (index >= insertIndex)
+                ++index;
+        }
+    }
+    m_textValueIndex[id].append(insertIndex);
 }
 
-void KDReports::TextDocumentData::resolveCursorPositions(ModificationMode mode)
+void KDReports::TextDocumentData::shiftTextValueMarkers(int fromPosition, int delta)
 {
-    // We have to use QTextCursor in TextValueData so that it gets updated when
-    // we modify the document later on, but we can't just store the QTextCursor
-    // at insertion time; that cursor would be moved to the end of the document
-    // while the insertion keeps happening...
-    auto it = m_textValueCursors.begin();
-    for (; it != m_textValueCursors.end(); ++it) {
-        TextValueData &data = *it;
-        if (data.cursor.isNull()) {
-            // When appending, leave cursors "at end of document" unresolved.
-            // Otherwise they'll keep moving with insertions.
-            if (mode == Append && data.initialPosition >= m_document.characterCount() - 1) {
-                continue;
-            }
-            data.cursor = QTextCursor(&m_document);
-            data.cursor.setPosition(data.initialPosition);
-            // qDebug() << "Cursor for" << it.key() << "resolved at position" << data.initialPosition;
-        }
+    if (delta == 0)
+        return;
+    auto it = std::lower_bound(m_textValueMarkers.begin(), m_textValueMarkers.end(), fromPosition, [](const TextValueMarker &marker, int position) {
+        return marker.position < position;
+    });
+    for (; it != m_textValueMarkers.end(); ++it) {
+        it->position += delta;
+        it->revision = m_document.revision();
     }
-    // dumpTextValueCursors();
 }
 
-void KDReports::TextDocumentData::setTextValueMarker(int pos, const QString &id, int valueLength, bool html)
+void KDReports::TextDocumentData::adjustTextValueMarkers(int position, int charsRemoved, int charsAdded)
 {
-    // qDebug() << "setTextValueMarker" << pos << id << valueLength << "in doc" << m_document;
-    TextValueData val;
-    val.valueLength = valueLength;
-    val.elementType = html ? ElementTypeHtml : ElementTypeText;
-    val.initialPosition = pos;
-    m_textValueCursors.insert(id, val);
+    // updateTextValues and regenerateOneTable move the markers themselves
+    if (m_updatingTextValueMarkers)
+        return;
+    // The document revision changes when an edit (block) starts, and not within an edit block,
+    // whose changes are only signaled at its end: the markers created or moved since then
+    // are at their final position already.
+    const int revision = m_document.revision();
+    const int delta = charsAdded - charsRemoved;
+    const int end = position + charsRemoved;
+    // Skip the markers which end before the change; they don't overlap, so their ends are sorted too
+    auto it = std::lower_bound(m_textValueMarkers.begin(), m_textValueMarkers.end(), position, [](const TextValueMarker &marker, int pos) {
+        return marker.position + marker.valueLength < pos;
+    });
+    for (; it != m_textValueMarkers.end(); ++it) {
+        if (delta == 0 && it->position >= end)
+            break; // the length didn't change, the markers after the change stay in place
+        if (it->revision == revision)
+            continue;
+        const int valueEnd = it->position + it->valueLength;
+        if (valueEnd <= position) {
+            continue; // text added right after the value, or an empty value
+        } else if (it->position >= end) {
+            it->position += delta;
+        } else if (it->position <= position && valueEnd >= end) {
+            it->valueLength += delta; // modified inside the value
+        } else {
+            // Part of the value was removed, keep the rest
+            const int newStart = it->position < position ? it->position : position + charsAdded;
+            const int newEnd = valueEnd > end ? valueEnd + delta : newStart < position ? position : newStart;
+            it->position = newStart;
+            it->valueLength = qMax(0, newEnd - newStart);
+        }
+    }
 }
 
 void KDReports::TextDocumentData::updateTextValue(const QString &id, const QString &newValue)
 {
-    aboutToModifyContents(Modify);
+    QHash<QString, QString> values;
+    values.insert(id, newValue);
+    updateTextValues(values);
+}
 
-    // qDebug() << "updateTextValue: looking for id" << id << "in doc" << m_document;
+void KDReports::TextDocumentData::updateTextValues(const QHash<QString, QString> &values)
+{
+    // qDebug() << "updateTextValues:" << values.keys() << "in doc" << m_document;
+
+    // Marker index -> new value
+    QVector<QPair<int, QString>> edits;
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        const auto indexIt = m_textValueIndex.constFind(it.key());
+        if (indexIt == m_textValueIndex.cend())
+            continue;
+        for (int index : indexIt.value()) {
+            edits.append(qMakePair(index, it.value()));
+        }
+    }
+    if (edits.isEmpty())
+        return;
 
-    QMultiMap<QString, TextValueData>::iterator it = m_textValueCursors.find(id);
-    while (it != m_textValueCursors.end() && it.key() == id) {
-        TextValueData &data = *it;
-        // qDebug() << "Found at position" << data.cursor.position() << "length" << data.valueLength << "replacing with new value" << newValue;
+    // Edit from the end of the document backwards, so that the positions of the markers
+    // which haven't been processed yet remain valid.
+    std::sort(edits.begin(), edits.end(), [](const QPair<int, QString> &lhs, const QPair<int, QString> &rhs) {
+        return lhs.first > rhs.first;
+    });
+    QVector<int> deltas(m_textValueMarkers.size(), 0);
+    m_updatingTextValueMarkers = true;
+    QTextCursor c(&m_document);
+    c.beginEditBlock();
+    for (const auto &edit : std::as_const(edits)) {
+        TextValueMarker &marker = m_textValueMarkers[edit.first];
+        // qDebug() << "Found at position" << marker.position << "length" << marker.valueLength << "replacing with new value" << edit.second;
+        c.setPosition(marker.position);
+        c.setPosition(marker.position + marker.valueLength, QTextCursor::KeepAnchor);
+        if (marker.elementType == ElementTypeHtml) {
+            c.insertHtml(edit.second);
+        } else if (marker.valueLength == 0 && marker.emptyValueFormat.propertyCount() > 0) {
+            c.insertText(edit.second, marker.emptyValueFormat);
+        } else {
+            if (edit.second.isEmpty())
+                marker.emptyValueFormat = c.charFormat();
+            c.insertText(edit.second);
+        }
+        const int newLength = c.position() - marker.position;
+        if (newLength > 0)
+            marker.emptyValueFormat = QTextCharFormat();
+        deltas[edit.first] = newLength - marker.valueLength;
+        marker.valueLength = newLength;
+    }
+    c.endEditBlock();
+    m_updatingTextValueMarkers = false;
+
+    // Now update the positions of all the markers after the modified ones, in one pass
+    int shift = 0;
+    for (int index = edits.last().first; index < m_textValueMarkers.size(); ++index) {
+        m_textValueMarkers[index].position += shift;
+        shift += deltas.at(index);
+        m_textValueMarkers[index].revision = m_document.revision(); // when called inside Report::beginEdit/endEdit
+    }
 
-        QTextCursor c(data.cursor);
-        const int oldPos = data.cursor.position();
-        c.setPosition(oldPos + data.valueLength, QTextCursor::KeepAnchor);
-        const bool html = data.elementType == ElementTypeHtml;
-        if (html)
-            c.insertHtml(newValue);
-        else
-            c.insertText(newValue);
-        // update data
-        data.valueLength = c.position() - oldPos;
-        data.cursor.setPosition(oldPos);
-        // qDebug() << " stored new length" << data.valueLength;
+    // dumpTextValueMarkers();
+}
 
-        ++it;
+KDReports::TextDocumentData::DocumentTemplate KDReports::TextDocumentData::createTemplate(int startPosition, int endPosition)
+{
+    DocumentTemplate documentTemplate;
+    QTextCursor c(&m_document);
+    c.setPosition(startPosition);
+    c.setPosition(endPosition, QTextCursor::KeepAnchor);
+    documentTemplate.fragment = c.selection();
+
+    // If the contents start at the beginning of a paragraph, rather than with a paragraph separator
+    // (e.g. the first element of the report), each copy needs a new paragraph with the same formats.
+    const QTextBlock firstBlock = m_document.findBlock(startPosition);
+    if (firstBlock.position() == startPosition && m_document.characterAt(startPosition) != QChar::ParagraphSeparator) {
+        documentTemplate.startsNewBlock = true;
+        documentTemplate.firstBlockFormat = firstBlock.blockFormat();
+        documentTemplate.firstBlockCharFormat = firstBlock.charFormat();
     }
 
-    // dumpTextValueCursors();
+    QVector<QPair<int, QString>> markerIndexes;
+    for (auto it = m_textValueIndex.cbegin(); it != m_textValueIndex.cend(); ++it) {
+        for (int index : it.value()) {
+            const TextValueMarker &marker = m_textValueMarkers.at(index);
+            if (marker.position >= startPosition && marker.position + marker.valueLength <= endPosition)
+                markerIndexes.append(qMakePair(index, it.key()));
+        }
+    }
+    std::sort(markerIndexes.begin(), markerIndexes.end(), [](const QPair<int, QString> &lhs, const QPair<int, QString> &rhs) {
+        return lhs.first < rhs.first;
+    });
+    for (const auto &markerIndex : std::as_const(markerIndexes)) {
+        const TextValueMarker &marker = m_textValueMarkers.at(markerIndex.first);
+        documentTemplate.markers.append({marker.position - startPosition, marker.valueLength, marker.elementType, markerIndex.second, marker.emptyValueFormat});
+    }
+
+    for (QTextTable *table : std::as_const(m_tables)) {
+        if (table->firstPosition() >= startPosition && table->lastPosition() < endPosition)
+            documentTemplate.tableOffsets.append(table->firstPosition() - startPosition);
+    }
+    for (const QTextCursor &imageCursor : std::as_const(m_resizableImageCursors)) {
+        if (imageCursor.position() >= startPosition && imageCursor.position() < endPosition)
+            documentTemplate.resizableImageOffsets.append(imageCursor.position() - startPosition);
+    }
+    return documentTemplate;
+}
+
+void KDReports::TextDocumentData::appendTemplate(const DocumentTemplate &documentTemplate, QTextCursor &cursor, const QHash<QString, QString> &values)
+{
+    cursor.beginEditBlock();
+    if (documentTemplate.startsNewBlock)
+        cursor.insertBlock(documentTemplate.firstBlockFormat, documentTemplate.firstBlockCharFormat);
+    const int copyStart = cursor.position();
+    cursor.insertFragment(documentTemplate.fragment);
+
+    // Register the copied objects before the offsets change
+    for (int offset : documentTemplate.tableOffsets) {
+        QTextCursor tableCursor(&m_document);
+        tableCursor.setPosition(copyStart + offset);
+        if (QTextTable *table = tableCursor.currentTable())
+            registerTable(table);
+    }
+    for (int offset : documentTemplate.resizableImageOffsets) {
+        registerResizableImage(copyStart + offset);
+    }
+
+    // Replace the values from the last marker to the first one, so that the offsets of the others remain valid
+    const QVector<DocumentTemplate::Marker> &markers = documentTemplate.markers;
+    QVector<int> valueLengths(markers.size());
+    QVector<QTextCharFormat> emptyValueFormats(markers.size());
+    QTextCursor c(&m_document);
+    for (int i = markers.size() - 1; i >= 0; --i) {
+        const DocumentTemplate::Marker &marker = markers.at(i);
+        valueLengths[i] = marker.valueLength;
+        emptyValueFormats[i] = marker.emptyValueFormat;
+        const auto it = values.constFind(marker.id);
+        if (it == values.cend())
+            continue;
+        const int position = copyStart + marker.offset;
+        c.setPosition(position);
+        c.setPosition(position + marker.valueLength, QTextCursor::KeepAnchor);
+        if (marker.elementType == ElementTypeHtml) {
+            c.insertHtml(*it);
+        } else if (marker.valueLength == 0 && marker.emptyValueFormat.propertyCount() > 0) {
+            // e.g. empty in the first row: the value still gets the format of the element
+            c.insertText(*it, marker.emptyValueFormat);
+        } else {
+            if (it->isEmpty())
+                emptyValueFormats[i] = c.charFormat();
+            c.insertText(*it);
+        }
+        valueLengths[i] = c.position() - position;
+    }
+    // The copy has text value markers too, so that associateTextValue still works on all copies
+    int shift = 0;
+    for (int i = 0; i < markers.size(); ++i) {
+        const DocumentTemplate::Marker &marker = markers.at(i);
+        setTextValueMarker(copyStart + marker.offset + shift, marker.id, valueLengths.at(i), marker.elementType == ElementTypeHtml, emptyValueFormats.at(i));
+        shift += valueLengths.at(i) - marker.valueLength;
+    }
+
+    registerTabBlocks(copyStart, cursor.position());
+    cursor.endEditBlock();
 }
 
 void KDReports::TextDocumentData::updatePercentSizes(QSizeF size)
 {
-    if (!m_hasResizableImages && !m_usesTabPositions) {
+    if (m_resizableImageCursors.isEmpty() && m_tabBlockCursors.isEmpty()) {
         return;
     }
     QTextCursor c(&m_document);
     c.beginEditBlock();
-    if (m_hasResizableImages) {
-        do {
-            c.movePosition(QTextCursor::NextCharacter);
-            QTextCharFormat format = c.charFormat();
-            if (format.hasProperty(ResizableImageProperty)) {
-                Q_ASSERT(format.isImageFormat());
-                QTextImageFormat imageFormat = format.toImageFormat();
-                updatePercentSize(imageFormat, size);
-                // qDebug() << "updatePercentSizes: setting image to " << imageFormat.width() << "," << imageFormat.height();
-                c.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor);
-                c.setCharFormat(imageFormat);
-                c.movePosition(QTextCursor::NextCharacter);
-            }
-        } while (!c.atEnd());
-    }
-
-    if (m_usesTabPositions) {
-        QTextFrameFormat rootFrameFormat = m_document.rootFrame()->frameFormat();
-        const qreal rootFrameMargins = rootFrameFormat.leftMargin() + rootFrameFormat.rightMargin();
-        QTextBlock block = m_document.firstBlock();
-        do {
-            QTextBlockFormat blockFormat = block.blockFormat();
-            QList<QTextOption::Tab> tabs = blockFormat.tabPositions();
-            // qDebug() << "Looking at block" << block.blockNumber() << "tabs:" << tabs.count();
-            if (!tabs.isEmpty()) {
-                for (QTextOption::Tab &tab : tabs) {
-                    if (tab.delimiter == QLatin1Char('P') /* means Page -- see rightAlignedTab*/) {
-                        const auto availableWidth = size.width() - rootFrameMargins - block.blockFormat().leftMargin() - block.blockFormat().rightMargin();
-                        if (tab.type == QTextOption::RightTab) {
-                            // qDebug() << "Adjusted RightTab from" << tab.position << "to" << availableWidth;
-                            tab.position = availableWidth;
-                        } else if (tab.type == QTextOption::CenterTab) {
-                            tab.position = availableWidth / 2;
-                        }
+    updatePercentSizesInImages(c, size);
+    updatePercentSizesInTabs(c, size);
+    c.endEditBlock();
+}
+
+void KDReports::TextDocumentData::updatePercentSizesInImages(QTextCursor &c, QSizeF size)
+{
+    QSet<int> seenPositions;
+    auto it = m_resizableImageCursors.begin();
+    while (it != m_resizableImageCursors.end()) {
+        const int pos = it->position();
+        c.setPosition(pos);
+        c.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor);
+        const QTextCharFormat format = c.charFormat();
+        // The image might have been removed since (e.g. by regenerateAutoTables), forget about it then.
+        // Also make sure not to process the same image twice, updatePercentSize isn't idempotent.
+        if (!format.hasProperty(ResizableImageProperty) || seenPositions.contains(pos)) {
+            it = m_resizableImageCursors.erase(it);
+            continue;
+        }
+        seenPositions.insert(pos);
+        Q_ASSERT(format.isImageFormat());
+        QTextImageFormat imageFormat = format.toImageFormat();
+        updatePercentSize(imageFormat, size);
+        // qDebug() << "updatePercentSizes: setting image to " << imageFormat.width() << "," << imageFormat.height();
+        c.setCharFormat(imageFormat);
+        ++it;
+    }
+}
+
+void KDReports::TextDocumentData::updatePercentSizesInTabs(QTextCursor &c, QSizeF size)
+{
+    const QTextFrameFormat rootFrameFormat = m_document.rootFrame()->frameFormat();
+    const qreal rootFrameMargins = rootFrameFormat.leftMargin() + rootFrameFormat.rightMargin();
+    QSet<int> seenBlocks;
+    auto it = m_tabBlockCursors.begin();
+    while (it != m_tabBlockCursors.end()) {
+        const QTextBlock block = it->block();
+        if (!block.isValid() || seenBlocks.contains(block.blockNumber())) {
+            it = m_tabBlockCursors.erase(it);
+            continue;
+        }
+        seenBlocks.insert(block.blockNumber());
+        QTextBlockFormat blockFormat = block.blockFormat();
+        QList<QTextOption::Tab> tabs = blockFormat.tabPositions();
+        // qDebug() << "Looking at block" << block.blockNumber() << "tabs:" << tabs.count();
+        if (!tabs.isEmpty()) {
+            for (QTextOption::Tab &tab : tabs) {
+                if (tab.delimiter == QLatin1Char('P') /* means Page -- see rightAlignedTab*/) {
+                    const auto availableWidth = size.width() - rootFrameMargins - blockFormat.leftMargin() - blockFormat.rightMargin();
+                    if (tab.type == QTextOption::RightTab) {
+                        // qDebug() << "Adjusted RightTab from" << tab.position << "to" << availableWidth;
+                        tab.position = availableWidth;
+                    } else if (tab.type == QTextOption::CenterTab) {
+                        tab.position = availableWidth / 2;
                     }
                 }
-                blockFormat.setTabPositions(tabs);
-                // qDebug() << "Adjusted tabs:" << tabs;
-                c.setPosition(block.position());
-                c.setBlockFormat(blockFormat);
             }
-            block = block.next();
-        } while (block.isValid());
+            blockFormat.setTabPositions(tabs);
+            // qDebug() << "Adjusted tabs:" << tabs;
+            c.setPosition(block.position());
+            c.setBlockFormat(blockFormat);
+        }
+        ++it;
     }
-    c.endEditBlock();
 }
 
 void KDReports::TextDocumentData::layoutWithTextWidth(qreal w)
@@ -239,26 +477,43 @@ void KDReports::TextDocumentData::registerTable(QTextTable *table)
 
 void KDReports::TextDocumentData::scaleFontsBy(qreal factor)
 {
-    QTextCursor cursor(&m_document);
-    qreal currentPointSize = -1.0;
-    QTextCursor lastCursor(&m_document);
-    Q_FOREVER
+    // Collect runs of characters with the same font size first, from the fragments,
+    // rather than moving a cursor one character at a time. The formats can't be modified
+    // while iterating, since that would merge/split fragments under our feet.
+    struct FontSizeRun
     {
-        qreal cursorFontPointSize = cursor.charFormat().fontPointSize();
-        // qDebug() << cursorFontPointSize << "last=" << currentPointSize << cursor.block().text() << "position=" << cursor.position();
-        if (cursorFontPointSize != currentPointSize) {
-            if (currentPointSize != -1.0) {
-                setFontSizeHelper(lastCursor, cursor.position() - 1, currentPointSize, factor);
-                lastCursor.setPosition(cursor.position() - 1, QTextCursor::MoveAnchor);
+        int start;
+        int end;
+        qreal pointSize;
+    };
+    QVector<FontSizeRun> runs;
+    auto addRun = [&runs](int start, int end, qreal pointSize) {
+        if (!runs.isEmpty() && runs.last().end == start && runs.last().pointSize == pointSize) {
+            runs.last().end = end;
+        } else {
+            runs.append({start, end, pointSize});
+        }
+    };
+    for (QTextBlock block = m_document.begin(); block.isValid(); block = block.next()) {
+        for (auto fragmentIt = block.begin(); !fragmentIt.atEnd(); ++fragmentIt) {
+            const QTextFragment fragment = fragmentIt.fragment();
+            if (fragment.isValid()) {
+                addRun(fragment.position(), fragment.position() + fragment.length(), fragment.charFormat().fontPointSize());
             }
-            currentPointSize = cursorFontPointSize;
         }
-        if (cursor.atEnd())
-            break;
-        cursor.movePosition(QTextCursor::NextCharacter);
+        // The paragraph separator, whose format is the char format of the next block
+        // (and is used for the height of empty paragraphs)
+        const QTextBlock nextBlock = block.next();
+        if (nextBlock.isValid()) {
+            const int separatorPos = block.position() + block.length() - 1;
+            addRun(separatorPos, separatorPos + 1, nextBlock.charFormat().fontPointSize());
+        }
     }
-    if (currentPointSize != -1.0) {
-        setFontSizeHelper(lastCursor, cursor.position(), currentPointSize, factor);
+
+    QTextCursor cursor(&m_document);
+    cursor.beginEditBlock();
+    for (const FontSizeRun &run : std::as_const(runs)) {
+        setFontSizeHelper(cursor, run.start, run.end, run.pointSize, factor);
     }
 
     // Also adjust the padding in the cells so that it remains proportional,
@@ -277,9 +532,88 @@ void KDReports::TextDocumentData::scaleFontsBy(qreal factor)
 
         table->setFormat(format);
     }
+    cursor.endEditBlock();
+}
+
+// What setFontScalingFactor scaled from and to, so that it can scale again from the unscaled values
+static const int UnscaledFontSizeProperty = QTextFormat::UserProperty + 249;
+static const int ScaledFontSizeProperty = QTextFormat::UserProperty + 250;
+static const int UnscaledCellPaddingProperty = QTextFormat::UserProperty + 251;
+static const int UnscaledColumnConstraintsProperty = QTextFormat::UserProperty + 252;
+
+void KDReports::TextDocumentData::setFontScalingFactor(qreal factor)
+{
+    // Like scaleFontsBy, with runs of characters with the same unscaled font size.
+    // A font size which isn't the one set by the previous call (e.g. new contents) is unscaled.
+    struct FontSizeRun
+    {
+        int start;
+        int end;
+        qreal unscaledPointSize;
+    };
+    QVector<FontSizeRun> runs;
+    auto addRun = [&](int start, int end, const QTextCharFormat &format) {
+        qreal unscaledPointSize = format.fontPointSize();
+        if (format.hasProperty(UnscaledFontSizeProperty) && format.doubleProperty(ScaledFontSizeProperty) == format.fontPointSize())
+            unscaledPointSize = format.doubleProperty(UnscaledFontSizeProperty);
+        const qreal pointSize = (unscaledPointSize == 0 ? m_document.defaultFont().pointSize() : unscaledPointSize) * factor;
+        if (format.fontPointSize() == pointSize && format.hasProperty(UnscaledFontSizeProperty))
+            return; // already scaled by this factor
+        if (!runs.isEmpty() && runs.last().end == start && runs.last().unscaledPointSize == unscaledPointSize) {
+            runs.last().end = end;
+        } else {
+            runs.append({start, end, unscaledPointSize});
+        }
+    };
+    for (QTextBlock block = m_document.begin(); block.isValid(); block = block.next()) {
+        for (auto fragmentIt = block.begin(); !fragmentIt.atEnd(); ++fragmentIt) {
+            const QTextFragment fragment = fragmentIt.fragment();
+            if (fragment.isValid()) {
+                addRun(fragment.position(), fragment.position() + fragment.length(), fragment.charFormat());
+            }
+        }
+        const QTextBlock nextBlock = block.next();
+        if (nextBlock.isValid()) {
+            const int separatorPos = block.position() + block.length() - 1;
+            addRun(separatorPos, separatorPos + 1, nextBlock.charFormat());
+        }
+    }
+
+    QTextCursor cursor(&m_document);
+    cursor.beginEditBlock();
+    for (const FontSizeRun &run : std::as_const(runs)) {
+        const qreal pointSize = (run.unscaledPointSize == 0 ? m_document.defaultFont().pointSize() : run.unscaledPointSize) * factor;
+        QTextCharFormat newFormat;
+        newFormat.setFontPointSize(pointSize);
+        newFormat.setProperty(UnscaledFontSizeProperty, run.unscaledPointSize); // 0 follows the default font
+        newFormat.setProperty(ScaledFontSizeProperty, pointSize);
+        cursor.setPosition(run.start);
+        cursor.setPosition(run.end, QTextCursor::KeepAnchor);
+        cursor.mergeCharFormat(newFormat);
+    }
+
+    for (QTextTable *table : std::as_const(m_tables)) {
+        QTextTableFormat format = table->format();
+        if (!format.hasProperty(UnscaledCellPaddingProperty)) {
+            format.setProperty(UnscaledCellPaddingProperty, format.cellPadding());
+            format.setProperty(UnscaledColumnConstraintsProperty, format.columnWidthConstraints());
+        }
+        format.setCellPadding(format.doubleProperty(UnscaledCellPaddingProperty) * factor);
+
+        QVector<QTextLength> constraints = format.lengthVectorProperty(UnscaledColumnConstraintsProperty);
+        for (int i = 0; i < constraints.size(); ++i) {
+            if (constraints[i].type() == QTextLength::FixedLength) {
+                constraints[i] = QTextLength(QTextLength::FixedLength, constraints[i].rawValue() * factor);
+            }
+        }
+        format.setColumnWidthConstraints(constraints);
+
+        table->setFormat(format);
+    }
+    cursor.endEditBlock();
 }
 
-void KDReports::TextDocumentData::setFontSizeHelper(QTextCursor &lastCursor, int endPosition, qreal pointSize, qreal factor)
+void KDReports::TextDocumentData::setFontSizeHelper(QTextCursor &cursor, int startPosition, int endPosition, qreal pointSize, qreal factor)
 {
     if (pointSize == 0) {
         pointSize = m_document.defaultFont().pointSize();
@@ -287,42 +621,46 @@ void KDReports::TextDocumentData::setFontSizeHelper(QTextCursor &lastCursor, int
     pointSize *= factor;
     QTextCharFormat newFormat;
     newFormat.setFontPointSize(pointSize);
-    // qDebug() << "Applying" << pointSize << "from" << lastCursor.position() << "to" << endPosition;
-    lastCursor.setPosition(endPosition, QTextCursor::KeepAnchor);
-    lastCursor.mergeCharFormat(newFormat);
+    // qDebug() << "Applying" << pointSize << "from" << startPosition << "to" << endPosition;
+    cursor.setPosition(startPosition);
+    cursor.setPosition(endPosition, QTextCursor::KeepAnchor);
+    cursor.mergeCharFormat(newFormat);
 }
 
 //@cond PRIVATE
 
-QString KDReports::TextDocumentData::toStandaloneHtml()
+QString KDReports::TextDocumentData::toStandaloneHtml() const
 {
-    // Generate data URLs for images
-    QTextCursor c(&m_document);
-    c.beginEditBlock();
-
+    // Replace the image sources with data URLs in the HTML, without modifying the document.
+    // Each image is encoded once: the same resource can be used several times,
+    // and different resources can share the same image (e.g. the same ImageElement added twice).
+    QString htmlText = asHtml();
+    QSet<QString> names;
+    QHash<qint64, QString> dataUrlsByImage; // by QImage::cacheKey()
     for (auto block = m_document.begin(); block != m_document.end(); block = block.next()) {
         for (auto fragmentIt = block.begin(); !fragmentIt.atEnd(); ++fragmentIt) {
-            QTextFragment fragment = fragmentIt.fragment();
-            if (fragment.isValid() && fragment.charFormat().isImageFormat()) {
-                QTextImageFormat imageFormat = fragment.charFormat().toImageFormat();
-                if (imageFormat.name().isEmpty())
-                    continue;
-                QImage image = m_document.resource(QTextDocument::ImageResource, QUrl(imageFormat.name())).value<QImage>();
-                if (image.isNull())
-                    continue;
+            const QTextFragment fragment = fragmentIt.fragment();
+            if (!fragment.isValid() || !fragment.charFormat().isImageFormat())
+                continue;
+            const QString name = fragment.charFormat().toImageFormat().name();
+            if (name.isEmpty() || names.contains(name))
+                continue;
+            names.insert(name);
+            const QImage image = m_document.resource(QTextDocument::ImageResource, QUrl(name)).value<QImage>();
+            if (image.isNull())
+                continue;
+            auto imageIt = dataUrlsByImage.find(image.cacheKey());
+            if (imageIt == dataUrlsByImage.end()) {
                 QBuffer buffer;
                 buffer.open(QIODevice::WriteOnly);
                 image.save(&buffer, "PNG");
-                imageFormat.setName(QStringLiteral("data:image/png;base64,%1").arg(QString::fromLatin1(buffer.data().toBase64())));
-                c.setPosition(fragment.position());
-                c.setPosition(fragment.position() + 1, QTextCursor::KeepAnchor);
-                c.setCharFormat(imageFormat);
+                imageIt = dataUrlsByImage.insert(image.cacheKey(), QStringLiteral("data:image/png;base64,") + QString::fromLatin1(buffer.data().toBase64()));
             }
+            // As written by QTextDocument::toHtml
+            htmlText.replace(QStringLiteral("src=\"") + name.toHtmlEscaped() + QLatin1Char('"'), QStringLiteral("src=\"") + *imageIt + QLatin1Char('"'));
         }
     }
-
-    c.endEditBlock();
-    return asHtml();
+    return htmlText;
 }
 
 QString KDReports::TextDocumentData::asHtml() const
@@ -339,6 +677,86 @@ QString KDReports::TextDocumentData::asHtml() const
     htmlText.remove(QLatin1String("style=\" \""));
     return htmlText;
 }
+
+QByteArray KDReports::TextDocumentData::contentHash(int startPosition, int endPosition) const
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    auto addInt = [&hash](int value) {
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(&value), sizeof(value)));
+    };
+    // Format indexes identify formats cheaply: the document shares identical formats,
+    // and never changes the format behind an index.
+    // What the formats only refer to (image resources, charts) is hashed separately.
+    const QTextBlock firstBlock = m_document.findBlock(startPosition);
+    for (QTextBlock block = firstBlock; block.isValid() && block.position() <= endPosition; block = block.next()) {
+        addInt(block.position() - firstBlock.position()); // relative, so that changes on previous pages don't matter
+        addInt(block.blockFormatIndex());
+        if (QTextTable *table = QTextCursor(block).currentTable()) {
+            addInt(table->formatIndex());
+            addInt(table->cellAt(block.position()).tableCellFormatIndex());
+        }
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            const QTextFragment fragment = it.fragment();
+            addInt(fragment.charFormatIndex());
+            const QString text = fragment.text();
+            hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(text.constData()), text.size() * int(sizeof(QChar))));
+            const QTextCharFormat format = fragment.charFormat();
+            if (format.isImageFormat()) {
+                // The resource can be replaced under the same name
+                const QImage image = m_document.resource(QTextDocument::ImageResource, QUrl(format.toImageFormat().name())).value<QImage>();
+                addInt(image.width());
+                addInt(image.height());
+                addInt(image.format());
+                hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(image.constBits()), image.bytesPerLine() * image.height()));
+            }
+#ifdef HAVE_KDCHART
+            else if (format.objectType() == ChartTextObject::ChartObjectTextFormat) {
+                // The chart paints the current data of its models
+                auto *chart = qvariant_cast<KDChart::Chart *>(format.property(ChartTextObject::ChartObject));
+                QByteArray modelData;
+                QDataStream stream(&modelData, QIODevice::WriteOnly);
+                const auto planes = chart->coordinatePlanes();
+                for (KDChart::AbstractCoordinatePlane *plane : planes) {
+                    const auto diagrams = plane->diagrams();
+                    for (KDChart::AbstractDiagram *diagram : diagrams) {
+                        const QAbstractItemModel *model = diagram->model();
+                        if (!model)
+                            continue;
+                        const QModelIndex rootIndex = diagram->rootIndex();
+                        const int rows = model->rowCount(rootIndex);
+                        const int columns = model->columnCount(rootIndex);
+                        stream << rows << columns;
+                        for (int row = 0; row < rows; ++row) {
+                            for (int column = 0; column < columns; ++column)
+                                stream << model->data(model->index(row, column, rootIndex));
+                        }
+                    }
+                }
+                hash.addData(modelData);
+            }
+#endif
+        }
+    }
+    return hash.result();
+}
+
+bool KDReports::TextDocumentData::writeHtml(QIODevice *device) const
+{
+    HtmlWriter writer(&m_document);
+    return writer.write(device);
+}
+
+bool KDReports::TextDocumentData::writeMarkdown(QIODevice *device) const
+{
+    MarkdownWriter writer(&m_document);
+    return writer.write(device);
+}
+
+bool KDReports::TextDocumentData::writeOdt(QIODevice *device) const
+{
+    OdtWriter writer(&m_document);
+    return writer.write(device);
+}
 //@endcond
 
 void KDReports::TextDocumentData::registerAutoTable(QTextTable *table, const KDReports::AutoTableElement *element)
@@ -361,7 +779,8 @@ void KDReports::TextDocumentData::regenerateAutoTables()
     // qDebug() << "regenerateAutoTables" << m_autoTables.count();
     if (m_autoTables.isEmpty())
         return;
-    aboutToModifyContents(Modify);
+    // The markers are shifted by regenerateOneTable, table by table
+    m_updatingTextValueMarkers = true;
     QTextCursor(&m_document).beginEditBlock();
     // preciseDump();
     AutoTablesMaps autoTables = m_autoTables; // make copy since it will be modified below.
@@ -374,11 +793,12 @@ void KDReports::TextDocumentData::regenerateAutoTables()
     }
     // preciseDump();
     QTextCursor(&m_document).endEditBlock();
+    m_updatingTextValueMarkers = false;
 }
 
 void KDReports::TextDocumentData::regenerateAutoTableForModel(QAbstractItemModel *model)
 {
-    aboutToModifyContents(Modify);
+    m_updatingTextValueMarkers = true;
     QTextCursor(&m_document).beginEditBlock();
     AutoTablesMaps::iterator it = m_autoTables.begin();
     for (; it != m_autoTables.end(); ++it) {
@@ -391,6 +811,7 @@ void KDReports::TextDocumentData::regenerateAutoTableForModel(QAbstractItemModel
         }
     }
     QTextCursor(&m_document).endEditBlock();
+    m_updatingTextValueMarkers = false;
 }
 //@endcond
 
@@ -402,7 +823,8 @@ void KDReports::TextDocumentData::regenerateOneTable(const KDReports::AutoTableE
     QTextCursor lastCurs = table->lastCursorPosition();
     lastCurs.setPosition(lastCurs.position() + 1);
     QTextBlockFormat blockFormat = lastCurs.blockFormat(); // preserve page breaks
-    cursor.setPosition(table->lastCursorPosition().position() + 1, QTextCursor::KeepAnchor);
+    const int oldEndPosition = table->lastCursorPosition().position() + 1;
+    cursor.setPosition(oldEndPosition, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
     cursor.setBlockFormat(QTextBlockFormat()); // see preciseDump during TextDocument unittest
     m_tables.removeAll(table);
@@ -413,7 +835,10 @@ void KDReports::TextDocumentData::regenerateOneTable(const KDReports::AutoTableE
     if (isSet) {
         builder.setDefaultFont(font);
     }
+    const int startPosition = cursor.position();
     tableElement.build(builder); // this calls registerTable again
+    registerTabBlocks(startPosition, cursor.position());
+    shiftTextValueMarkers(oldEndPosition, cursor.position() - oldEndPosition);
 
     cursor.setBlockFormat(blockFormat);
     cursor.endEditBlock();
@@ -423,9 +848,10 @@ void KDReports::TextDocumentData::saveResourcesToFiles()
 {
     for (const QString &name : std::as_const(m_resourceNames)) {
         const QVariant v = m_document.resource(QTextDocument::ImageResource, QUrl(name));
-        QPixmap pix = v.value<QPixmap>();
-        if (!pix.isNull()) {
-            pix.save(name);
+        // QImage rather than QPixmap, since this can run in a thread (Report::exportToHtmlAsync)
+        const QImage image = v.value<QImage>();
+        if (!image.isNull()) {
+            image.save(name);
         }
     }
 }
@@ -435,9 +861,28 @@ void KDReports::TextDocumentData::addResourceName(const QString &resourceName)
     m_resourceNames.append(resourceName);
 }
 
-void KDReports::TextDocumentData::setHasResizableImages()
+void KDReports::TextDocumentData::registerResizableImage(int position)
 {
-    m_hasResizableImages = true;
+    // Created after the image was inserted, so that the cursor stays in front of it
+    QTextCursor c(&m_document);
+    c.setPosition(position);
+    m_resizableImageCursors.append(c);
+}
+
+void KDReports::TextDocumentData::registerTabBlocks(int startPosition, int endPosition)
+{
+    if (!m_usesTabPositions) {
+        return;
+    }
+    for (QTextBlock block = m_document.findBlock(startPosition); block.isValid() && block.position() <= endPosition; block = block.next()) {
+        const QList<QTextOption::Tab> tabs = block.blockFormat().tabPositions();
+        for (const QTextOption::Tab &tab : tabs) {
+            if (tab.delimiter == QLatin1Char('P') /* means Page -- see rightAlignedTab*/) {
+                m_tabBlockCursors.append(QTextCursor(block));
+                break;
+            }
+        }
+    }
 }
 
 void KDReports::TextDocumentData::setUsesTabPositions(bool usesTabs)
@@ -12,9 +12,16 @@
 #define KDREPORTSTEXTDOCUMENTDATA_P_H
 #include "KDReportsAutoTableElement.h"
 #include "KDReportsReport.h"
-#include <QMultiMap>
+#include <QHash>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <QTextDocumentFragment>
+#include <QTextFormat>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
 
 //
 //  W A R N I N G
@@ -54,25 +61,36 @@ public:
 
     void setUsesTabPositions(bool usesTabs);
     void saveResourcesToFiles();
-    enum ModificationMode
-    {
-        Append,
-        Modify
-    };
-    void aboutToModifyContents(ModificationMode mode);
+    /// Removes all the contents, and frees the memory they used (see Report::beginStreaming)
+    void clear();
     void updateTextValue(const QString &id, const QString &newValue);
+    /// Replaces the values for all the ids in \p values, in a single edit block
+    void updateTextValues(const QHash<QString, QString> &values);
     void layoutWithTextWidth(qreal w);
     void setPageSize(QSizeF size);
-    void scaleFontsBy(qreal factor); // TODO remove?
+    void scaleFontsBy(qreal factor);
+    /// Scales the fonts, the cell padding and the fixed column widths to \p factor times their unscaled size.
+    /// Contents added or modified since the previous call are scaled from their current size.
+    void setFontScalingFactor(qreal factor);
     void updatePercentSizes(QSizeF size);
-    void setTextValueMarker(int pos, const QString &id, int valueLength, bool html);
+    /// \p format is kept for empty values, so that the value set later gets the format of the element
+    void setTextValueMarker(int pos, const QString &id, int valueLength, bool html, const QTextCharFormat &format = QTextCharFormat());
     /// Break all tables in the document
     /// @returns the number of horizontal pages used
     // int breakTables( const QSizeF& textDocPageSize, int numHorizontalPages, KDReports::Report::TableBreakingPageOrder pageOrder );
     // We need to know about all tables in order to implement table-breaking
     void registerTable(QTextTable *table);
-    QString toStandaloneHtml();
+    QString toStandaloneHtml() const;
     QString asHtml() const;
+    /// Returns a hash of the text and formats of the blocks containing \p startPosition to \p endPosition,
+    /// independent from their position in the document (see Report::setIncrementalExportEnabled)
+    QByteArray contentHash(int startPosition, int endPosition) const;
+    /// Writes the document as HTML to \p device, in chunks (see HtmlWriter)
+    bool writeHtml(QIODevice *device) const;
+    /// Writes the document as Markdown to \p device, in chunks (see MarkdownWriter)
+    bool writeMarkdown(QIODevice *device) const;
+    /// Writes the document as flat ODT to \p device, in chunks (see OdtWriter)
+    bool writeOdt(QIODevice *device) const;
     /// For autotables, let's also remember the AutoTableElement, to be able
     /// to regenerate them (when modifying options in the table breaking dialog)
     void registerAutoTable(QTextTable *table, const KDReports::AutoTableElement *element);
@@ -80,38 +98,86 @@ public:
     void regenerateAutoTables();
     void regenerateAutoTableForModel(QAbstractItemModel *model);
     void addResourceName(const QString &resourceName);
-    void setHasResizableImages();
+    /// Remembers the position of an image with a size relative to the page (ResizableImageProperty)
+    void registerResizableImage(int position);
+    /// Remembers the blocks in [startPosition, endPosition] that use page-relative tabs (see Report::rightAlignedTab)
+    void registerTabBlocks(int startPosition, int endPosition);
 
     static void updatePercentSize(QTextImageFormat &format, QSizeF size);
 
-private:
-    void resolveCursorPositions(ModificationMode mode);
-    void setFontSizeHelper(QTextCursor &lastCursor, int endPosition, qreal pointSize, qreal factor);
-    void regenerateOneTable(const KDReports::AutoTableElement &tableElement, QTextTable *table);
-    void dumpTextValueCursors() const;
-
-    QTextDocument m_document;
     enum ElementType
     {
         ElementTypeText,
         ElementTypeHtml
     };
-    struct TextValueData
+
+    /// A copy of a range of the document, which can then be appended again and again
+    /// with different text values, without building the elements again.
+    struct DocumentTemplate
+    {
+        struct Marker
+        {
+            int offset; // relative to the start of the template
+            int valueLength;
+            ElementType elementType;
+            QString id;
+            QTextCharFormat emptyValueFormat;
+        };
+        QTextDocumentFragment fragment;
+        bool startsNewBlock = false;
+        QTextBlockFormat firstBlockFormat;
+        QTextCharFormat firstBlockCharFormat;
+        QVector<Marker> markers; // sorted by offset
+        QVector<int> tableOffsets;
+        QVector<int> resizableImageOffsets;
+    };
+    /// Creates a template from the contents between \p startPosition and \p endPosition
+    DocumentTemplate createTemplate(int startPosition, int endPosition);
+    /// Appends a copy of \p documentTemplate at \p cursor, which must be at the end of the document,
+    /// replacing the values of the text value markers whose id is in \p values.
+    void appendTemplate(const DocumentTemplate &documentTemplate, QTextCursor &cursor, const QHash<QString, QString> &values);
+
+private:
+    /// Adjusts the position of the text value markers after \p fromPosition, for modifications not made by updateTextValues
+    void shiftTextValueMarkers(int fromPosition, int delta);
+    /// Adjusts the text value markers after any other modification of the document (QTextDocument::contentsChange)
+    void adjustTextValueMarkers(int position, int charsRemoved, int charsAdded);
+    void setFontSizeHelper(QTextCursor &cursor, int startPosition, int endPosition, qreal pointSize, qreal factor);
+    void regenerateOneTable(const KDReports::AutoTableElement &tableElement, QTextTable *table);
+    void dumpTextValueMarkers() const;
+    void updatePercentSizesInImages(QTextCursor &cursor, QSizeF size);
+    void updatePercentSizesInTabs(QTextCursor &cursor, QSizeF size);
+
+    QTextDocument m_document;
+    struct TextValueMarker
     {
+        int position;
         int valueLength;
         ElementType elementType;
-        QTextCursor cursor;
-        int initialPosition;
+        int revision; // QTextDocument::revision() when the marker was created or last moved, see adjustTextValueMarkers
+        // While the value is empty, there's no character to take its format from
+        QTextCharFormat emptyValueFormat;
     };
-    QMultiMap<QString, TextValueData> m_textValueCursors;
+    // Plain positions rather than QTextCursors: with thousands of ids, Qt would have to adjust
+    // thousands of cursors on every edit. Sorted by position, so the positions can be updated
+    // after an edit in a single pass.
+    QVector<TextValueMarker> m_textValueMarkers;
+    // id -> indexes in m_textValueMarkers
+    QHash<QString, QVector<int>> m_textValueIndex;
+    QMetaObject::Connection m_contentsChangeConnection;
+    // Set while the markers are updated by hand, see adjustTextValueMarkers
+    bool m_updatingTextValueMarkers;
 
     QList<QTextTable *> m_tables;
 
     typedef QHash<QTextTable *, KDReports::AutoTableElement> AutoTablesMaps;
     AutoTablesMaps m_autoTables;
     QList<QString> m_resourceNames;
+    // Tracked cursors, so that updatePercentSizes doesn't have to walk the whole document.
+    // Each image cursor sits right before the image character, each tab cursor in the block.
+    QList<QTextCursor> m_resizableImageCursors;
+    QList<QTextCursor> m_tabBlockCursors;
     bool m_usesTabPositions;
-    bool m_hasResizableImages = false;
 };
 
 }
@@ -70,8 +70,10 @@ public:
     void regenerateAutoTableForModel(QAbstractItemModel *model);
 
     void updateTextValue(const QString &id, const QString &newValue);
+    void updateTextValues(const QHash<QString, QString> &values);
 
     void scaleFontsBy(qreal factor);
+    void setFontScalingFactor(qreal factor);
 
     QFont defaultFont() const;
     QTextDocument &contentDocument();
@@ -80,7 +82,10 @@ public:
     QList<KDReports::AutoTableElement *> autoTableElements();
 
     QString asHtml() const;
-    QString toStandaloneHtml();
+    bool writeHtml(QIODevice *device) const;
+    bool writeMarkdown(QIODevice *device) const;
+    bool writeOdt(QIODevice *device) const;
+    QString toStandaloneHtml() const;
     void preciseDump();
 
 private:
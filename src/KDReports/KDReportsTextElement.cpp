@@ -100,7 +100,7 @@ void KDReports::TextElement::build(ReportBuilder &builder) const
     cursor.setCharFormat(charFormat);
     cursor.insertText(d->m_string);
     if (!d->m_id.isEmpty())
-        builder.currentDocumentData().setTextValueMarker(charPosition, d->m_id, d->m_string.length(), false);
+        builder.currentDocumentData().setTextValueMarker(charPosition, d->m_id, d->m_string.length(), false, charFormat);
 }
 
 KDReports::TextElement &KDReports::TextElement::operator<<(const QString &str)
@@ -0,0 +1,135 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsTextSearcher_p.h"
+
+#include <QRunnable>
+#include <QStringMatcher>
+
+namespace {
+// Finds all occurrences of the text, one chunk after the other, so that a cancelled search stops quickly
+// and the first hits are shown before the whole report was searched.
+// Runs in a thread pool: it doesn't touch the report.
+class SearchRunnable : public QRunnable
+{
+public:
+    SearchRunnable(KDReports::TextSearcher *searcher, const QAtomicInt *currentGeneration, int generation, const KDReports::PageTextIndex &index,
+                   const QString &text, Qt::CaseSensitivity caseSensitivity)
+        : m_searcher(searcher)
+        , m_currentGeneration(currentGeneration)
+        , m_generation(generation)
+        , m_index(index)
+        , m_text(text)
+        , m_caseSensitivity(caseSensitivity)
+    {
+    }
+
+    void run() override
+    {
+        static const int chunkSize = 256 * 1024;
+        const QString &text = m_index.text;
+        const int length = m_text.size();
+        const QStringMatcher matcher(m_text, m_caseSensitivity);
+        int from = 0;
+        for (int chunkEnd = chunkSize; from < text.size(); chunkEnd += chunkSize) {
+            if (m_currentGeneration->loadAcquire() != m_generation)
+                return; // cancelled
+            // Hits starting before chunkEnd
+            const int end = qMin(text.size(), chunkEnd + length - 1);
+            QVector<KDReports::SearchHit> hits;
+            int pos;
+            while ((pos = matcher.indexIn(text.constData(), end, from)) >= 0) {
+                KDReports::SearchHit hit;
+                hit.position = pos;
+                hit.length = length;
+                hit.pageNumber = m_index.pageAt(pos);
+                hits.append(hit);
+                from = pos + length;
+            }
+            from = qMax(from, chunkEnd);
+            const bool last = from >= text.size();
+            if (!hits.isEmpty() || last)
+                deliver(hits, last);
+        }
+        if (text.isEmpty())
+            deliver({}, true);
+    }
+
+private:
+    void deliver(const QVector<KDReports::SearchHit> &hits, bool last)
+    {
+        // Queued, so it's called in the GUI thread; the searcher waits for this runnable when deleted
+        QMetaObject::invokeMethod(m_searcher, "found", Qt::QueuedConnection, Q_ARG(int, m_generation), Q_ARG(QVector<KDReports::SearchHit>, hits), Q_ARG(bool, last));
+    }
+
+    KDReports::TextSearcher *m_searcher;
+    const QAtomicInt *m_currentGeneration;
+    const int m_generation;
+    const KDReports::PageTextIndex m_index;
+    const QString m_text;
+    const Qt::CaseSensitivity m_caseSensitivity;
+};
+}
+
+KDReports::TextSearcher::TextSearcher(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<QVector<KDReports::SearchHit>>("QVector<KDReports::SearchHit>");
+    m_pool.setMaxThreadCount(1);
+}
+
+KDReports::TextSearcher::~TextSearcher()
+{
+    // The runnable refers to this object
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void KDReports::TextSearcher::search(const PageTextIndex &index, const QString &text, Qt::CaseSensitivity caseSensitivity)
+{
+    clear();
+    if (text.isEmpty())
+        return;
+    m_finished = false;
+    m_pool.start(new SearchRunnable(this, &m_generation, m_generation.loadAcquire(), index, text, caseSensitivity));
+}
+
+void KDReports::TextSearcher::clear()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear(); // the search which didn't start yet
+    m_hits.clear();
+    m_finished = true;
+}
+
+const QVector<KDReports::SearchHit> &KDReports::TextSearcher::hits() const
+{
+    return m_hits;
+}
+
+bool KDReports::TextSearcher::isFinished() const
+{
+    return m_finished;
+}
+
+void KDReports::TextSearcher::found(int generation, const QVector<KDReports::SearchHit> &hits, bool last)
+{
+    if (generation != m_generation.loadAcquire())
+        return; // cleared or searching something else in the meantime
+    const int first = m_hits.size();
+    m_hits += hits;
+    if (!hits.isEmpty())
+        Q_EMIT hitsFound(first);
+    if (last) {
+        m_finished = true;
+        Q_EMIT finished();
+    }
+}
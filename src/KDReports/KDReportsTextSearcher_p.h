@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSTEXTSEARCHER_P_H
+#define KDREPORTSTEXTSEARCHER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "KDReportsAbstractReportLayout_p.h"
+
+#include <QAtomicInt>
+#include <QMetaType>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+
+namespace KDReports {
+
+/// An occurrence of the searched text
+struct SearchHit
+{
+    int position = 0; // in the document
+    int length = 0;
+    int pageNumber = 0;
+};
+
+}
+
+Q_DECLARE_TYPEINFO(KDReports::SearchHit, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(KDReports::SearchHit)
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Searches the text of a report for the preview, without blocking the GUI thread.
+ *
+ * The search runs in a thread on a PageTextIndex, taken from the report once after layouting:
+ * the report itself isn't used, and the pages aren't layouted again.
+ * The hits are delivered in document order, in batches, as the text is scanned, with hitsFound().
+ * Starting a new search cancels the previous one.
+ */
+class TextSearcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TextSearcher(QObject *parent = nullptr);
+    ~TextSearcher() override;
+
+    /// Searches \p text in \p index, instead of the previous search
+    void search(const PageTextIndex &index, const QString &text, Qt::CaseSensitivity caseSensitivity);
+    /// Stops the search and forgets the hits
+    void clear();
+
+    /// The hits found so far
+    const QVector<SearchHit> &hits() const;
+    /// Returns true once the whole text was searched
+    bool isFinished() const;
+
+Q_SIGNALS:
+    /// Hits were appended to hits(), starting at \p first
+    void hitsFound(int first);
+    /// The whole text was searched
+    void finished();
+
+private:
+    Q_INVOKABLE void found(int generation, const QVector<KDReports::SearchHit> &hits, bool last);
+
+    QVector<SearchHit> m_hits;
+    bool m_finished = true;
+    QAtomicInt m_generation; // the searches of previous generations stop as soon as they notice
+    QThreadPool m_pool;
+};
+
+}
+
+#endif /* KDREPORTSTEXTSEARCHER_P_H */
@@ -0,0 +1,152 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsThumbnailRenderer_p.h"
+#include "KDReportsReport.h"
+#include "KDReportsReport_p.h"
+
+#include <QPainter>
+#include <QPicture>
+#include <QRunnable>
+
+namespace {
+// Rasterizes a page recorded into a QPicture into a thumbnail.
+// Runs in a thread pool: it doesn't touch the report.
+class ThumbnailRasterizer : public QRunnable
+{
+public:
+    ThumbnailRasterizer(KDReports::ThumbnailRenderer *renderer, int generation, int pageNumber, const QPicture &picture, QSizeF paperSize, int size, qreal devicePixelRatio)
+        : m_renderer(renderer)
+        , m_generation(generation)
+        , m_pageNumber(pageNumber)
+        , m_paperSize(paperSize)
+        , m_size(size)
+        , m_devicePixelRatio(devicePixelRatio)
+    {
+        // A deep copy: the report keeps the picture in its page cache, and playing a QPicture isn't reentrant
+        m_picture.setData(picture.data(), picture.size());
+    }
+
+    void run() override
+    {
+        // Use a QImage so that the raster paint engine is used.
+        // Gives a 7.7 times speedup (!) compared to X11.
+        QImage img(m_size * m_devicePixelRatio, m_size * m_devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+        img.setDevicePixelRatio(m_devicePixelRatio);
+        img.fill(Qt::transparent);
+        const qreal paperWidth = m_paperSize.width();
+        const qreal paperHeight = m_paperSize.height();
+        const qreal longestSide = qMax(paperWidth, paperHeight);
+        const qreal width = m_size * paperWidth / longestSide;
+        const qreal height = m_size * paperHeight / longestSide;
+        QPainter painter(&img);
+        painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform, true);
+        painter.translate((m_size - width) / 2, (m_size - height) / 2);
+        painter.fillRect(QRectF(0, 0, width, height), QBrush(Qt::white));
+        painter.scale(m_size / longestSide, m_size / longestSide);
+        painter.drawPicture(0, 0, m_picture);
+        painter.setPen(QPen(1));
+        painter.drawRect(QRectF(0, 0, paperWidth, paperHeight));
+        painter.end();
+
+        // Queued, so it's called in the GUI thread, unless the renderer was deleted in the meantime
+        QMetaObject::invokeMethod(m_renderer, "rasterized", Qt::QueuedConnection, Q_ARG(int, m_generation), Q_ARG(int, m_pageNumber), Q_ARG(QImage, img));
+    }
+
+private:
+    KDReports::ThumbnailRenderer *m_renderer;
+    const int m_generation;
+    const int m_pageNumber;
+    QPicture m_picture;
+    const QSizeF m_paperSize;
+    const int m_size;
+    const qreal m_devicePixelRatio;
+};
+}
+
+KDReports::ThumbnailRenderer::ThumbnailRenderer(QObject *parent)
+    : QObject(parent)
+{
+    m_recordTimer.setSingleShot(true);
+    connect(&m_recordTimer, &QTimer::timeout, this, [this]() { recordNextPage(); });
+}
+
+KDReports::ThumbnailRenderer::~ThumbnailRenderer()
+{
+    // The rasterizers refer to this object
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void KDReports::ThumbnailRenderer::setReport(Report *report)
+{
+    invalidate();
+    m_report = report;
+}
+
+void KDReports::ThumbnailRenderer::setThumbnailSize(int size, qreal devicePixelRatio)
+{
+    if (size == m_size && devicePixelRatio == m_devicePixelRatio)
+        return;
+    invalidate();
+    m_size = size;
+    m_devicePixelRatio = devicePixelRatio;
+}
+
+void KDReports::ThumbnailRenderer::requestThumbnails(const QVector<int> &pageNumbers)
+{
+    m_queue.clear();
+    for (int pageNumber : pageNumbers) {
+        if (!m_inFlight.contains(pageNumber))
+            m_queue.append(pageNumber);
+    }
+    if (!m_queue.isEmpty())
+        m_recordTimer.start(0);
+}
+
+void KDReports::ThumbnailRenderer::invalidate()
+{
+    ++m_generation;
+    m_queue.clear();
+    m_inFlight.clear();
+    m_recordTimer.stop();
+    m_pool.clear(); // the rasterizers which didn't start yet
+}
+
+void KDReports::ThumbnailRenderer::setFrozen(bool frozen)
+{
+    m_frozen = frozen;
+    if (!m_frozen && !m_queue.isEmpty())
+        m_recordTimer.start(0);
+}
+
+void KDReports::ThumbnailRenderer::recordNextPage()
+{
+    // Keep each thread busy with one page, and record the next pages only when needed:
+    // the requests can change in the meantime
+    if (!m_report || m_frozen || m_queue.isEmpty() || m_inFlight.size() >= m_pool.maxThreadCount())
+        return;
+    const int pageNumber = m_queue.takeFirst();
+    const QPicture picture = m_report->d->pagePicture(pageNumber);
+    m_inFlight.append(pageNumber);
+    m_pool.start(new ThumbnailRasterizer(this, m_generation, pageNumber, picture, m_report->paperSize(), m_size, m_devicePixelRatio));
+    if (!m_queue.isEmpty())
+        m_recordTimer.start(0);
+}
+
+void KDReports::ThumbnailRenderer::rasterized(int generation, int pageNumber, const QImage &image)
+{
+    if (generation != m_generation)
+        return; // invalidated in the meantime
+    m_inFlight.removeOne(pageNumber);
+    Q_EMIT thumbnailReady(pageNumber, image);
+    if (!m_queue.isEmpty())
+        m_recordTimer.start(0);
+}
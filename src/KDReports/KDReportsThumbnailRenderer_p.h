@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSTHUMBNAILRENDERER_P_H
+#define KDREPORTSTHUMBNAILRENDERER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QImage>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+namespace KDReports {
+
+class Report;
+
+/**
+ * @internal
+ * Renders page thumbnails for the preview, without blocking the GUI thread.
+ *
+ * Painting a page reads the report, so it happens in the GUI thread, into a QPicture
+ * (kept in the page cache of the report), one page per event loop iteration. The QPicture is then rasterized into a QImage
+ * in a thread pool, and delivered with thumbnailReady().
+ * The pages are rendered in the order given to requestThumbnails(), which replaces
+ * the previous requests: pages which scrolled out of view are not rendered anymore.
+ */
+class ThumbnailRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailRenderer(QObject *parent = nullptr);
+    ~ThumbnailRenderer() override;
+
+    void setReport(Report *report);
+    /// \p size is the size of the square thumbnails, in device independent pixels
+    void setThumbnailSize(int size, qreal devicePixelRatio);
+
+    /// Renders the thumbnails of \p pageNumbers, in this order, instead of the previously requested ones
+    void requestThumbnails(const QVector<int> &pageNumbers);
+    /// Cancels all requests. Thumbnails being rasterized are dropped, e.g. because the layout changed.
+    void invalidate();
+    /// While frozen, the report isn't used at all (e.g. while it's being layouted in another thread): the requests wait
+    void setFrozen(bool frozen);
+
+Q_SIGNALS:
+    void thumbnailReady(int pageNumber, const QImage &image);
+
+private:
+    void recordNextPage();
+    Q_INVOKABLE void rasterized(int generation, int pageNumber, const QImage &image);
+
+    Report *m_report = nullptr;
+    int m_size = 0;
+    qreal m_devicePixelRatio = 1.0;
+    bool m_frozen = false;
+    QVector<int> m_queue;
+    QVector<int> m_inFlight; // recorded, being rasterized
+    int m_generation = 0; // to drop the results of the requests made before invalidate()
+    QTimer m_recordTimer;
+    QThreadPool m_pool;
+};
+
+}
+
+#endif /* KDREPORTSTHUMBNAILRENDERER_P_H */
@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDReportsTiffWriter_p.h"
+
+#include <QDebug>
+#include <QIODevice>
+#include <QImage>
+#include <QtEndian>
+
+#include <limits>
+
+namespace {
+
+enum TiffType {
+    Short = 3,
+    Long = 4,
+    Rational = 5 // two Longs: numerator and denominator
+};
+
+void appendShort(QByteArray &bytes, quint16 value)
+{
+    char data[2];
+    qToLittleEndian(value, data);
+    bytes.append(data, 2);
+}
+
+void appendLong(QByteArray &bytes, quint32 value)
+{
+    char data[4];
+    qToLittleEndian(value, data);
+    bytes.append(data, 4);
+}
+
+// A directory entry whose value fits into the entry itself
+void appendEntry(QByteArray &ifd, quint16 tag, TiffType type, quint32 value)
+{
+    appendShort(ifd, tag);
+    appendShort(ifd, type);
+    appendLong(ifd, 1);
+    if (type == Short) {
+        appendShort(ifd, quint16(value));
+        appendShort(ifd, 0);
+    } else {
+        appendLong(ifd, value);
+    }
+}
+
+// A directory entry whose values are stored at \p offset in the file
+void appendArrayEntry(QByteArray &ifd, quint16 tag, TiffType type, quint32 count, quint32 offset)
+{
+    appendShort(ifd, tag);
+    appendShort(ifd, type);
+    appendLong(ifd, count);
+    appendLong(ifd, offset);
+}
+
+}
+
+KDReports::TiffWriter::TiffWriter(QIODevice *device, QSize size, int rowsPerStrip, qreal dpi)
+    : m_device(device)
+    , m_size(size)
+    , m_rowsPerStrip(rowsPerStrip)
+    , m_dpi(dpi)
+{
+}
+
+QByteArray KDReports::TiffWriter::compressStrip(const QImage &strip)
+{
+    const QImage rgb = strip.convertToFormat(QImage::Format_RGB888);
+    const int lineSize = rgb.width() * 3;
+    QByteArray data;
+    data.reserve(lineSize * rgb.height());
+    for (int y = 0; y < rgb.height(); ++y) {
+        // Lines are padded in QImage, not in TIFF
+        data.append(reinterpret_cast<const char *>(rgb.constScanLine(y)), lineSize);
+    }
+    // qCompress writes the uncompressed size, followed by the zlib stream which TIFF expects
+    return qCompress(data).mid(4);
+}
+
+bool KDReports::TiffWriter::begin()
+{
+    // Little-endian TIFF, the offset of the directory is set by finish()
+    QByteArray header("II*\0", 4);
+    appendLong(header, 0);
+    return write(header);
+}
+
+bool KDReports::TiffWriter::writeStrip(const QByteArray &compressedStrip)
+{
+    m_stripOffsets.append(quint32(m_pos));
+    m_stripByteCounts.append(quint32(compressedStrip.size()));
+    return write(compressedStrip);
+}
+
+bool KDReports::TiffWriter::finish()
+{
+    const int stripCount = m_stripOffsets.size();
+    if (stripCount != (m_size.height() + m_rowsPerStrip - 1) / m_rowsPerStrip) {
+        qWarning() << "TiffWriter: wrote" << stripCount << "strips for an image of height" << m_size.height();
+        return false;
+    }
+
+    // The values which don't fit into the directory entries, at a word boundary
+    if (m_pos % 2 && !write(QByteArray(1, '\0')))
+        return false;
+    QByteArray values;
+    const quint32 valuesOffset = quint32(m_pos);
+    const quint32 bitsPerSampleOffset = valuesOffset;
+    for (int sample = 0; sample < 3; ++sample)
+        appendShort(values, 8);
+    appendShort(values, 0); // word alignment
+    const quint32 stripOffsetsOffset = valuesOffset + values.size();
+    for (quint32 offset : std::as_const(m_stripOffsets))
+        appendLong(values, offset);
+    const quint32 stripByteCountsOffset = valuesOffset + values.size();
+    for (quint32 byteCount : std::as_const(m_stripByteCounts))
+        appendLong(values, byteCount);
+    const quint32 resolutionOffset = valuesOffset + values.size(); // used for both directions
+    appendLong(values, quint32(qRound(m_dpi * 100)));
+    appendLong(values, 100);
+    if (!write(values))
+        return false;
+
+    // The directory, with the entries sorted by tag
+    const quint32 ifdOffset = quint32(m_pos);
+    QByteArray ifd;
+    appendShort(ifd, 13);
+    appendEntry(ifd, 256, Long, m_size.width()); // ImageWidth
+    appendEntry(ifd, 257, Long, m_size.height()); // ImageLength
+    appendArrayEntry(ifd, 258, Short, 3, bitsPerSampleOffset); // BitsPerSample
+    appendEntry(ifd, 259, Short, 8); // Compression: Deflate
+    appendEntry(ifd, 262, Short, 2); // PhotometricInterpretation: RGB
+    if (stripCount == 1)
+        appendEntry(ifd, 273, Long, m_stripOffsets.first()); // StripOffsets
+    else
+        appendArrayEntry(ifd, 273, Long, stripCount, stripOffsetsOffset);
+    appendEntry(ifd, 277, Short, 3); // SamplesPerPixel
+    appendEntry(ifd, 278, Long, m_rowsPerStrip); // RowsPerStrip
+    if (stripCount == 1)
+        appendEntry(ifd, 279, Long, m_stripByteCounts.first()); // StripByteCounts
+    else
+        appendArrayEntry(ifd, 279, Long, stripCount, stripByteCountsOffset);
+    appendArrayEntry(ifd, 282, Rational, 1, resolutionOffset); // XResolution
+    appendArrayEntry(ifd, 283, Rational, 1, resolutionOffset); // YResolution
+    appendEntry(ifd, 284, Short, 1); // PlanarConfiguration: RGBRGB...
+    appendEntry(ifd, 296, Short, 2); // ResolutionUnit: inch
+    appendLong(ifd, 0); // no next directory
+    if (!write(ifd))
+        return false;
+
+    QByteArray header;
+    appendLong(header, ifdOffset);
+    return m_device->seek(4) && m_device->write(header) == header.size();
+}
+
+bool KDReports::TiffWriter::write(const QByteArray &bytes)
+{
+    if (m_pos + bytes.size() > std::numeric_limits<quint32>::max()) {
+        qWarning("TiffWriter: the image is too big for a TIFF file");
+        return false;
+    }
+    m_pos += bytes.size();
+    return m_device->write(bytes) == bytes.size();
+}
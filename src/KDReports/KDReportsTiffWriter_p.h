@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDREPORTSTIFFWRITER_P_H
+#define KDREPORTSTIFFWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the KD Reports API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QByteArray>
+#include <QSize>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QImage;
+class QIODevice;
+QT_END_NAMESPACE
+
+namespace KDReports {
+
+/**
+ * @internal
+ * Writes an RGB image as a TIFF file, one horizontal strip at a time,
+ * so that the whole image never has to be held in memory.
+ *
+ * Each strip is compressed separately (Deflate), which can be done in any thread with compressStrip().
+ * The strips must be written from top to bottom, and all have the same height except the last one.
+ * The device must be seekable: the header is updated by finish().
+ * The file uses 32-bit offsets, so it can't be bigger than 4GB.
+ * The resolution is stored in dots per inch, for applications which print or scale the image.
+ */
+class TiffWriter
+{
+public:
+    TiffWriter(QIODevice *device, QSize size, int rowsPerStrip, qreal dpi);
+
+    /// Converts \p strip to 8-bit RGB and compresses it
+    static QByteArray compressStrip(const QImage &strip);
+
+    bool begin();
+    /// \param compressedStrip the result of compressStrip()
+    bool writeStrip(const QByteArray &compressedStrip);
+    /// Writes the directory describing the image, after the last strip
+    bool finish();
+
+private:
+    bool write(const QByteArray &bytes);
+
+    QIODevice *m_device;
+    const QSize m_size;
+    const int m_rowsPerStrip;
+    const qreal m_dpi;
+    qint64 m_pos = 0;
+    QVector<quint32> m_stripOffsets;
+    QVector<quint32> m_stripByteCounts;
+};
+
+}
+
+#endif /* KDREPORTSTIFFWRITER_P_H */
@@ -235,7 +235,8 @@ bool KDReports::XmlParser::processNode(const QDomNode &node, KDReports::ReportBu
             // Handle <text> element
             KDReports::TextElement textElement;
             QString id;
-            const QString text = extractText(element, &id, m_report->d->m_currentModel, m_report->d->m_currentRow);
+            int boundColumn = -1;
+            const QString text = extractText(element, &id, m_report->d->m_currentModel, m_report->d->m_currentRow, &boundColumn);
             textElement.setText(text);
             textElement.setId(id);
             const QColor bgColor = KDReports::XmlHelper::readBackground(element);
@@ -291,6 +292,16 @@ bool KDReports::XmlParser::processNode(const QDomNode &node, KDReports::ReportBu
                 }
             }
 
+            if (m_recordModelBindings && boundColumn > -1) {
+                // An id set by the XmlElementHandler is bound to the column, so that associateTextValue still works on it
+                if (textElement.id().isEmpty())
+                    textElement.setId(QStringLiteral("kdreports-current-row-column-%1").arg(boundColumn));
+                const auto it = m_modelBindings.constFind(textElement.id());
+                if (it != m_modelBindings.cend() && *it != boundColumn)
+                    qWarning("The id %s is bound to model columns %d and %d, only the last one is used", qPrintable(textElement.id()), *it, boundColumn);
+                m_modelBindings.insert(textElement.id(), boundColumn);
+            }
+
             if (!builder) {
                 error(QObject::tr("<text> is only supported in WordProcessing mode"));
             } else {
@@ -636,7 +647,7 @@ QImage KDReports::XmlParser::extractImage(const QDomElement &element, QString *p
     return image;
 }
 
-QString KDReports::XmlParser::extractText(const QDomElement &element, QString *pId, const QAbstractItemModel *currentModel, int currentRow) const
+QString KDReports::XmlParser::extractText(const QDomElement &element, QString *pId, const QAbstractItemModel *currentModel, int currentRow, int *boundColumn) const
 {
     if (element.hasAttribute(QStringLiteral("id"))) {
         const QString id = element.attribute(QStringLiteral("id"));
@@ -650,12 +661,14 @@ QString KDReports::XmlParser::extractText(const QDomElement &element, QString *p
         QAbstractItemModel *model = KDReports::modelForKey(modelName);
         if (model) {
             int row;
+            const int column = element.attribute(QStringLiteral("column")).toInt();
             if (model == currentModel && currentRow > -1) {
                 row = currentRow;
+                if (boundColumn)
+                    *boundColumn = column;
             } else {
                 row = element.attribute(QStringLiteral("row")).toInt();
             }
-            const int column = element.attribute(QStringLiteral("column")).toInt();
             const QModelIndex index = model->index(row, column);
             return model->data(index).toString();
         }
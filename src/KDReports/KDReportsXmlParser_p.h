@@ -57,6 +57,18 @@ public:
 
     bool processDocument(const QDomDocument &document, KDReports::ReportBuilder *builder);
 
+    /// Gives an id to the text elements bound to the current row of the current model,
+    /// so that their values can be replaced for other rows (see Report::loadFromXMLForEachRow)
+    void setRecordModelBindings(bool record)
+    {
+        m_recordModelBindings = record;
+    }
+    /// \return the ids given to the text elements bound to the current row, and the column they show
+    QHash<QString, int> modelBindings() const
+    {
+        return m_modelBindings;
+    }
+
 private:
     bool processNode(const QDomNode &node, KDReports::ReportBuilder *builder, bool inHeader, bool inFooter);
     void addElement(KDReports::Element &reportElement, KDReports::ReportBuilder *builder, const QDomElement &element);
@@ -64,7 +76,7 @@ private:
     static void parseCommonTableAttributes(KDReports::AbstractTableElement &tableElement, QDomElement &element);
     void parseTabs(KDReports::ReportBuilder *builder, const QDomElement &element);
     void parseParagraphMargins(KDReports::ReportBuilder *builder, const QDomElement &element);
-    QString extractText(const QDomElement &element, QString *id, const QAbstractItemModel *currentModel = nullptr, int currentRow = -1) const;
+    QString extractText(const QDomElement &element, QString *id, const QAbstractItemModel *currentModel = nullptr, int currentRow = -1, int *boundColumn = nullptr) const;
     QImage extractImage(const QDomElement &element, QString *pId) const;
     bool testForErrorAndFillErrorDetails();
     void error(const QString &errorString);
@@ -74,6 +86,8 @@ private:
     XmlElementHandler *m_xmlElementHandler;
     KDReports::Report *m_report;
     ErrorDetails *m_errorDetails;
+    bool m_recordModelBindings = false;
+    QHash<QString, int> m_modelBindings;
 };
 
 }
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** This file is part of the KD Reports library.
+**
+** SPDX-FileCopyrightText: 2007 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include <KDReports>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace KDReports;
+namespace KDReports {
+class Test;
+}
+
+class KDReports::Test : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+private slots:
+    void benchmarkPdfExport_data()
+    {
+        QTest::addColumn<bool>("parallel");
+        QTest::newRow("exportToFile") << false;
+        QTest::newRow("exportToPdfParallel") << true;
+    }
+
+    void benchmarkPdfExport()
+    {
+        QFETCH(bool, parallel);
+        Report report;
+        report.setProgressDialogEnabled(false);
+        const QString paragraph = QStringLiteral("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(40);
+        for (int i = 0; i < 100; ++i) {
+            report.addElement(TextElement(paragraph));
+            report.addPageBreak();
+        }
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("benchmark.pdf"));
+        QBENCHMARK {
+            QVERIFY(parallel ? report.exportToPdfParallel(fileName) : report.exportToFile(fileName));
+        }
+    }
+};
+
+QTEST_MAIN(Test) // Report needs QPrinter needs a QApplication
+
+#include "Benchmarks.moc"
@@ -12,6 +12,7 @@
 #include <KDReportsReport_p.h>
 #include <KDReportsTextDocument_p.h>
 #include <QTest>
+#include <QTextCursor>
 
 using namespace KDReports;
 namespace KDReports {
@@ -127,6 +128,58 @@ private slots:
         header.addVariable(KDReports::PageNumber);
         QCOMPARE(report.numberOfPages(), 1);
     }
+
+    void testTextValueAfterVariable()
+    {
+        // The page number is rewritten for each page, the id after it must still be found
+        Report report;
+        report.setFirstPageNumber(1000);
+        Header &header = report.header();
+        header.addVariable(KDReports::PageNumber);
+        header.addInlineElement(TextElement(QStringLiteral(" ")));
+        TextElement title(QStringLiteral("Title"));
+        title.setId(QStringLiteral("title"));
+        header.addInlineElement(title);
+        report.addElement(TextElement(QStringLiteral("Body")));
+        QCOMPARE(report.numberOfPages(), 1);
+        QCOMPARE(header.doc().contentDocument().toPlainText(), QStringLiteral("1 Title"));
+
+        Header *pageHeader = nullptr;
+        Header *pageFooter = nullptr;
+        report.d->prepareHeadersForPage(0, &pageHeader, &pageFooter);
+        QCOMPARE(pageHeader, &header);
+        QCOMPARE(header.doc().contentDocument().toPlainText(), QStringLiteral("1000 Title"));
+
+        report.associateTextValue(QStringLiteral("title"), QStringLiteral("Changed"));
+        QCOMPARE(header.doc().contentDocument().toPlainText(), QStringLiteral("1000 Changed"));
+
+        // Same for direct modifications of the document
+        QTextCursor cursor(&header.doc().contentDocument());
+        cursor.insertText(QStringLiteral("Page "), QTextCharFormat());
+        report.associateTextValue(QStringLiteral("title"), QStringLiteral("Again"));
+        QCOMPARE(header.doc().contentDocument().toPlainText(), QStringLiteral("Page 1000 Again"));
+    }
+
+    void testTextValueInEditBlock()
+    {
+        // Inside beginEdit/endEdit the document only signals one change, at the end
+        Report report;
+        report.addElement(TextElement(QStringLiteral("Head")));
+        report.beginEdit();
+        // Same length, so only the revision tells that the edit block already started
+        QTextCursor cursor(report.mainTextDocument());
+        cursor.setPosition(1, QTextCursor::KeepAnchor);
+        cursor.insertText(QStringLiteral("J"));
+        TextElement body(QStringLiteral("Body"));
+        body.setId(QStringLiteral("body"));
+        report.addInlineElement(body);
+        report.addInlineElement(TextElement(QStringLiteral(" tail")));
+        report.endEdit();
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QStringLiteral("JeadBody tail"));
+
+        report.associateTextValue(QStringLiteral("body"), QStringLiteral("Text"));
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QStringLiteral("JeadText tail"));
+    }
 };
 
 QTEST_MAIN(Test) // Report needs QPrinter needs a QApplication
@@ -11,17 +11,68 @@
 #include <KDReports>
 #include <KDReportsReport_p.h>
 #include <KDReportsTextDocument_p.h>
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QFuture>
+#include <QHash>
+#include <QImageReader>
+#include <QMap>
+#include <QPicture>
+#include <QRegularExpression>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlTableModel>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QTextTableCell>
+#include <QtEndian>
+
+#if defined(HAVE_QTPDF) && QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+#include <QPdfDocument>
+#endif
 
 using namespace KDReports;
 namespace KDReports {
 class Test;
 }
 
+// Reads the objects of a PDF file back, from its cross-reference table.
+// Returns an empty map if an offset doesn't point to the object with the expected number.
+static QMap<int, QByteArray> pdfObjects(const QByteArray &pdf)
+{
+    const int startXRef = pdf.lastIndexOf("startxref");
+    if (startXRef < 0)
+        return {};
+    const int xrefOffset = pdf.mid(startXRef + 9, pdf.indexOf("%%EOF", startXRef) - startXRef - 9).trimmed().toInt();
+    const int trailerOffset = pdf.indexOf("trailer", xrefOffset);
+    if (pdf.mid(xrefOffset, 4) != "xref" || trailerOffset < 0)
+        return {};
+    // A single subsection starting at 0, as written by QPdfWriter and by the merger
+    const QList<QByteArray> tokens = pdf.mid(xrefOffset + 4, trailerOffset - xrefOffset - 4).simplified().split(' ');
+    const int count = tokens.value(1).toInt();
+    if (tokens.value(0) != "0" || tokens.size() != 2 + 3 * count)
+        return {};
+    QMap<int, QByteArray> objects;
+    for (int number = 1; number < count; ++number) {
+        if (tokens.at(2 + 3 * number + 2) != "n")
+            continue;
+        const int offset = tokens.at(2 + 3 * number).toInt();
+        const QByteArray prefix = QByteArray::number(number) + " 0 obj";
+        if (pdf.mid(offset, prefix.size()) != prefix)
+            return {};
+        objects.insert(number, pdf.mid(offset, pdf.indexOf("endobj", offset) - offset));
+    }
+    return objects;
+}
+
+// Returns the object number of the indirect reference following \p key in \p object, e.g. 3 for "/Root 3 0 R"
+static int pdfReference(const QByteArray &object, const QString &key)
+{
+    const QRegularExpressionMatch match = QRegularExpression(key + QStringLiteral("\\s+(\\d+)\\s+0\\s+R")).match(QString::fromLatin1(object));
+    return match.hasMatch() ? match.captured(1).toInt() : 0;
+}
+
 class KDReports::Test : public QObject
 {
     Q_OBJECT
@@ -162,35 +213,542 @@ private slots:
         QCOMPARE(cc.charFormat().font().pointSize(), 11);
     }
 
-#if 0 // not available in WordProcessingMode anymore
+    void testStreaming()
+    {
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QPrinter printer;
+        printer.setOutputFileName(tempDir.filePath(QStringLiteral("streaming.pdf")));
+
+        Report report;
+        QVERIFY(report.beginStreaming(&printer));
+        QImage image(20, 10, QImage::Format_RGB32);
+        image.fill(Qt::red);
+        for (int i = 0; i < 3; ++i) {
+            report.addElement(TextElement(QStringLiteral("Page %1").arg(i + 1)));
+            report.addElement(ImageElement(image));
+            QString imageName;
+            const QVector<QTextFormat> formats = report.mainTextDocument()->allFormats();
+            for (const QTextFormat &format : formats) {
+                if (format.isImageFormat())
+                    imageName = format.toImageFormat().name();
+            }
+            QVERIFY(!imageName.isEmpty());
+            report.addPageBreak();
+            // The page was printed and removed from the report, including its images
+            QCOMPARE(report.numberOfStreamedPages(), i + 1);
+            QVERIFY(report.mainTextDocument()->toPlainText().isEmpty());
+            QVERIFY(report.mainTextDocument()->resource(QTextDocument::ImageResource, QUrl(imageName)).isNull());
+        }
+        report.addElement(TextElement(QStringLiteral("Last page")));
+        QCOMPARE(report.numberOfPages(), 1);
+        QVERIFY(report.endStreaming());
+        QCOMPARE(report.numberOfStreamedPages(), 4);
+        QVERIFY(QFileInfo(printer.outputFileName()).size() > 0);
+    }
+
+    void testStreamingConsecutivePageBreaks()
+    {
+        // Same as without streaming: consecutive page breaks don't create empty pages
+        Report expected;
+        expected.addElement(TextElement(QStringLiteral("Page 1")));
+        expected.addPageBreak();
+        expected.addPageBreak();
+        expected.addElement(TextElement(QStringLiteral("Page 2")));
+        QCOMPARE(expected.numberOfPages(), 2);
+
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QPrinter printer;
+        printer.setOutputFileName(tempDir.filePath(QStringLiteral("pagebreaks.pdf")));
+        Report report;
+        QVERIFY(report.beginStreaming(&printer));
+        report.addPageBreak(); // nothing to print
+        QCOMPARE(report.numberOfStreamedPages(), 0);
+        report.addElement(TextElement(QStringLiteral("Page 1")));
+        report.addPageBreak();
+        report.addPageBreak();
+        QCOMPARE(report.numberOfStreamedPages(), 1);
+        // An empty element still gives an empty page, as documented in addPageBreak
+        report.addElement(TextElement());
+        report.addPageBreak();
+        QCOMPARE(report.numberOfStreamedPages(), 2);
+        report.addElement(TextElement(QStringLiteral("Page 3")));
+        QVERIFY(report.endStreaming());
+        QCOMPARE(report.numberOfStreamedPages(), 3);
+    }
+
+    void testExportPagesToImages()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("First page")));
+        report.addPageBreak();
+        report.addElement(TextElement(QStringLiteral("Second page")));
+        report.addPageBreak();
+        report.addElement(TextElement(QStringLiteral("Third page")));
+        QCOMPARE(report.numberOfPages(), 3);
+
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QVERIFY(report.exportPagesToImages(tempDir.path(), 72, "PNG", 1));
+        const QDir dir(tempDir.path());
+        QCOMPARE(dir.entryList(QDir::Files, QDir::Name), QStringList() << QStringLiteral("page-2.png") << QStringLiteral("page-3.png"));
+
+        // A4 at 72 dpi, i.e. its size in points
+        const QImage image(dir.filePath(QStringLiteral("page-2.png")));
+        QVERIFY(!image.isNull());
+        const QSize expectedSize = QPageSize(QPageSize::A4).sizePoints();
+        QVERIFY(qAbs(image.width() - expectedSize.width()) <= 1);
+        QVERIFY(qAbs(image.height() - expectedSize.height()) <= 1);
+    }
+
+    void testExportToPdf()
+    {
+        Report report;
+        QImage watermark(50, 50, QImage::Format_RGB32);
+        watermark.fill(Qt::gray);
+        report.setWatermarkImage(watermark);
+        for (int i = 0; i < 3; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            report.addElement(TextElement(QStringLiteral("Page %1").arg(i + 1)));
+        }
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToPdf(&buffer));
+        const QString pdf = QString::fromLatin1(buffer.data());
+        QVERIFY(pdf.startsWith(QLatin1String("%PDF-")));
+        QCOMPARE(pdf.count(QRegularExpression(QStringLiteral("/Type\\s*/Page\\b"))), 3);
+        // The watermark is stored once, and used on each page
+        QCOMPARE(pdf.count(QRegularExpression(QStringLiteral("/Subtype\\s*/Image\\b"))), 1);
+    }
+
+    void testIncrementalExport()
+    {
+        Report report;
+        for (int i = 0; i < 3; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            TextElement element(QStringLiteral("Page %1").arg(i + 1));
+            element.setId(QStringLiteral("page%1").arg(i + 1));
+            report.addElement(element);
+        }
+        report.setIncrementalExportEnabled(true);
+        QCOMPARE(report.changedPages(), QList<int>({0, 1, 2}));
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToPdf(&buffer));
+        QVERIFY(report.changedPages().isEmpty());
+
+        report.associateTextValue(QStringLiteral("page2"), QStringLiteral("Second page"));
+        QCOMPARE(report.changedPages(), QList<int>({1}));
+
+        QBuffer secondBuffer;
+        QVERIFY(secondBuffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToPdf(&secondBuffer));
+        QVERIFY(report.changedPages().isEmpty());
+        QCOMPARE(QString::fromLatin1(secondBuffer.data()).count(QRegularExpression(QStringLiteral("/Type\\s*/Page\\b"))), 3);
+    }
+
+    void testIncrementalExportResourcesAndCellFormats()
+    {
+        Report report;
+        QImage image(10, 10, QImage::Format_ARGB32);
+        image.fill(Qt::red);
+        report.addElement(ImageElement(image));
+        report.addPageBreak();
+        TableElement table;
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Cell")));
+        report.addElement(table);
+        report.setIncrementalExportEnabled(true);
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToPdf(&buffer));
+        QVERIFY(report.changedPages().isEmpty());
+
+        // Replacing the image resource under the same name changes the first page
+        QTextDocument *doc = report.mainTextDocument();
+        QTextCursor c(doc);
+        c.movePosition(QTextCursor::NextCharacter);
+        QVERIFY(c.charFormat().isImageFormat());
+        image.fill(Qt::blue);
+        doc->addResource(QTextDocument::ImageResource, QUrl(c.charFormat().toImageFormat().name()), image);
+        QCOMPARE(report.changedPages(), QList<int>({0}));
+        QVERIFY(report.exportToPdf(&buffer));
+
+        // So does changing the format of a table cell on the second page
+        c.movePosition(QTextCursor::End);
+        c.movePosition(QTextCursor::PreviousCharacter); // from the block after the table into its last cell
+        QTextTable *textTable = c.currentTable();
+        QVERIFY(textTable);
+        QTextTableCell cell = textTable->cellAt(0, 0);
+        QTextCharFormat cellFormat = cell.format();
+        cellFormat.setBackground(Qt::yellow);
+        cell.setFormat(cellFormat);
+        QCOMPARE(report.changedPages(), QList<int>({1}));
+    }
+
+    void testIncrementalExportTableAcrossPages()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("Before the table")));
+        TableElement table;
+        table.setHeaderRowCount(1);
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Header")));
+        for (int row = 1; row < 150; ++row)
+            table.cell(row, 0).addElement(TextElement(QStringLiteral("Row %1").arg(row)));
+        report.addElement(table);
+        const int pageCount = report.numberOfPages();
+        QVERIFY(pageCount > 2);
+        report.setIncrementalExportEnabled(true);
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToPdf(&buffer));
+        QVERIFY(report.changedPages().isEmpty());
+
+        // The header row is repeated on each page of the table
+        QTextCursor c(report.mainTextDocument());
+        c.movePosition(QTextCursor::NextBlock);
+        QTextTable *textTable = c.currentTable();
+        QVERIFY(textTable);
+        QTextCursor headerCursor = textTable->cellAt(0, 0).lastCursorPosition();
+        headerCursor.insertText(QStringLiteral(" text"));
+        QList<int> allPages;
+        for (int page = 0; page < pageCount; ++page)
+            allPages.append(page);
+        QCOMPARE(report.changedPages(), allPages);
+    }
+
+    void testPageCache()
+    {
+        Report report;
+        for (int i = 0; i < 3; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            TextElement element(QStringLiteral("Page %1").arg(i + 1));
+            element.setId(QStringLiteral("page%1").arg(i + 1));
+            report.addElement(element);
+        }
+        QCOMPARE(report.pageCacheSize(), 16 * 1024);
+        const QPicture first = report.d->pagePicture(0);
+        const QPicture second = report.d->pagePicture(1);
+        QCOMPARE(report.d->m_pageCache.count(), 2);
+        // Replayed from the cache, i.e. the same recording
+        QCOMPARE(report.d->pagePicture(0).data(), first.data());
+
+        // Modifying the document drops the recorded pages
+        report.associateTextValue(QStringLiteral("page2"), QStringLiteral("Second page"));
+        QCOMPARE(report.d->m_pageCache.count(), 0);
+        QVERIFY(report.d->pagePicture(1).data() != second.data());
+
+        // So does layouting the report again
+        report.setPageSize(QPageSize::A5);
+        QCOMPARE(report.numberOfPages(), 3);
+        QCOMPARE(report.d->m_pageCache.count(), 0);
+
+        report.setPageCacheSize(0);
+        QCOMPARE(report.d->m_pageCache.count(), 0);
+        QVERIFY(!report.d->pagePicture(2).isNull());
+        QCOMPARE(report.d->m_pageCache.count(), 0);
+    }
+
+    void testAnchors()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("First page")));
+        report.addPageBreak();
+        report.addElement(HtmlElement(QStringLiteral("Go to <a href=\"https://www.kdab.com\">KDAB</a> now")));
+        QCOMPARE(report.numberOfPages(), 2);
+        QVERIFY(report.anchors(0).isEmpty());
+
+        const QList<QPair<QRect, QString>> anchors = report.anchors(1);
+        QCOMPARE(anchors.size(), 1);
+        const QRect rect = anchors.first().first;
+        QCOMPARE(anchors.first().second, QStringLiteral("https://www.kdab.com"));
+        QCOMPARE(report.anchorAt(1, rect.center()), QStringLiteral("https://www.kdab.com"));
+        QVERIFY(report.anchorAt(0, rect.center()).isEmpty());
+        QVERIFY(report.anchorAt(1, rect.center() - QPoint(rect.width(), 0)).isEmpty());
+
+        // The index follows changes to the document
+        report.addElement(HtmlElement(QStringLiteral("<a href=\"https://www.qt.io\">Qt</a>")));
+        QCOMPARE(report.anchors(1).size(), 2);
+    }
+
+    void testPageTextIndex()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("First page")));
+        report.addPageBreak();
+        report.addElement(TextElement(QStringLiteral("Find me on the second page")));
+        QCOMPARE(report.numberOfPages(), 2);
+
+        const PageTextIndex index = report.d->pageTextIndex();
+        const int first = index.text.indexOf(QStringLiteral("First"));
+        const int position = index.text.indexOf(QStringLiteral("me"));
+        QVERIFY(first >= 0);
+        QVERIFY(position > first);
+        QCOMPARE(index.pageAt(first), 0);
+        QCOMPARE(index.pageAt(position), 1);
+
+        const QVector<QRect> rects = report.d->textRects(1, position, 2);
+        QCOMPARE(rects.size(), 1);
+        QVERIFY(!rects.first().isEmpty());
+        QVERIFY(report.d->textRects(0, position, 2).isEmpty());
+        // Same coordinates as the hyperlinks
+        QVERIFY(report.d->textRects(1, index.text.indexOf(QStringLiteral("Find")), 4).first().right() <= rects.first().left());
+
+        // The index follows changes to the document
+        report.addElement(TextElement(QStringLiteral("Added")));
+        QCOMPARE(report.d->pageTextIndex().pageAt(report.d->pageTextIndex().text.indexOf(QStringLiteral("Added"))), 1);
+    }
+
+    void testSamePageGeometry()
+    {
+        Report report;
+        report.setPageSize(QPageSize::A4);
+        report.addElement(TextElement(QStringLiteral("Hello")));
+        QCOMPARE(report.numberOfPages(), 1);
+        QVERIFY(!report.d->m_pageContentSizeDirty);
+
+        // Setting the same geometry again keeps the layout
+        report.setPageSize(QPageSize(QPageSize::A4));
+        report.setPageOrientation(QPageLayout::Portrait);
+        report.setWidthForEndlessPrinter(0);
+        QVERIFY(!report.d->m_pageContentSizeDirty);
+
+        report.setPageOrientation(QPageLayout::Landscape);
+        QVERIFY(report.d->m_pageContentSizeDirty);
+        QCOMPARE(report.numberOfPages(), 1);
+
+        // Printing restores the geometry of the report
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QPrinter printer;
+        printer.setOutputFileName(tempDir.filePath(QStringLiteral("geometry.pdf")));
+        printer.setPageSize(QPageSize(QPageSize::A5));
+        report.setProgressDialogEnabled(false);
+        QVERIFY(report.print(&printer));
+        QCOMPARE(report.pageSize(), QPageSize(QPageSize::A4));
+        QCOMPARE(report.pageOrientation(), QPageLayout::Landscape);
+        QVERIFY(report.d->m_pageContentSizeDirty);
+    }
+
+    void testExportToTiff()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("A poster")));
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("poster.tif"));
+        const QSize size(3000, 4000); // several strips
+        QVERIFY(report.exportToTiff(size, fileName, 2));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray tiff = file.readAll();
+        file.close();
+        QCOMPARE(tiff.left(4), QByteArray("II*\0", 4));
+
+        // The resolution, in dots per inch, is the same in both directions
+        const char *data = tiff.constData();
+        const quint32 ifdOffset = qFromLittleEndian<quint32>(data + 4);
+        QHash<quint16, quint32> entries; // the value, or the offset of the values
+        for (int i = 0; i < qFromLittleEndian<quint16>(data + ifdOffset); ++i) {
+            const char *entry = data + ifdOffset + 2 + 12 * i;
+            const bool isShort = qFromLittleEndian<quint16>(entry + 2) == 3;
+            entries.insert(qFromLittleEndian<quint16>(entry), isShort ? qFromLittleEndian<quint16>(entry + 8) : qFromLittleEndian<quint32>(entry + 8));
+        }
+        QCOMPARE(entries.value(296), quint32(2)); // ResolutionUnit: inch
+        QVERIFY(entries.contains(282));
+        QVERIFY(entries.contains(283));
+        auto rational = [data](quint32 offset) {
+            return qreal(qFromLittleEndian<quint32>(data + offset)) / qFromLittleEndian<quint32>(data + offset + 4);
+        };
+        const qreal dpi = rational(entries.value(282));
+        QVERIFY(dpi > 0);
+        QCOMPARE(rational(entries.value(283)), dpi);
+
+        if (QImageReader::supportedImageFormats().contains("tiff")) {
+            const QImage image(fileName);
+            QCOMPARE(image.size(), size);
+            QCOMPARE(image.dotsPerMeterX(), qRound(dpi / 0.0254));
+            QCOMPARE(image.pixel(0, 0), qRgb(255, 255, 255));
+            QCOMPARE(image.pixel(size.width() - 1, size.height() - 1), qRgb(255, 255, 255));
+        }
+    }
+
+    void testExportToPdfParallel()
+    {
+        Report report;
+        for (int i = 0; i < 9; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            report.addElement(TextElement(QStringLiteral("Page %1").arg(i + 1)));
+        }
+        QCOMPARE(report.numberOfPages(), 9);
+
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("parallel.pdf"));
+        QVERIFY(report.exportToPdfParallel(fileName, 4)); // 3 documents of 3 pages, merged
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QString pdf = QString::fromLatin1(file.readAll());
+        QVERIFY(pdf.startsWith(QLatin1String("%PDF-")));
+        QVERIFY(pdf.endsWith(QLatin1String("%%EOF\n")));
+        QCOMPARE(pdf.count(QRegularExpression(QStringLiteral("/Type\\s*/Page\\b(?!s)"))), 9);
+        QCOMPARE(pdf.count(QRegularExpression(QStringLiteral("/Type\\s*/Pages\\b"))), 1);
+        QCOMPARE(pdf.count(QRegularExpression(QStringLiteral("/Type\\s*/Catalog\\b"))), 1);
+        QVERIFY(pdf.contains(QRegularExpression(QStringLiteral("/Count\\s+9\\b"))));
+    }
+
+    void testExportToPdfParallelReadBack()
+    {
+        Report report;
+        for (int i = 0; i < 9; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            report.addElement(TextElement(QStringLiteral("Page %1").arg(i + 1)));
+        }
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("parallel.pdf"));
+        QVERIFY(report.exportToPdfParallel(fileName, 4));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray pdf = file.readAll();
+
+        const QMap<int, QByteArray> objects = pdfObjects(pdf);
+        QVERIFY(!objects.isEmpty());
+        const int catalog = pdfReference(pdf.mid(pdf.lastIndexOf("trailer")), QStringLiteral("/Root"));
+        QVERIFY(objects.value(catalog).contains("/Catalog"));
+        const int pageTree = pdfReference(objects.value(catalog), QStringLiteral("/Pages"));
+        const QString pageTreeObject = QString::fromLatin1(objects.value(pageTree));
+        QVERIFY(pageTreeObject.contains(QRegularExpression(QStringLiteral("/Count\\s+9\\b"))));
+
+        // The pages of all the ranges, in order, each one with its own content
+        const QString kids = QRegularExpression(QStringLiteral("/Kids\\s*\\[([^\\]]*)\\]")).match(pageTreeObject).captured(1);
+        QRegularExpressionMatchIterator pageRefs = QRegularExpression(QStringLiteral("(\\d+)\\s+0\\s+R")).globalMatch(kids);
+        QVector<int> contents;
+        while (pageRefs.hasNext()) {
+            const QByteArray page = objects.value(pageRefs.next().captured(1).toInt());
+            QVERIFY(QString::fromLatin1(page).contains(QRegularExpression(QStringLiteral("/Type\\s*/Page\\b(?!s)"))));
+            QCOMPARE(pdfReference(page, QStringLiteral("/Parent")), pageTree);
+            const int content = pdfReference(page, QStringLiteral("/Contents"));
+            QVERIFY(objects.value(content).contains("stream"));
+            QVERIFY(!contents.contains(content));
+            contents.append(content);
+        }
+        QCOMPARE(contents.size(), 9);
+
+        // Every reference points to an object of the merged document
+        for (const QByteArray &object : objects) {
+            const QByteArray dictionary = object.left(object.indexOf("stream"));
+            QRegularExpressionMatchIterator refs = QRegularExpression(QStringLiteral("(\\d+)\\s+0\\s+R\\b")).globalMatch(QString::fromLatin1(dictionary));
+            while (refs.hasNext()) {
+                const int number = refs.next().captured(1).toInt();
+                QVERIFY2(objects.contains(number), dictionary.constData());
+            }
+        }
+
+#if defined(HAVE_QTPDF) && QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+        QPdfDocument document;
+        QCOMPARE(document.load(fileName), QPdfDocument::Error::None);
+        QCOMPARE(document.pageCount(), 9);
+        for (int i = 0; i < 9; ++i)
+            QVERIFY(document.getAllText(i).text().contains(QStringLiteral("Page %1").arg(i + 1)));
+#endif
+    }
+
+    void testExportToFileAsync()
+    {
+        Report report;
+        for (int i = 0; i < 3; ++i) {
+            if (i > 0)
+                report.addPageBreak();
+            report.addElement(TextElement(QStringLiteral("Page %1").arg(i + 1)));
+        }
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("async.pdf"));
+
+        QFuture<bool> future = report.exportToFileAsync(fileName);
+        future.waitForFinished();
+        QVERIFY(!future.isCanceled());
+        QVERIFY(future.result());
+        QCOMPARE(future.progressMaximum(), 3);
+        QCOMPARE(future.progressValue(), 3);
+        QVERIFY(QFileInfo(fileName).size() > 0);
+
+        // Canceling before it starts (it waits for the previous operation on the same report)
+        QFuture<bool> blocker = report.exportToFileAsync(tempDir.filePath(QStringLiteral("first.pdf")));
+        QFuture<bool> canceled = report.exportPagesToImagesAsync(tempDir.path());
+        canceled.cancel();
+        blocker.waitForFinished();
+        canceled.waitForFinished();
+        QVERIFY(canceled.isCanceled());
+        QVERIFY(blocker.result());
+    }
+
     void testScaleNoTables()
     {
         Report report;
-        report.setDefaultFont( QFont( QLatin1String( "Helvetica" ), 48 ) );
-        TextElement elem( QString::fromLatin1( "foo" ) );
-        while ( report.numberOfPages() < 3 ) {
-            report.addElement( elem );
+        report.setDefaultFont(QFont(QStringLiteral("Helvetica"), 48));
+        TextElement elem(QStringLiteral("foo"));
+        while (report.numberOfPages() < 3) {
+            report.addElement(elem);
         }
-        QCOMPARE( report.numberOfPages(), 3 );
-        report.scaleTo( 0 /*doesn't make sense, but scaleTo corrects it*/, 2 );
-        QCOMPARE( report.numberOfPages(), 2 );
-        report.scaleTo( 1, 2 );
-        QCOMPARE( report.numberOfPages(), 2 );
-        report.scaleTo( 2, 2 );
-        QCOMPARE( report.numberOfPages(), 2 ); // there are no tables, therefore it must fit in 2 pages, can't use the other 2.
-        report.scaleTo( 1, 1 );
-        QCOMPARE( report.numberOfPages(), 1 );
-        report.scaleTo( 1, 0 /*no max limit*/ );
-        QCOMPARE( report.numberOfPages(), 3 );
+        QCOMPARE(report.numberOfPages(), 3);
+        report.scaleTo(1, 2);
+        QCOMPARE(report.numberOfPages(), 2);
+        QCOMPARE(report.maximumNumberOfPagesForVerticalScaling(), 2);
+        QVERIFY(report.isTableBreakingEnabled());
+        report.scaleTo(1, 1);
+        QCOMPARE(report.numberOfPages(), 1);
+        report.scaleTo(1, 0 /*no max limit*/);
+        QCOMPARE(report.numberOfPages(), 3);
+        QVERIFY(!report.isTableBreakingEnabled());
 
         // Now using font scaling directly.
-        QCOMPARE( report.fontScalingFactor(), 1.0 );
-        report.setTableBreakingEnabled( false );
-        report.setFontScalingFactor( 0.1 );
-        QCOMPARE( report.fontScalingFactor(), 0.1 );
-        QCOMPARE( report.numberOfPages(), 1 );
+        QCOMPARE(report.fontScalingFactor(), 1.0);
+        report.setFontScalingFactor(0.1);
+        QCOMPARE(report.fontScalingFactor(), 0.1);
+        QCOMPARE(report.numberOfPages(), 1);
+        report.setFontScalingFactor(1.0);
+        QCOMPARE(report.numberOfPages(), 3);
+    }
+
+    void testScaleThenAddContents()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("Before")));
+        report.setFontScalingFactor(0.5);
+        QCOMPARE(report.numberOfPages(), 1); // applies the factor
+        report.addElement(TextElement(QStringLiteral("After")));
+        QCOMPARE(report.numberOfPages(), 1);
+
+        QTextDocument *doc = report.mainTextDocument();
+        const qreal unscaled = doc->defaultFont().pointSize();
+        auto pointSizeAt = [doc](QTextCursor::MoveOperation operation) {
+            QTextCursor c(doc);
+            c.movePosition(operation);
+            if (operation == QTextCursor::Start)
+                c.movePosition(QTextCursor::NextCharacter);
+            return c.charFormat().fontPointSize();
+        };
+        // The new contents are scaled too
+        QCOMPARE(pointSizeAt(QTextCursor::Start), unscaled * 0.5);
+        QCOMPARE(pointSizeAt(QTextCursor::End), unscaled * 0.5);
+
+        // And both are unscaled again
+        report.setFontScalingFactor(1.0);
+        QCOMPARE(report.numberOfPages(), 1);
+        QCOMPARE(pointSizeAt(QTextCursor::Start), unscaled);
+        QCOMPARE(pointSizeAt(QTextCursor::End), unscaled);
     }
-#endif
 };
 
 QTEST_MAIN(Test) // Report needs QPrinter needs a QApplication
@@ -12,6 +12,7 @@
 #include <KDReportsFontScaler_p.h>
 #include <KDReportsReport_p.h>
 #include <KDReportsTextDocument_p.h>
+#include <QBuffer>
 #include <QStandardItemModel>
 #include <QTemporaryFile>
 #include <QTest>
@@ -453,6 +454,55 @@ private slots:
 #endif
     }
 
+    void testExportTableData()
+    {
+        QStandardItemModel model(2, 2);
+        model.setHorizontalHeaderLabels({QStringLiteral("Name"), QStringLiteral("Price")});
+        model.setItem(0, 0, new QStandardItem(QStringLiteral("Fish, \"fresh\"")));
+        model.setItem(0, 1, new QStandardItem);
+        model.item(0, 1)->setData(5, Qt::DisplayRole);
+        model.setItem(1, 0, new QStandardItem(QStringLiteral("Chips & <dip>")));
+        model.setItem(1, 1, new QStandardItem);
+        model.item(1, 1)->setData(2.5, Qt::DisplayRole);
+        Report report;
+        report.setReportMode(Report::SpreadSheet);
+        report.setDocumentName(QStringLiteral("Menu"));
+        AutoTableElement tableElement(&model);
+        tableElement.setVerticalHeaderVisible(false);
+        report.mainTable()->setAutoTableElement(tableElement);
+
+        QBuffer csv;
+        QVERIFY(csv.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToCsv(&csv));
+        QCOMPARE(csv.data(), QByteArray("Name,Price\r\n\"Fish, \"\"fresh\"\"\",5\r\nChips & <dip>,2.5\r\n"));
+
+        QBuffer xml;
+        QVERIFY(xml.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToSpreadsheetXml(&xml));
+        const QString spreadsheet = QString::fromUtf8(xml.data());
+        QVERIFY(spreadsheet.contains(QLatin1String("<Worksheet ss:Name=\"Menu\">")));
+        QVERIFY(spreadsheet.contains(QLatin1String("<Cell ss:StyleID=\"Header\"><Data ss:Type=\"String\">Price</Data></Cell>")));
+        QVERIFY(spreadsheet.contains(QLatin1String("<Data ss:Type=\"String\">Chips &amp; &lt;dip&gt;</Data>")));
+        QVERIFY(spreadsheet.contains(QLatin1String("<Data ss:Type=\"Number\">2.5</Data>")));
+        QCOMPARE(spreadsheet.count(QLatin1String("<Row>")), 3);
+
+        // Not available in WordProcessing mode
+        Report wordProcessingReport;
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QTest::ignoreMessage(QtWarningMsg, "exportToCsv is only supported in SpreadSheet mode");
+        QVERIFY(!wordProcessingReport.exportToCsv(&buffer));
+
+        // Nothing to export without a main table
+        Report emptyReport;
+        emptyReport.setReportMode(Report::SpreadSheet);
+        QTest::ignoreMessage(QtWarningMsg, "exportToCsv: the main table has no model, see Report::mainTable()");
+        QVERIFY(!emptyReport.exportToCsv(&buffer));
+        QTest::ignoreMessage(QtWarningMsg, "exportToSpreadsheetXml: the main table has no model, see Report::mainTable()");
+        QVERIFY(!emptyReport.exportToSpreadsheetXml(&buffer));
+        QVERIFY(buffer.data().isEmpty());
+    }
+
     void testScaleTables()
     {
         QSKIP("Test is too flaky for CI");
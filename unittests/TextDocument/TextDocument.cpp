@@ -10,13 +10,17 @@
 
 #include <KDReports>
 #include <KDReportsTextDocument_p.h>
+#include <QBuffer>
+#include <QRegularExpression>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlTableModel>
 #include <QStandardItemModel>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QTextCursor>
 #include <QTextTableCell>
+#include <QXmlStreamReader>
 
 using namespace KDReports;
 namespace KDReports {
@@ -522,6 +526,39 @@ private slots:
         QCOMPARE(report.numberOfPages(), 1);
     }
 
+    void testUpdatePercentSizesAfterPageSizeChange()
+    {
+        Report report;
+        report.setTabPositions({Report::rightAlignedTab()});
+        report.addElement(TextElement("Left\tRight"));
+        QPixmap pix(100, 50);
+        pix.fill(Qt::black);
+        KDReports::ImageElement imageElement(pix);
+        imageElement.setWidth(50, KDReports::Percent);
+        report.addElement(imageElement);
+
+        QTextDocument &doc = *report.mainTextDocument();
+        const QTextFrameFormat rootFrameFormat = doc.rootFrame()->frameFormat();
+        const qreal rootFrameMargins = rootFrameFormat.leftMargin() + rootFrameFormat.rightMargin();
+        auto checkSizes = [&]() {
+            const qreal pageWidth = doc.pageSize().width();
+            QCOMPARE(doc.firstBlock().blockFormat().tabPositions().first().position, pageWidth - rootFrameMargins);
+            QTextCursor c(&doc);
+            c.setPosition(doc.lastBlock().position() + 1);
+            QVERIFY(c.charFormat().isImageFormat());
+            QCOMPARE(c.charFormat().toImageFormat().width(), pageWidth / 2);
+        };
+
+        QCOMPARE(report.numberOfPages(), 1);
+        checkSizes();
+
+        // Only the recorded image and block should be updated, but they must be updated
+        report.setPageSize(QPageSize::A5);
+        report.setPageOrientation(QPageLayout::Landscape);
+        QCOMPARE(report.numberOfPages(), 1);
+        checkSizes();
+    }
+
     void testSetFontFullyQualified()
     {
         Report report;
@@ -550,6 +587,187 @@ private slots:
         QVERIFY(c.charFormat().font().bold());
     }
 
+    void testExportToHtml()
+    {
+        Report report;
+        TextElement title(QStringLiteral("Fish & <Chips>"));
+        title.setBold(true);
+        report.addElement(title, Qt::AlignHCenter);
+        report.addPageBreak();
+        TableElement table;
+        table.setHeaderRowCount(1);
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Header")));
+        table.cell(1, 0).addElement(TextElement(QStringLiteral("Value")));
+        report.addElement(table);
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToHtml(&buffer));
+        const QString html = QString::fromUtf8(buffer.data());
+        QVERIFY(html.startsWith(QLatin1String("<!DOCTYPE html>")));
+        QVERIFY(html.contains(QLatin1String("<p style=\"text-align:center; page-break-after:always;\"><span style=\"font-weight:bold;\">Fish &amp; &lt;Chips&gt;</span></p>")));
+        const int headerPos = html.indexOf(QLatin1String(">Header</"));
+        QVERIFY(headerPos > html.indexOf(QLatin1String("<thead>")));
+        QVERIFY(headerPos < html.indexOf(QLatin1String("</thead>")));
+        QVERIFY(html.indexOf(QLatin1String(">Value</")) > html.indexOf(QLatin1String("</thead>")));
+        QVERIFY(html.endsWith(QLatin1String("</body>\n</html>\n")));
+        // No leftovers from QTextDocument::toHtml
+        QVERIFY(!html.contains(QLatin1String("-qt-")));
+        QVERIFY(!html.contains(QLatin1String("style=\"\"")));
+    }
+
+    void testExportToMarkdown()
+    {
+        Report report;
+        TextElement title(QStringLiteral("Fish & <Chips>"));
+        title.setBold(true);
+        report.addElement(title);
+        TableElement table;
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Name")));
+        table.cell(0, 1).addElement(TextElement(QStringLiteral("Price")));
+        table.cell(1, 0).addElement(TextElement(QStringLiteral("Cod")));
+        table.cell(1, 1).addElement(TextElement(QStringLiteral("5")));
+        report.addElement(table);
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToMarkdown(&buffer));
+        const QString markdown = QString::fromUtf8(buffer.data());
+        QVERIFY(markdown.contains(QLatin1String("**Fish & \\<Chips\\>**\n\n")));
+        QVERIFY(markdown.contains(QLatin1String("| Name | Price |\n| --- | --- |\n| Cod | 5 |\n")));
+    }
+
+    void testExportToMarkdownEscapesBlockMarkers()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("- not a list")));
+        report.addElement(TextElement(QStringLiteral("  + not a list either")));
+        report.addElement(TextElement(QStringLiteral("1. not numbered")));
+        report.addElement(TextElement(QStringLiteral("# not a title") + QChar(QChar::LineSeparator) + QStringLiteral("> not a quote")));
+        report.addElement(TextElement(QStringLiteral("From 1 - 2.")));
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToMarkdown(&buffer));
+        const QString markdown = QString::fromUtf8(buffer.data());
+        QVERIFY(markdown.contains(QLatin1String("\\- not a list\n\n")));
+        QVERIFY(markdown.contains(QLatin1String("  \\+ not a list either\n\n")));
+        QVERIFY(markdown.contains(QLatin1String("1\\. not numbered\n\n")));
+        QVERIFY(markdown.contains(QLatin1String("\\# not a title\\\n\\> not a quote\n\n")));
+        QVERIFY(markdown.contains(QLatin1String("From 1 - 2.\n\n")));
+    }
+
+    void testExportToOdt()
+    {
+        Report report;
+        report.setDocumentName(QStringLiteral("Menu"));
+        TextElement title(QStringLiteral("Fish & <Chips>"));
+        title.setBold(true);
+        report.addElement(title, Qt::AlignHCenter);
+        QImage image(20, 10, QImage::Format_RGB32);
+        image.fill(Qt::red);
+        const ImageElement imageElement(image);
+        report.addElement(imageElement);
+        report.addElement(imageElement);
+        TableElement table;
+        table.setHeaderRowCount(1);
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Header")));
+        table.cell(1, 0).addElement(TextElement(QStringLiteral("Value")));
+        report.addElement(table);
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(report.exportToOdt(&buffer));
+
+        QXmlStreamReader reader(buffer.data());
+        QStringList paragraphs;
+        int images = 0;
+        int cells = 0;
+        while (!reader.atEnd()) {
+            if (reader.readNext() != QXmlStreamReader::StartElement)
+                continue;
+            if (reader.qualifiedName() == QLatin1String("draw:frame"))
+                ++images;
+            else if (reader.qualifiedName() == QLatin1String("table:table-cell"))
+                ++cells;
+            else if (reader.qualifiedName() == QLatin1String("text:p"))
+                paragraphs.append(reader.readElementText(QXmlStreamReader::IncludeChildElements));
+        }
+        QVERIFY2(!reader.hasError(), qPrintable(reader.errorString()));
+        QVERIFY(paragraphs.contains(QStringLiteral("Fish & <Chips>")));
+        QVERIFY(paragraphs.contains(QStringLiteral("Value")));
+        QCOMPARE(images, 2);
+        QCOMPARE(cells, 2);
+        // The image is embedded once, and both frames refer to it
+        const QByteArray odt = buffer.data();
+        QCOMPARE(odt.count("<draw:fill-image draw:name=\"Image1\">"), 1);
+        QCOMPARE(odt.count("draw:fill-image-name=\"Image1\""), 1);
+        QCOMPARE(odt.count("draw:style-name=\"Gr1\""), 2);
+        QCOMPARE(odt.count("<office:binary-data>"), 1);
+        const int dataStart = odt.indexOf("<office:binary-data>") + 20;
+        const QByteArray imageData = odt.mid(dataStart, odt.indexOf("</office:binary-data>") - dataStart);
+        QVERIFY(!QImage::fromData(QByteArray::fromBase64(imageData)).isNull());
+    }
+
+    void testToHtmlWithImages()
+    {
+        Report report;
+        QImage image(20, 10, QImage::Format_RGB32);
+        image.fill(Qt::red);
+        const ImageElement imageElement(image);
+        report.addElement(imageElement);
+        report.addElement(imageElement);
+        const QString documentHtml = report.mainTextDocument()->toHtml();
+
+        const QString html = report.toHtml();
+        // Encoded once, used twice
+        const QRegularExpression dataUrl(QStringLiteral("<img src=\"(data:image/png;base64,[^\"]+)\""));
+        QRegularExpressionMatchIterator it = dataUrl.globalMatch(html);
+        QStringList urls;
+        while (it.hasNext())
+            urls.append(it.next().captured(1));
+        QCOMPARE(urls.size(), 2);
+        QCOMPARE(urls.at(0), urls.at(1));
+        // The document isn't modified, so this can be called again
+        QCOMPARE(report.mainTextDocument()->toHtml(), documentHtml);
+        QCOMPARE(report.toHtml(), html);
+    }
+
+    void testToHtmlMatchesQTextDocument()
+    {
+        Report report;
+        report.addElement(TextElement(QStringLiteral("Name\tPrice")));
+        TableElement table;
+        table.setBorder(2);
+        table.setPadding(5);
+        table.cell(0, 0).addElement(TextElement(QStringLiteral("Cod")));
+        table.cell(0, 1).addElement(TextElement(QStringLiteral("5")));
+        report.addElement(table);
+
+        // The output of QTextDocument::toHtml, with the same cleanups as before the streaming HTML writer
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        QString expected = report.mainTextDocument()->toHtml("utf-8");
+#else
+        QString expected = report.mainTextDocument()->toHtml();
+#endif
+        expected.remove(QLatin1String("margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; "));
+        expected.remove(QLatin1String("-qt-block-indent:0; "));
+        expected.remove(QLatin1String("text-indent:0px;"));
+        expected.remove(QLatin1String("style=\"\""));
+        expected.remove(QLatin1String("style=\" \""));
+        QCOMPARE(report.toHtml(), expected);
+        QVERIFY(expected.contains(QLatin1String("cellpadding=")));
+        QVERIFY(expected.contains(QLatin1String("border=\"2\"")));
+
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString fileName = tempDir.filePath(QStringLiteral("report.html"));
+        QVERIFY(report.exportToHtml(fileName));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(QString::fromUtf8(file.readAll()), expected);
+    }
+
 private:
     static void setFontSizeHelper(QTextCursor &lastCursor, int endPosition, qreal pointSize, qreal factor)
     {
@@ -22,6 +22,28 @@ namespace KDReports {
 class Test;
 }
 
+// Gives an id to the text elements showing the first column of the model
+class IdXmlElementHandler : public KDReports::XmlElementHandler
+{
+public:
+    bool textElement(KDReports::TextElement &textElement, QDomElement &xmlElement) override
+    {
+        if (xmlElement.hasAttribute(QStringLiteral("model")) && xmlElement.attribute(QStringLiteral("column")) == QLatin1String("0"))
+            textElement.setId(QStringLiteral("name"));
+        return true;
+    }
+};
+
+// Skips the text elements which are empty, e.g. in some rows of the model
+class SkipEmptyXmlElementHandler : public KDReports::XmlElementHandler
+{
+public:
+    bool textElement(KDReports::TextElement &textElement, QDomElement &) override
+    {
+        return !textElement.text().isEmpty();
+    }
+};
+
 class KDReports::Test : public QObject
 {
     Q_OBJECT
@@ -66,6 +88,149 @@ private slots:
         QCOMPARE(report.mainTextDocument()->toPlainText(), QString("Newer Title .\nchanged\nworks\nwell"));
     }
 
+    void testTextValuesBatch()
+    {
+        QFile file(":/textid.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        Report report;
+        report.associateTextValue("1", "Ti");
+        report.associateTextValue("2", "tle");
+        QVERIFY(report.loadFromXML(&file));
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QString("Title .\nunused text\n\n"));
+
+        // All values replaced in one go, including ids that come before other modified ones
+        QHash<QString, QString> values;
+        values.insert("1", "New Ti");
+        values.insert("3", "changed");
+        values.insert("4", "works");
+        values.insert("5", "well");
+        values.insert("unknown", "ignored");
+        report.associateTextValues(values);
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QString("New Title .\nchanged\nworks\nwell"));
+
+        // And the positions are still correct afterwards
+        values.clear();
+        values.insert("2", "TLE");
+        values.insert("4", "");
+        report.associateTextValues(values);
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QString("New TiTLE .\nchanged\n\nwell"));
+        report.associateTextValue("5", "done");
+        QCOMPARE(report.mainTextDocument()->toPlainText(), QString("New TiTLE .\nchanged\n\ndone"));
+    }
+
+    void testLoadFromXMLForEachRow()
+    {
+        QStandardItemModel model;
+        model.setItem(0, 0, new QStandardItem("Ann"));
+        model.setItem(0, 1, new QStandardItem("ann@example.com"));
+        model.setItem(1, 0, new QStandardItem("Bob"));
+        model.setItem(1, 1, new QStandardItem("bob@example.com"));
+        model.setItem(2, 0, new QStandardItem("Carlotta"));
+        model.setItem(2, 1, new QStandardItem(""));
+        QFile file(":/mailmerge.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+
+        // The slow way: parsing and building the XML for each row
+        Report expected;
+        expected.associateModel("members", &model);
+        for (int row = 0; row < model.rowCount(); ++row) {
+            expected.setCurrentRow(&model, row);
+            QVERIFY(expected.loadFromXML(&file));
+            if (row < model.rowCount() - 1)
+                expected.addPageBreak();
+        }
+
+        Report report;
+        QVERIFY(report.loadFromXMLForEachRow(&file, &model));
+        QTextDocument &doc = *report.mainTextDocument();
+        QCOMPARE(doc.toPlainText(), expected.mainTextDocument()->toPlainText());
+        QCOMPARE(doc.blockCount(), expected.mainTextDocument()->blockCount());
+        QCOMPARE(report.numberOfPages(), 3);
+
+        // The formatting of the bound text elements is copied too
+        QTextCursor c = doc.find(QStringLiteral("Bob"));
+        QVERIFY(!c.isNull());
+        QVERIFY(c.charFormat().fontWeight() == QFont::Bold);
+
+        // The text values are available in all the copies
+        report.associateTextValue("greeting", "Hi");
+        const QString text = doc.toPlainText();
+        QVERIFY(text.contains(QStringLiteral("HiAnn")));
+        QVERIFY(text.contains(QStringLiteral("HiBob")));
+        QVERIFY(text.contains(QStringLiteral("HiCarlotta")));
+        QVERIFY(!text.contains(QStringLiteral("Hello")));
+    }
+
+    void testLoadFromXMLForEachRowWithIds()
+    {
+        QStandardItemModel model;
+        model.setItem(0, 0, new QStandardItem(QString())); // empty in the row the template is made from
+        model.setItem(0, 1, new QStandardItem("ann@example.com"));
+        model.setItem(1, 0, new QStandardItem("Bob"));
+        model.setItem(1, 1, new QStandardItem("bob@example.com"));
+        QFile file(":/mailmerge.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+
+        Report report;
+        report.associateModel("members", &model);
+        IdXmlElementHandler handler;
+        report.setXmlElementHandler(&handler);
+        QVERIFY(report.loadFromXMLForEachRow(&file, &model));
+        QTextDocument &doc = *report.mainTextDocument();
+        // The elements with an id follow the model too
+        QCOMPARE(doc.toPlainText().count(QStringLiteral("Bob")), 2);
+        QTextCursor c = doc.find(QStringLiteral("Bob"));
+        QVERIFY(!c.isNull());
+        QVERIFY(c.charFormat().fontWeight() == QFont::Bold);
+
+        // The id can still be used for all the copies, including the empty ones
+        report.associateTextValue("name", "Zoe");
+        QCOMPARE(doc.toPlainText().count(QStringLiteral("Zoe")), 4);
+        QVERIFY(!doc.toPlainText().contains(QStringLiteral("Bob")));
+        c = doc.find(QStringLiteral("Zoe"));
+        QVERIFY(c.charFormat().fontWeight() == QFont::Bold);
+    }
+
+    void testLoadFromXMLForEachRowPerRowHandler()
+    {
+        QStandardItemModel model;
+        model.setItem(0, 0, new QStandardItem("Ann"));
+        model.setItem(0, 1, new QStandardItem("ann@example.com"));
+        model.setItem(1, 0, new QStandardItem("Bob"));
+        model.setItem(1, 1, new QStandardItem(""));
+        QFile file(":/mailmerge.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        SkipEmptyXmlElementHandler handler;
+
+        Report expected;
+        expected.associateModel("members", &model);
+        expected.setXmlElementHandler(&handler);
+        for (int row = 0; row < model.rowCount(); ++row) {
+            expected.setCurrentRow(&model, row);
+            QVERIFY(expected.loadFromXML(&file));
+            if (row < model.rowCount() - 1)
+                expected.addPageBreak();
+        }
+
+        // The handler decides for each row, rather than once for the first one
+        Report report;
+        report.associateModel("members", &model);
+        report.setXmlElementHandler(&handler);
+        QVERIFY(report.loadFromXMLForEachRow(&file, &model));
+        QCOMPARE(report.mainTextDocument()->toPlainText(), expected.mainTextDocument()->toPlainText());
+        QCOMPARE(report.mainTextDocument()->blockCount(), expected.mainTextDocument()->blockCount());
+    }
+
+    void testLoadFromXMLForEachRowWithoutModel()
+    {
+        QFile file(":/mailmerge.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        Report report;
+        ErrorDetails details;
+        QVERIFY(!report.loadFromXMLForEachRow(&file, nullptr, &details));
+        QVERIFY(details.hasError());
+    }
+
     void testHtmlId()
     {
         QFile file(":/htmlid.xml");